@@ -1,17 +1,63 @@
 #!/usr/bin/python3
 
-import dbus, subprocess
+import dbus, os, subprocess, struct
 
 
 from beeminder import BeeMinder
 from advertisement import Advertisement
 from service import Application, Service, Characteristic, Descriptor
+from hive_frame import FrameReceiver, parse_frame
 
 GATT_CHRC_IFACE = "org.bluez.GattCharacteristic1"
 NOTIFY_TIMEOUT = 5000
 SMALL_SENSOR_DATA_LEN = 12
 AUDIO_DATA_CHUNK_LEN = 496
 END_DATA_LEN = 4
+# nodes that work the spectrum out themselves send one packet starting with this
+# instead of the audio chunks (hive/components/hive_dsp)
+SPECTRUM_MAGIC = b'HVSP'
+# and ADPCM coded audio comes after a header starting with this, then 496 byte blocks
+ADPCM_MAGIC = b'HVAD'
+HIVE_PROCESS = '../beeminder_base_processing/hive_process'
+# sample rate, frame size and thresholds, the nodes record at 22050 Hz
+HIVE_CONFIG = '../beeminder_base_processing/hive_config.json'
+
+
+class HiveProcessor:
+    """
+    Keeps one hive_process running in --serve mode so each upload only pays
+    for the analysis, not for a process spawn and FFT plan setup.
+    Requests and replies are a 4 byte little endian length followed by the data.
+    """
+    def __init__(self, path=HIVE_PROCESS, config=HIVE_CONFIG):
+        self.path = path
+        self.config = config
+        self.proc = None
+
+    def start(self):
+        # binary reports are a third the size of the JSON and skip the float printing,
+        # beeminder.get_data_from_file decodes them
+        args = [self.path, '--serve', '--format', 'bin']
+        if self.config and os.path.exists(self.config):
+            args += ['--config', self.config]
+        self.proc = subprocess.Popen(args, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+
+    def process(self, recording):
+        if self.proc is None or self.proc.poll() is not None:
+            self.start()
+        try:
+            self.proc.stdin.write(struct.pack('<I', len(recording)) + recording)
+            self.proc.stdin.flush()
+            header = self.proc.stdout.read(4)
+            if len(header) != 4:
+                raise IOError('hive_process closed the connection')
+            (length,) = struct.unpack('<I', header)
+            return self.proc.stdout.read(length)
+        except (IOError, OSError):
+            # restart on the next request rather than wedging every upload after this one
+            self.proc.kill()
+            self.proc = None
+            raise
 
 
 class BaseStationAdvertisement(Advertisement):
@@ -35,6 +81,8 @@ class BaseStationCharacteristic(Characteristic):
         self.notifying = False
         self.raw_files = {}
         self.packet_count = 0
+        self.processor = HiveProcessor()
+        self.receiver = FrameReceiver()
         Characteristic.__init__(self, self.BASE_CHAR_UUID, ["notify", "write"], service)
         
 
@@ -43,6 +91,20 @@ class BaseStationCharacteristic(Characteristic):
         name = path[-1]
         
         #print(len(value)) 
+        # framed uploads carry their own type, the length checks below are for
+        # nodes from before the framing
+        if parse_frame(bytes(value)) is not None:
+            reply, path = self.receiver.handle(name, bytes(value))
+            if reply is not None:
+                self.notify(reply)
+            if path is not None:
+                # read now, the node's next upload starts the file over.  processed
+                # from the main loop, so the reply the node waits on goes out first
+                with open(path, 'rb') as in_file:
+                    recording = in_file.read()
+                self.add_timeout(0, lambda: self.finishUpload(name, recording))
+            return
+
         if len(value) == SMALL_SENSOR_DATA_LEN:
             print("starting new sensor upload")
             print(self.packet_count)
@@ -59,6 +121,14 @@ class BaseStationCharacteristic(Characteristic):
             except Exception as e:
                 print(e)
 
+        elif bytes(value[:4]) in (SPECTRUM_MAGIC, ADPCM_MAGIC) and len(value) > END_DATA_LEN:
+            print("%s header of %d bytes" % (bytes(value[:4]).decode(), len(value)))
+            # hive_process recognises either after the sensor data
+            try:
+                self.raw_files[name].write(bytes(value))
+            except Exception as e:
+                print(e)
+
         elif len(value) == AUDIO_DATA_CHUNK_LEN:
             self.packet_count += 1
             #write packets to a file
@@ -75,32 +145,50 @@ class BaseStationCharacteristic(Characteristic):
             except Exception as e:
                 print(e)
 
-            #run FFT to get output JSON
+            #run FFT to get the report
             self.runFFT(name)
 
-            #send output JSON to database
+            #send the report to database
             self.SendToDataBase(name)    
     
 
-    def runFFT(self, name):
-        in_file = open('Data/' + name + '.in', 'r')
-        out_file = open('Data/' + name + '.json', 'w')
+    def finishUpload(self, name, recording):
+        self.runFFT(name, recording)
+        self.SendToDataBase(name)
+        return False
 
-        subprocess.run('../beeminder_base_processing/hive_process', 
-                stdin=in_file, stdout=out_file)
+    def runFFT(self, name, recording=None):
+        if recording is None:
+            with open('Data/' + name + '.in', 'rb') as in_file:
+                recording = in_file.read()
+
+        try:
+            report = self.processor.process(recording)
+        except Exception as e:
+            print(e)
+            return
+
+        with open('Data/' + name + '.bin', 'wb') as out_file:
+            out_file.write(report)
  
     def SendToDataBase(self, name):
         try:
             bm = BeeMinder()
             print('attempting upload') 
-            file_name = 'Data/'+name+'.json' 
+            file_name = 'Data/'+name+'.bin' 
             bm.add_report_from_file(name, file_name)
             print('data sent to database')
         except Exception as e:
             print(e)
 
+    def notify(self, value):
+        # every node listening gets it, the upload id in it says whose it is
+        if not self.notifying:
+            return
+        self.PropertiesChanged(GATT_CHRC_IFACE, {"Value": dbus.Array([dbus.Byte(b) for b in value], signature='y')}, [])
+
     def StartNotify(self):
-        pass
+        self.notifying = True
 
     def StopNotify(self):
         self.notifying = False
@@ -0,0 +1,140 @@
+"""
+Receiving end of the nodes' framed uploads (hive/components/hive_frame).
+
+Each frame is a 16 byte header, "HF", version, type, u16 seq, u16 payload
+length, u32 offset and a crc32 of the rest, then the payload.  An upload is the
+sensor data followed by the spectrum packet or audio, written to Data/<name>.in
+in order as it arrives so hive_process reads it the same as an unframed one.
+"""
+
+import os, struct, zlib
+
+FRAME_MAGIC = b'HF'
+FRAME_VERSION = 1
+FRAME_HEADER = struct.Struct('<2sBBHHI')
+FRAME_HEADER_LEN = FRAME_HEADER.size + 4
+
+START, DATA, END, RESUME, DONE = range(1, 6)
+
+
+def frame(frame_type, seq, offset, payload=b''):
+    header = FRAME_HEADER.pack(FRAME_MAGIC, FRAME_VERSION, frame_type, seq, len(payload), offset)
+    crc = zlib.crc32(payload, zlib.crc32(header)) & 0xffffffff
+    return header + struct.pack('<I', crc) + payload
+
+
+def parse_frame(value):
+    """(type, seq, offset, payload), or None if value isn't an intact frame"""
+    if len(value) < FRAME_HEADER_LEN or value[:2] != FRAME_MAGIC:
+        return None
+    magic, version, frame_type, seq, length, offset = FRAME_HEADER.unpack_from(value)
+    (crc,) = struct.unpack_from('<I', value, FRAME_HEADER.size)
+    if version != FRAME_VERSION or length != len(value) - FRAME_HEADER_LEN:
+        return None
+    payload = value[FRAME_HEADER_LEN:]
+    if zlib.crc32(payload, zlib.crc32(value[:FRAME_HEADER.size])) & 0xffffffff != crc:
+        return None
+    return frame_type, seq, offset, payload
+
+
+class Upload:
+    def __init__(self, upload_id, path):
+        self.id = upload_id
+        self.path = path
+        self.file = open(path, 'wb')
+        self.received = 0
+        self.crc = 0
+        self.next_seq = None
+        # frames that never arrived or came out of order
+        self.lost = 0
+        # offset the node was last sent back to, so a gap is only told once
+        self.told = None
+
+    def restart(self):
+        self.file.seek(0)
+        self.file.truncate()
+        self.received = 0
+        self.crc = 0
+
+
+class FrameReceiver:
+    """
+    Puts the nodes' uploads back together, one in progress per node.  A node
+    that gets cut off sends START again with the same upload id and is told
+    the offset to go on from, anything after a gap is dropped until then.
+    """
+    def __init__(self, directory='Data'):
+        self.directory = directory
+        self.uploads = {}
+        # (id, length) of each node's last complete upload, for when the DONE
+        # reply goes missing and the node starts it again
+        self.finished = {}
+
+    def handle(self, name, value):
+        """
+        Returns (reply, path).  reply is a frame to notify the node with or None,
+        path is set when the upload is complete and checks out.
+        """
+        parsed = parse_frame(value)
+        if parsed is None:
+            print('%s: bad frame of %d bytes' % (name, len(value)))
+            return None, None
+        frame_type, seq, offset, payload = parsed
+        upload = self.uploads.get(name)
+
+        if frame_type == START and len(payload) == 4:
+            (upload_id,) = struct.unpack('<I', payload)
+            if self.finished.get(name, (None,))[0] == upload_id:
+                return self.reply(DONE, upload_id, self.finished[name][1], seq), None
+            if upload is None or upload.id != upload_id:
+                if upload is not None:
+                    upload.file.close()
+                upload = Upload(upload_id, os.path.join(self.directory, name + '.in'))
+                self.uploads[name] = upload
+                print('%s: starting upload %08x' % (name, upload_id))
+            else:
+                print('%s: resuming upload %08x at %d' % (name, upload_id, upload.received))
+            upload.next_seq = (seq + 1) & 0xffff
+            upload.told = upload.received
+            return self.reply(RESUME, upload.id, upload.received, seq), None
+
+        if upload is None:
+            return None, None
+        if seq != upload.next_seq:
+            upload.lost += 1
+        upload.next_seq = (seq + 1) & 0xffff
+
+        if frame_type == DATA:
+            end = offset + len(payload)
+            if offset <= upload.received < end:
+                data = payload[upload.received - offset:]
+                upload.file.write(data)
+                upload.crc = zlib.crc32(data, upload.crc)
+                upload.received = end
+            elif offset > upload.received and upload.told != upload.received:
+                # send the node back now rather than after the rest of the upload
+                upload.told = upload.received
+                return self.reply(RESUME, upload.id, upload.received, seq), None
+            return None, None
+
+        if frame_type == END and len(payload) == 4:
+            (crc,) = struct.unpack('<I', payload)
+            if upload.received == offset and upload.crc & 0xffffffff == crc:
+                upload.file.close()
+                del self.uploads[name]
+                self.finished[name] = (upload.id, offset)
+                print('%s: upload %08x of %d bytes complete, %d frames lost on the way'
+                      % (name, upload.id, offset, upload.lost))
+                return self.reply(DONE, upload.id, offset, seq), upload.path
+            if upload.received >= offset:
+                # every byte came but something in them is wrong, start over
+                print('%s: upload %08x failed its crc' % (name, upload.id))
+                upload.restart()
+            upload.told = upload.received
+            return self.reply(RESUME, upload.id, upload.received, seq), None
+
+        return None, None
+
+    def reply(self, frame_type, upload_id, offset, seq):
+        # seq of the frame it answers, so the node can tell the reply to its START
+        return frame(frame_type, seq, offset, struct.pack('<I', upload_id))
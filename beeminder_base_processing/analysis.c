@@ -0,0 +1,162 @@
+//threshold checks, moved out of hive_process.c so the bench can time them.
+
+#include <errno.h>
+#include <stddef.h>
+
+#include "analysis.h"
+#include "features.h"
+
+#define HUMIDITY_LOW 4500
+#define HUMIDITY_HIGH 6500
+#define TEMP_LOW 9300
+#define TEMP_HIGH 9600
+
+const struct analysis_params analysis_defaults = {
+	.sample_rate = SAMPLE_RATE,
+	.freq = {
+		[AUDIO_4DAY_BEE] = HIVE_FREQ_4DAY_BEE,
+		[AUDIO_6DAY_BEE] = HIVE_FREQ_6DAY_BEE,
+		[AUDIO_9DAY_BEE] = HIVE_FREQ_9DAY_BEE,
+		[AUDIO_QUEEN] = HIVE_FREQ_QUEEN,
+		//the octave above the queen.  this used to index bin FREQ_QUEEN*2 of the
+		//4Hz spectrum, which is 3200Hz rather than 800Hz.
+		[AUDIO_QUEEN_REF] = HIVE_FREQ_QUEEN*2,
+	},
+	.peak_search_hz = HIVE_PEAK_SEARCH_HZ,
+	//4daybee_low, 4daybee_high, 6daybee_low, 6daybee_high, 9daybee_low, 9daybee_high
+	.bee_age_dist = {17.9, 28.1, 34.6, 47.5, 33.2, 41.6},
+	.humidity_low = HUMIDITY_LOW,
+	.humidity_high = HUMIDITY_HIGH,
+	.temp_low = TEMP_LOW,
+	.temp_high = TEMP_HIGH,
+};
+
+ //handles temperature, humidity, and timestamp reading into hive struct
+ //as well as comparing to threshold values predetermined by bee science :)
+ void th_handle(const struct analysis_params *p, struct raw_hivedata *raw_hive, struct hivedata *hive) {
+
+	hive->weight = raw_hive->weight;
+	hive->temperature = raw_hive->temperature;
+	hive->humidity = raw_hive->humidity;
+
+	if(hive->humidity > p->humidity_high) {
+		hive->humidity_flag = HIGH_FLAG;
+	}
+	else if (hive->humidity < p->humidity_low) {
+		hive->humidity_flag = LOW_FLAG;
+	}
+	else {
+		hive->humidity_flag = OK_FLAG;
+	}
+	
+	if(hive->temperature > p->temp_high) {
+		hive->temperature_flag = HIGH_FLAG;
+	}
+	else if (hive->temperature < p->temp_low) {
+		hive->temperature_flag = LOW_FLAG;
+	}
+	else {
+		hive->temperature_flag = OK_FLAG;
+	}
+	//printf("finished th handle");
+ }
+
+void audio_bins(const struct analysis_params *p, int numsamples, int *bins) {
+	for (int i = 0; i < AUDIO_NBINS; i++) {
+		bins[i] = hive_freq_bin(p->freq[i], p->sample_rate, numsamples);
+	}
+}
+
+void audio_ranges(const struct analysis_params *p, int numsamples, int *first, int *last) {
+	for (int i = 0; i < AUDIO_NBINS; i++) {
+		hive_freq_range(p->freq[i], p->peak_search_hz, p->sample_rate, numsamples, &first[i], &last[i]);
+	}
+}
+
+int audio_range_bins(const struct analysis_params *p, int numsamples, int *bins, int max) {
+	int first[AUDIO_NBINS], last[AUDIO_NBINS];
+	int n = 0;
+
+	audio_ranges(p, numsamples, first, last);
+	for (int i = 0; i < AUDIO_NBINS; i++) {
+		for (int k = first[i]; k < last[i]; k++) {
+			int seen = 0;
+			for (int j = 0; j < n && !seen; j++) {
+				seen = bins[j] == k;
+			}
+			if (seen) {
+				continue;
+			}
+			if (n == max) {
+				return -EINVAL;
+			}
+			bins[n++] = k;
+		}
+	}
+	return n;
+}
+
+//compares the features of the file's spectrum to expected values and modifies hive
+//data file with flags corresponding to levels of desired frequencies.
+int audio_compare(const struct analysis_params *p, const float *features, struct hivedata *hive) {
+	
+	//thresholds for bee age distribution as percentages of total population
+	const float *bee_age_dist = p->bee_age_dist;
+	//the strongest bin near each frequency, so a tone a few Hz off isn't missed
+	const float *peak = features + FEATURE_PEAK;
+
+	//calculate amplitudes of different bee ages
+	float amp_3day_bee = peak[AUDIO_4DAY_BEE];
+	float amp_6day_bee = peak[AUDIO_6DAY_BEE];
+	float amp_9day_bee = peak[AUDIO_9DAY_BEE];
+	float amp_queen = peak[AUDIO_QUEEN];
+	//the 3 age ranges only cover about 80% of the population of the hive.
+	//assuming the other 20% of the bees are still in the hive, 
+	//we will need to scale the amplitude by a factor of 1.2.
+	//since the queen is only 1 bee, we do not include her in this calculation.
+	float amp_total_bee = 1.2*(amp_3day_bee + amp_6day_bee + amp_9day_bee);
+	for (size_t i = 0; i < sizeof(hive->bee_flags); i++) {
+		hive->bee_flags[i] = OK_FLAG;
+	}
+	
+	//get age distribution as percentages and flag
+	float amp_3day_bee_percentage = (float)amp_3day_bee/amp_total_bee*100;
+	float amp_6day_bee_percentage = (float)amp_6day_bee/amp_total_bee*100;
+	float amp_9day_bee_percentage = (float)amp_9day_bee/amp_total_bee*100;
+	if (amp_3day_bee_percentage < bee_age_dist[0]) {
+		hive->bee_flags[3] = LOW_FLAG;
+		hive->bee_flags[2] = 1;
+	}
+	else if(amp_3day_bee_percentage > bee_age_dist[1]) {
+		hive->bee_flags[3] = HIGH_FLAG;
+	}
+	if (amp_6day_bee_percentage < bee_age_dist[2]) {
+		hive->bee_flags[4] = LOW_FLAG;
+	}
+	else if(amp_6day_bee_percentage > bee_age_dist[3]) {
+		hive->bee_flags[4] = HIGH_FLAG;
+	}
+	if (amp_9day_bee_percentage < bee_age_dist[4]) {
+		hive->bee_flags[5] = LOW_FLAG;
+	}
+	else if(amp_9day_bee_percentage > bee_age_dist[5]) {
+		hive->bee_flags[5] = HIGH_FLAG;
+	}
+	
+	//check presence of queen.  if her amplitude is higher 
+	//than the amplitude of much higher frequencies (which we would not expect to see much of)
+	//we can say we have detected a queen.  Flag for presence is 0 for false, 1 for true.
+	//the reference is the mean level around it rather than one noisy bin.
+	if (amp_queen > 2*features[FEATURE_LEVEL + AUDIO_QUEEN_REF]) {
+		hive->bee_flags[0] = 1;
+		if (amp_queen > amp_3day_bee) {
+			hive->bee_flags[1] = 1;
+		}
+	}
+	
+	//printf("3 Day Bee percentage: %f\n", amp_3day_bee_percentage);
+	//printf("6 Day Bee percentage: %f\n", amp_6day_bee_percentage);
+	//printf("9 Day Bee percentage: %f\n", amp_9day_bee_percentage);
+	//printf("Queen in hive?: %d\n", hive->bee_flags[3]);
+	return 0;
+}
@@ -0,0 +1,48 @@
+//the checks that turn the sensor readings and the spectral features (features.h)
+//of the summed spectrum into flags.
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "hive.h"
+//the bee frequencies and their bins, shared with the nodes
+#include "hive_bins.h"
+
+//the frequencies audio_compare looks at
+enum {
+	AUDIO_4DAY_BEE,
+	AUDIO_6DAY_BEE,
+	AUDIO_9DAY_BEE,
+	AUDIO_QUEEN,
+	AUDIO_QUEEN_REF,	//what the queen is compared against
+	AUDIO_NBINS,
+};
+
+//what the flags are worked out against.  analysis_defaults holds the values
+//above and in analysis.c, a config file (config.h) can change any of them.
+struct analysis_params {
+	int sample_rate;
+	float freq[AUDIO_NBINS];	//Hz of each AUDIO_* amplitude
+	float peak_search_hz;	//half width of the range searched around each of them
+	//low and high percentage of the population for the 4, 6 and 9 day bees
+	float bee_age_dist[6];
+	uint32_t humidity_low, humidity_high;
+	uint32_t temp_low, temp_high;
+};
+
+extern const struct analysis_params analysis_defaults;
+
+//copies the readings into hive and sets the humidity and temperature flags
+void th_handle(const struct analysis_params *p, struct raw_hivedata *raw_hive, struct hivedata *hive);
+//the bin of each of the AUDIO_* frequencies.
+//numsamples is the FFT size, the frame size or bigger with zero padding.
+void audio_bins(const struct analysis_params *p, int numsamples, int *bins);
+//bins first[i] .. last[i]-1 are searched for the peak of frequency i
+void audio_ranges(const struct analysis_params *p, int numsamples, int *first, int *last);
+//every bin of every range once, for filters that only work those out.
+//returns how many there are or -EINVAL if that is more than max.
+int audio_range_bins(const struct analysis_params *p, int numsamples, int *bins, int max);
+//sets hive->bee_flags from the features of the amplitude spectrum
+int audio_compare(const struct analysis_params *p, const float *features, struct hivedata *hive);
+
+#endif
@@ -0,0 +1,103 @@
+//arena blocks are a singly linked list; cur only ever moves forward until a reset
+//or release moves it back, so reusing a block is just setting used to 0.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+struct arena_block {
+	struct arena_block *next;
+	size_t size;
+	unsigned char *data;
+};
+
+void arena_init(struct arena *a, size_t block_size) {
+	a->first = NULL;
+	a->cur = NULL;
+	a->used = 0;
+	a->block_size = block_size;
+	a->total = 0;
+}
+
+void arena_free(struct arena *a) {
+	struct arena_block *b = a->first;
+	while (b) {
+		struct arena_block *next = b->next;
+		free(b->data);
+		free(b);
+		b = next;
+	}
+	arena_init(a, a->block_size);
+}
+
+static struct arena_block *block_new(size_t size) {
+	struct arena_block *b = malloc(sizeof(*b));
+	void *mem;
+	if (!b) {
+		return NULL;
+	}
+	if (posix_memalign(&mem, ARENA_ALIGN, size)) {
+		free(b);
+		return NULL;
+	}
+	b->next = NULL;
+	b->size = size;
+	b->data = mem;
+	return b;
+}
+
+void *arena_alloc(struct arena *a, size_t n) {
+	n = (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if (a->cur && a->cur->size - a->used >= n) {
+		void *p = a->cur->data + a->used;
+		a->used += n;
+		return p;
+	}
+	//move on to the next block that fits, dropping any too small to hold n
+	struct arena_block **link = a->cur ? &a->cur->next : &a->first;
+	while (*link && (*link)->size < n) {
+		struct arena_block *small = *link;
+		*link = small->next;
+		a->total -= small->size;
+		free(small->data);
+		free(small);
+	}
+	if (!*link) {
+		struct arena_block *b = block_new(n > a->block_size ? n : a->block_size);
+		if (!b) {
+			return NULL;
+		}
+		*link = b;
+		a->total += b->size;
+	}
+	a->cur = *link;
+	a->used = n;
+	return a->cur->data;
+}
+
+void *arena_calloc(struct arena *a, size_t count, size_t size) {
+	if (size && count > SIZE_MAX / size) {
+		return NULL;
+	}
+	void *p = arena_alloc(a, count * size);
+	if (p) {
+		memset(p, 0, count * size);
+	}
+	return p;
+}
+
+void arena_reset(struct arena *a) {
+	a->cur = a->first;
+	a->used = 0;
+}
+
+struct arena_mark arena_mark(const struct arena *a) {
+	return (struct arena_mark){a->cur, a->used};
+}
+
+void arena_release(struct arena *a, struct arena_mark m) {
+	a->cur = m.block;
+	a->used = m.used;
+}
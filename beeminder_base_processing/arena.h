@@ -0,0 +1,43 @@
+//bump allocator for per recording scratch memory.
+//allocations are carved out of big blocks and never freed one by one; the whole
+//arena is rewound with arena_reset (or back to a mark) in O(1).  blocks are kept
+//across resets, so once the first recording has been through a process the
+//following ones reuse the same memory and the heap stops growing.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+//every allocation is aligned for the vector kernels
+#define ARENA_ALIGN 32
+
+struct arena_block;
+
+struct arena {
+	struct arena_block *first;
+	struct arena_block *cur;
+	size_t used;		//bytes taken in cur
+	size_t block_size;	//size of new blocks, bigger requests get a block of their own size
+	size_t total;		//bytes held in blocks
+};
+
+//a point to rewind to, see arena_release
+struct arena_mark {
+	struct arena_block *block;
+	size_t used;
+};
+
+void arena_init(struct arena *a, size_t block_size);
+void arena_free(struct arena *a);
+//n bytes aligned to ARENA_ALIGN, NULL when out of memory
+void *arena_alloc(struct arena *a, size_t n);
+//same, zeroed
+void *arena_calloc(struct arena *a, size_t count, size_t size);
+//gives back everything, keeps the blocks
+void arena_reset(struct arena *a);
+//gives back everything allocated since the mark was taken
+struct arena_mark arena_mark(const struct arena *a);
+void arena_release(struct arena *a, struct arena_mark m);
+
+#endif
@@ -0,0 +1,52 @@
+//band edges and the per band reductions, worked out by the nodes' hive_bins.c so
+//the bands they send are the ones hive_process makes.
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "bands.h"
+#include "hive_bins.h"
+
+int bands_init(struct bands *b, enum band_scale scale, int nbands, float fmin, float fmax,
+		float bin_hz, int nbins) {
+	float top = (nbins - 1) * bin_hz;
+
+	if (fmax <= 0 || fmax > top) {
+		fmax = top;
+	}
+	if (nbands <= 0 || fmin < 0 || fmin >= fmax || (scale == BANDS_LOG && fmin <= 0)) {
+		return -EINVAL;
+	}
+	b->nbands = nbands;
+	b->scale = scale;
+	b->edge = malloc((nbands + 1) * sizeof(float));
+	b->first = malloc(nbands * sizeof(int));
+	b->last = malloc(nbands * sizeof(int));
+	if (!b->edge || !b->first || !b->last) {
+		bands_free(b);
+		return -ENOMEM;
+	}
+
+	hive_band_edges(b->edge, nbands, fmin, fmax, scale == BANDS_LOG);
+	hive_band_bins(b->edge, nbands, bin_hz, nbins, b->first, b->last);
+	return 0;
+}
+
+void bands_free(struct bands *b) {
+	free(b->edge);
+	free(b->first);
+	free(b->last);
+	b->edge = NULL;
+	b->first = NULL;
+	b->last = NULL;
+	b->nbands = 0;
+}
+
+void bands_summarise(const struct bands *b, const float *spectrum, int power,
+		float *mean, float *peak, float *energy) {
+	hive_band_summarise(b->first, b->last, b->nbands, spectrum, power, mean, peak, energy);
+}
+
+const char *band_scale_name(enum band_scale scale) {
+	return scale == BANDS_LOG ? "log" : "mel";
+}
@@ -0,0 +1,37 @@
+//band summary of a spectrum.
+//the bins are grouped into bands spaced evenly on a log or mel scale between fmin
+//and fmax, and each band is reduced to its mean, peak and energy.  the bin ranges
+//are worked out once, so summarising a spectrum is a single pass over it.
+
+#ifndef BANDS_H
+#define BANDS_H
+
+enum band_scale {
+	BANDS_MEL,
+	BANDS_LOG,
+};
+
+struct bands {
+	int nbands;
+	enum band_scale scale;
+	//nbands+1 band edges in Hz, band i is [edge[i], edge[i+1])
+	float *edge;
+	//bins first[i] .. last[i]-1 make up band i, never empty
+	int *first;
+	int *last;
+};
+
+//bands for a spectrum of nbins bins bin_hz apart.  fmax is clamped to the last bin,
+//log bands need fmin > 0.  returns 0, -EINVAL or -ENOMEM.
+int bands_init(struct bands *b, enum band_scale scale, int nbands, float fmin, float fmax,
+		float bin_hz, int nbins);
+void bands_free(struct bands *b);
+
+//per band mean and peak of the spectrum values and energy, the sum of the squared
+//magnitudes.  with power set the spectrum already holds squared magnitudes.
+void bands_summarise(const struct bands *b, const float *spectrum, int power,
+		float *mean, float *peak, float *energy);
+
+const char *band_scale_name(enum band_scale scale);
+
+#endif
@@ -0,0 +1,526 @@
+//throughput benchmark for the processing pipeline.
+//each recording goes through pipeline.c the way hive_process runs it, process_fd
+//on the file: once with --stats clocks for the time of every stage, then again
+//without them for the whole thing, and with --flags-only.
+//every figure is the best run out of --reps.
+//with --fft and --precision the pipeline runs on that backend.  it and every
+//kissfft precision are checked against double precision kissfft at the same size.
+//so is the nodes' own spectrum code (hive_dsp.h), through the packet they send
+//at the nodes' settings whatever the options.
+//the nodes' ADPCM codec (hive_adpcm.h) is timed both ways on the recording and its
+//round trip checked for noise and the flags.
+//a check out of its bound below, or with other bee flags than the reference,
+//makes bench_hive exit with 1.
+//--frame-size times the window and magnitude kernels at other frame sizes, 4000,
+//4096 and 2048 have kernels of their own, anything else takes the generic ones.
+//usage: bench_hive [--reps n] [--hop samples] [--power] [--fft name] [--fft-size n]
+//                  [--precision float|double|q15] [--frame-size samples] recording...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fft.h"
+#include "hive.h"
+#include "pipeline.h"
+#include "analysis.h"
+#include "stft.h"
+#include "hive_dsp.h"
+#include "hive_adpcm.h"
+
+//threads and rounds for the scratch allocation comparison
+#define SCRATCH_THREADS 4
+#define SCRATCH_ROUNDS 10000
+
+//largest difference from double precision kissfft, relative to the largest bin.
+//float FFTs round to about 1e-7 a bin.  Q15 is 2e-4 to 6e-4 on gen_hive's
+//recordings and 2e-3 on a quiet one (--amp 400), where the int16 rounding is
+//largest next to the peak.
+#define FLOAT_MAX_ERROR 1e-5
+#define Q15_MAX_ERROR 4e-3
+//the nodes' band values go as f16, which rounds to 2^-11 of the value
+#define NODE_BAND_MAX_ERROR 1e-3
+
+//a summed spectrum as FFT_handle leaves it, with room for the --power range bins
+#define ACC_MAX (FFT_MAX_SIZE / 2 + 1 + GOERTZEL_MAX_BINS)
+
+static const char *stage_names[STAT_NSTAGES] = {
+	"read", "window", "fft", "magnitude", "compare", "serialize",
+};
+
+struct bench {
+	struct plan_options opt;
+	//the one being timed, and the same with --flags-only
+	struct fft_plan plan;
+	struct fft_plan flags_plan;
+	struct hive_stats stats;
+	struct report_buf report;
+	//accuracy checks out of bounds
+	int failed;
+};
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int read_file(const char *path, uint8_t **data, size_t *len) {
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		return -errno;
+	}
+	fseek(fp, 0, SEEK_END);
+	*len = ftell(fp);
+	rewind(fp);
+	*data = malloc(*len ? *len : 1);
+	if (!*data) {
+		fclose(fp);
+		return -ENOMEM;
+	}
+	size_t got = fread(*data, 1, *len, fp);
+	fclose(fp);
+	if (got != *len) {
+		free(*data);
+		return -EIO;
+	}
+	return 0;
+}
+
+//the file through hive_process's path for a recording on disk.  returns the time
+//it took or -1 with the error in *err.
+static double run_file(struct bench *b, const struct fft_plan *plan, const char *path, int *err) {
+	double t0 = now();
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		*err = -errno;
+		return -1;
+	}
+	*err = process_fd(fd, plan, 0, &b->report);
+	close(fd);
+	return *err ? -1 : now() - t0;
+}
+
+//a plan like b's with another FFT, frame size or mode for the checks
+static int check_plan(struct fft_plan *plan, const struct plan_options *base, const struct fft_backend *backend,
+		int frame_len, int nfft, enum spectrum_mode mode) {
+	struct plan_options opt = *base;
+	opt.cfg.fft = backend->name;
+	opt.cfg.precision = backend->precision;
+	opt.cfg.frame_len = frame_len;
+	opt.cfg.nfft = nfft;
+	opt.mode = mode;
+	opt.threads = 1;
+	opt.flags_only = 0;
+	return fft_plan_init(plan, &opt);
+}
+
+//the recording's summed spectrum and bee flags through the plan
+static void sum_spectrum(const struct fft_plan *plan, const uint8_t *data, size_t len, float *spec,
+		struct hivedata *hive) {
+	const int16_t *samples = (const int16_t *)(data + sizeof(struct raw_hivedata));
+	size_t nsamples = (len - sizeof(struct raw_hivedata)) / sizeof(int16_t);
+	float features[FEATURE_COUNT];
+
+	memset(hive, 0, sizeof(*hive));
+	FFT_handle(samples, nsamples, plan, spec);
+	compare_spectrum(plan, spec, 1, features, hive);
+}
+
+//the benchmarked backend and every kissfft precision against the double precision
+//kissfft over the whole recording: largest and rms difference of the summed
+//spectrum relative to its largest bin, and whether the bee flags come out the same
+static void check_precision(struct bench *b, const uint8_t *data, size_t len) {
+	static float ref[ACC_MAX], spec[ACC_MAX];
+	const struct fft_backend *bench_backend = b->plan.fft[0].backend;
+	const struct fft_backend *check[] = {bench_backend, &fft_backend_kiss, &fft_backend_kiss_q15};
+	struct hivedata ref_hive, hive;
+	struct fft_plan plan;
+	int nbins = b->plan.fft_bins;
+
+	if (check_plan(&plan, &b->opt, &fft_backend_kiss_double, b->plan.frame_len, b->plan.nfft, b->plan.mode)) {
+		return;
+	}
+	sum_spectrum(&plan, data, len, ref, &ref_hive);
+	fft_plan_free(&plan);
+	double peak = 0;
+	for (int k = 0; k < nbins; k++) {
+		peak = fmax(peak, ref[k]);
+	}
+	if (peak == 0) {
+		peak = 1;
+	}
+
+	for (int c = 0; c < (int)(sizeof(check) / sizeof(check[0])); c++) {
+		//the benchmarked backend may be one of the others, or the reference itself
+		if (check[c] == &fft_backend_kiss_double || (c > 0 && check[c] == bench_backend)) {
+			continue;
+		}
+		if (check_plan(&plan, &b->opt, check[c], b->plan.frame_len, b->plan.nfft, b->plan.mode)) {
+			continue;
+		}
+		sum_spectrum(&plan, data, len, spec, &hive);
+		fft_plan_free(&plan);
+		double max = 0, sq = 0;
+		for (int k = 0; k < nbins; k++) {
+			double d = fabs((double)spec[k] - ref[k]);
+			max = fmax(max, d);
+			sq += d * d;
+		}
+		char name[32];
+		double bound = check[c]->precision == FFT_Q15 ? Q15_MAX_ERROR : FLOAT_MAX_ERROR;
+		int differ = memcmp(hive.bee_flags, ref_hive.bee_flags, sizeof(hive.bee_flags)) != 0;
+		int fail = max / peak > bound || differ;
+		snprintf(name, sizeof(name), "%s/%s", check[c]->name, fft_precision_name(check[c]->precision));
+		printf("  accuracy   %-13s max error %.2e, rms %.2e of the largest bin, flags %s%s\n", name,
+				max / peak, sqrt(sq / nbins) / peak, differ ? "differ" : "match",
+				fail ? ", FAILED" : "");
+		b->failed += fail;
+	}
+}
+
+//the spectrum packet a node would send for the recording, at HIVE_DSP_DEFAULTS,
+//against double precision kissfft with the same frames: time to work it out,
+//largest difference of the range bins relative to the largest of them and of the
+//band values relative to each band, and the bee flags.
+static void check_node(struct bench *b, const uint8_t *data, size_t len) {
+	static float ref[ACC_MAX];
+	const struct analysis_params *a = &b->plan.analysis;
+	struct hive_dsp_config cfg = HIVE_DSP_DEFAULTS;
+	struct hivedata ref_hive, hive;
+	struct hive_dsp d;
+	struct fft_plan plan;
+	uint8_t packet[HIVE_SPECTRUM_MAX_LEN];
+
+	cfg.sample_rate = a->sample_rate;
+	memcpy(cfg.freq, a->freq, sizeof(a->freq));
+	cfg.search_hz = a->peak_search_hz;
+	if (hive_dsp_init(&d, &cfg)) {
+		printf("  node       can't do %d points from %d sample frames, FAILED\n", cfg.nfft, cfg.frame_len);
+		b->failed++;
+		return;
+	}
+	double t0 = now();
+	//the nodes read their recording back from flash a BLE write at a time
+	size_t nsamples = (len - sizeof(struct raw_hivedata)) / sizeof(int16_t);
+	const int16_t *samples = (const int16_t *)(data + sizeof(struct raw_hivedata));
+	for (size_t i = 0; i < nsamples; i += 248) {
+		hive_dsp_push(&d, samples + i, nsamples - i < 248 ? nsamples - i : 248);
+	}
+	int plen = hive_dsp_packet(&d, packet, sizeof(packet));
+	double t = now() - t0;
+	hive_dsp_free(&d);
+	struct hive_spectrum pkt;
+	if (plen < 0 || hive_spectrum_read(packet, plen, &pkt)) {
+		printf("  node       no packet, FAILED\n");
+		b->failed++;
+		return;
+	}
+
+	struct plan_options opt = b->opt;
+	opt.cfg.hop = 0;
+	opt.cfg.window = WINDOW_HANN;
+	if (check_plan(&plan, &opt, &fft_backend_kiss_double, cfg.frame_len, cfg.nfft, SPECTRUM_MAGNITUDE)) {
+		return;
+	}
+	sum_spectrum(&plan, data, len, ref, &ref_hive);
+	fft_plan_free(&plan);
+
+	float amp[FFT_MAX_SIZE / 2 + 1] = {0};
+	double peak = 0, range_err = 0;
+	for (int r = 0; r < pkt.nranges; r++) {
+		hive_spectrum_range(&pkt, r, amp + pkt.range_first[r]);
+		for (int k = pkt.range_first[r]; k < pkt.range_first[r] + pkt.range_count[r]; k++) {
+			peak = fmax(peak, ref[k]);
+			range_err = fmax(range_err, fabs((double)amp[k] - ref[k]));
+		}
+	}
+	float features[FEATURE_COUNT];
+	memset(&hive, 0, sizeof(hive));
+	features_compute(a, amp, cfg.nfft, 0, features);
+	audio_compare(a, features, &hive);
+
+	struct bands bands;
+	double band_err = 0;
+	int nbands = pkt.nbands;
+	if (bands_init(&bands, BANDS_MEL, nbands, pkt.fmin, pkt.fmax, (float)cfg.sample_rate / cfg.nfft,
+				cfg.nfft / 2 + 1)) {
+		return;
+	}
+	float mean[nbands], bpeak[nbands], energy[nbands], rmean[nbands], rpeak[nbands], renergy[nbands];
+	hive_spectrum_bands(&pkt, mean, bpeak, energy);
+	bands_summarise(&bands, ref, 0, rmean, rpeak, renergy);
+	bands_free(&bands);
+	for (int i = 0; i < nbands; i++) {
+		band_err = fmax(band_err, fabs(mean[i] - rmean[i]) / fmax(rmean[i], 1e-30));
+		band_err = fmax(band_err, fabs(bpeak[i] - rpeak[i]) / fmax(rpeak[i], 1e-30));
+		band_err = fmax(band_err, fabs(energy[i] - renergy[i]) / fmax(renergy[i], 1e-30));
+	}
+	range_err = peak > 0 ? range_err / peak : range_err;
+	int differ = memcmp(hive.bee_flags, ref_hive.bee_flags, sizeof(hive.bee_flags)) != 0;
+	//the range bins go as float32
+	int fail = range_err > FLOAT_MAX_ERROR || band_err > NODE_BAND_MAX_ERROR || differ;
+	printf("  node       %12.3f ms  %d byte packet, range max error %.2e, bands %.2e, flags %s%s\n",
+			t * 1e3, plen, range_err, band_err, differ ? "differ" : "match", fail ? ", FAILED" : "");
+	b->failed += fail;
+}
+
+//the recording through the ADPCM codec in BLE write sized blocks: encode and decode
+//speed, how much smaller it gets, the signal to noise ratio of the round trip and
+//whether the flags survive it
+static void check_adpcm(struct bench *b, const uint8_t *data, size_t len, int reps) {
+	static float ref[ACC_MAX], spec[ACC_MAX];
+	size_t nsamples = (len - sizeof(struct raw_hivedata)) / sizeof(int16_t);
+	const int16_t *samples = (const int16_t *)(data + sizeof(struct raw_hivedata));
+	struct hive_adpcm_header h = {.block_len = HIVE_ADPCM_BLOCK_LEN, .nsamples = nsamples,
+		.sample_rate = b->plan.analysis.sample_rate};
+	int per_block = hive_adpcm_block_samples(h.block_len);
+	size_t stream_len = hive_adpcm_stream_len(&h);
+	uint8_t *blocks = malloc(stream_len ? stream_len : 1);
+	uint8_t *decoded = malloc(len);
+	double enc = 0, dec = 0;
+
+	if (!blocks || !decoded) {
+		free(blocks);
+		free(decoded);
+		return;
+	}
+	memcpy(decoded, data, sizeof(struct raw_hivedata));
+	int16_t *out = (int16_t *)(decoded + sizeof(struct raw_hivedata));
+	for (int r = 0; r < reps; r++) {
+		struct hive_adpcm_state st = {0};
+		double t0 = now();
+		for (size_t i = 0, k = 0; i < nsamples; i += per_block, k++) {
+			int n = nsamples - i < (size_t)per_block ? (int)(nsamples - i) : per_block;
+			hive_adpcm_encode_block(&st, samples + i, n, blocks + k * h.block_len, h.block_len);
+		}
+		double t1 = now();
+		hive_adpcm_decode(&h, blocks, stream_len, out);
+		double t2 = now();
+		if (r == 0 || t1 - t0 < enc) {
+			enc = t1 - t0;
+		}
+		if (r == 0 || t2 - t1 < dec) {
+			dec = t2 - t1;
+		}
+	}
+
+	double sig = 0, noise = 0;
+	for (size_t i = 0; i < nsamples; i++) {
+		double d = (double)out[i] - samples[i];
+		sig += (double)samples[i] * samples[i];
+		noise += d * d;
+	}
+	struct hivedata ref_hive, hive;
+	sum_spectrum(&b->plan, data, len, ref, &ref_hive);
+	sum_spectrum(&b->plan, decoded, len, spec, &hive);
+	int differ = memcmp(hive.bee_flags, ref_hive.bee_flags, sizeof(hive.bee_flags)) != 0;
+	printf("  adpcm      encode %.1f, decode %.1f Msamples/s, %.2fx smaller, snr %.1f dB, flags %s%s\n",
+			enc > 0 ? nsamples / enc * 1e-6 : 0, dec > 0 ? nsamples / dec * 1e-6 : 0,
+			stream_len ? (double)nsamples * sizeof(int16_t) / (stream_len + HIVE_ADPCM_HEADER_LEN) : 0,
+			noise > 0 ? 10 * log10(sig / noise) : INFINITY, differ ? "differ" : "match",
+			differ ? ", FAILED" : "");
+	b->failed += differ;
+	free(blocks);
+	free(decoded);
+}
+
+//the scratch memory one recording takes in hive_process: the stream path's STFT
+//ring and what FFT_handle takes to split it over SCRATCH_THREADS threads, from the
+//arena and from malloc.  ns per recording.
+static void bench_scratch(const struct bench *b, double *arena_ns, double *malloc_ns) {
+	struct arena a;
+	size_t sizes[1 + FFT_HANDLE_ALLOCS];
+	int n = sizeof(sizes) / sizeof(sizes[0]);
+	void *p[sizeof(sizes) / sizeof(sizes[0])];
+	volatile unsigned char sink = 0;
+
+	sizes[0] = stft_mem_size(b->plan.frame_len);
+	fft_handle_scratch(&b->plan, SCRATCH_THREADS, sizes + 1);
+	arena_init(&a, 64 * 1024);
+	double t0 = now();
+	for (int r = 0; r < SCRATCH_ROUNDS; r++) {
+		arena_reset(&a);
+		for (int i = 0; i < n; i++) {
+			p[i] = arena_calloc(&a, 1, sizes[i]);
+			sink ^= *(unsigned char *)p[i];
+		}
+	}
+	double t1 = now();
+	for (int r = 0; r < SCRATCH_ROUNDS; r++) {
+		for (int i = 0; i < n; i++) {
+			p[i] = calloc(1, sizes[i]);
+			sink ^= *(unsigned char *)p[i];
+		}
+		for (int i = 0; i < n; i++) {
+			free(p[i]);
+		}
+	}
+	double t2 = now();
+	arena_free(&a);
+	*arena_ns = (t1 - t0) / SCRATCH_ROUNDS * 1e9;
+	*malloc_ns = (t2 - t1) / SCRATCH_ROUNDS * 1e9;
+}
+
+static int bench_file(struct bench *b, const char *path, int reps) {
+	double best[STAT_NSTAGES];
+	double pipeline = 0, flags_only = 0;
+	uint8_t *data = NULL;
+	size_t len = 0;
+	int err;
+
+	for (int r = 0; r < reps; r++) {
+		b->plan.stats = &b->stats;
+		stats_begin(&b->stats);
+		double t = run_file(b, &b->plan, path, &err);
+		stats_end(&b->stats);
+		b->plan.stats = NULL;
+		if (t < 0) {
+			return err;
+		}
+		for (int s = 0; s < STAT_NSTAGES; s++) {
+			if (r == 0 || b->stats.ns[s] * 1e-9 < best[s]) {
+				best[s] = b->stats.ns[s] * 1e-9;
+			}
+		}
+	}
+	for (int r = 0; r < reps; r++) {
+		double p = run_file(b, &b->plan, path, &err);
+		double g = p < 0 ? -1 : run_file(b, &b->flags_plan, path, &err);
+		if (g < 0) {
+			return err;
+		}
+		if (r == 0 || p < pipeline) {
+			pipeline = p;
+		}
+		if (r == 0 || g < flags_only) {
+			flags_only = g;
+		}
+	}
+	if ((err = read_file(path, &data, &len))) {
+		return err;
+	}
+	if (len < sizeof(struct raw_hivedata)) {
+		free(data);
+		return -EINVAL;
+	}
+
+	size_t nsamples = (len - sizeof(struct raw_hivedata)) / sizeof(int16_t);
+	size_t nframes = b->stats.frames;
+	double audio = (double)nsamples / b->plan.analysis.sample_rate;
+	double total = 0;
+	for (int s = 0; s < STAT_NSTAGES; s++) {
+		total += best[s];
+	}
+
+	const struct fft *fft = &b->plan.fft[0];
+	printf("%s: %.1f s of audio, %zu frames of %d (hop %d), %s/%s FFT of %d points, best of %d\n", path,
+			audio, nframes, b->plan.frame_len, b->plan.hop, fft->backend->name,
+			fft_precision_name(fft->backend->precision), fft->n, reps);
+	printf("  %-10s %12s %14s %7s\n", "stage", "ms", "us/frame", "share");
+	for (int s = 0; s < STAT_NSTAGES; s++) {
+		printf("  %-10s %12.3f %14.3f %6.1f%%\n", stage_names[s], best[s] * 1e3,
+				nframes ? best[s] * 1e6 / nframes : 0, total > 0 ? 100 * best[s] / total : 0);
+	}
+	printf("  pipeline   %12.3f ms  %8.2f Msamples/s  %8.1fx realtime\n", pipeline * 1e3,
+			pipeline > 0 ? nsamples / pipeline * 1e-6 : 0, pipeline > 0 ? audio / pipeline : 0);
+	printf("  flags-only %12.3f ms  %8.2f Msamples/s  %8.1fx realtime%s\n", flags_only * 1e3,
+			flags_only > 0 ? nsamples / flags_only * 1e-6 : 0, flags_only > 0 ? audio / flags_only : 0,
+			b->flags_plan.goertzel.nbins ? ", goertzel" : ", fft");
+	check_precision(b, data, len);
+	check_node(b, data, len);
+	check_adpcm(b, data, len, reps);
+	free(data);
+	double arena_ns, malloc_ns;
+	bench_scratch(b, &arena_ns, &malloc_ns);
+	printf("  scratch    %12.3f us per recording from the arena, %.3f us with calloc/free\n",
+			arena_ns * 1e-3, malloc_ns * 1e-3);
+	return 0;
+}
+
+static int usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [--reps n] [--hop samples] [--power] [--fft %s] [--fft-size n]\n"
+			"       [--precision float|double|q15] [--frame-size samples] recording...\n",
+			argv0, fft_backend_names());
+	return 2;
+}
+
+int main(int argc, char **argv) {
+	struct bench b = {.opt = {.mode = SPECTRUM_MAGNITUDE, .threads = 1, .format = FORMAT_JSON}};
+	struct hive_config *cfg = &b.opt.cfg;
+	int reps = 5;
+	int nfiles = 0;
+	int ret = 0;
+
+	config_defaults(cfg);
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+			reps = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--hop") == 0 && i + 1 < argc) {
+			cfg->hop = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--power") == 0) {
+			b.opt.mode = SPECTRUM_POWER;
+		}
+		else if (strcmp(argv[i], "--fft") == 0 && i + 1 < argc && fft_backend_find(argv[i + 1], FFT_FLOAT)) {
+			cfg->fft = argv[++i];
+		}
+		else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc &&
+				fft_precision_parse(argv[i + 1], &cfg->precision) == 0) {
+			i++;
+		}
+		else if (strcmp(argv[i], "--fft-size") == 0 && i + 1 < argc) {
+			cfg->nfft = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--frame-size") == 0 && i + 1 < argc) {
+			cfg->frame_len = atoi(argv[++i]);
+		}
+		else if (argv[i][0] == '-') {
+			return usage(argv[0]);
+		}
+		else {
+			nfiles++;
+		}
+	}
+	if (reps <= 0 || nfiles == 0) {
+		return usage(argv[0]);
+	}
+	if (config_check(cfg)) {
+		return 2;
+	}
+	struct plan_options flags_opt = b.opt;
+	flags_opt.flags_only = 1;
+	if (fft_plan_init(&b.plan, &b.opt) || fft_plan_init(&b.flags_plan, &flags_opt)) {
+		fprintf(stderr, "bench_hive: %s can't do %d point FFTs\n", config_fft(cfg)->name, cfg->nfft);
+		return 2;
+	}
+	report_buf_init(&b.report);
+
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] == '-') {
+			//skip the option and its value
+			i += strcmp(argv[i], "--power") != 0;
+			continue;
+		}
+		int err = bench_file(&b, argv[i], reps);
+		if (err) {
+			fprintf(stderr, "bench_hive: %s: %s\n", argv[i], strerror(-err));
+			ret = 1;
+		}
+	}
+
+	if (b.failed) {
+		fprintf(stderr, "bench_hive: %d accuracy checks failed\n", b.failed);
+		ret = 1;
+	}
+	report_buf_free(&b.report);
+	fft_plan_free(&b.flags_plan);
+	fft_plan_free(&b.plan);
+	return ret;
+}
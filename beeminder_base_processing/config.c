@@ -0,0 +1,343 @@
+//reads hive_config.json with json-parser.
+//keys are checked against what is known so a typo is an error, not a silent default.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "json.h"
+#include "config.h"
+
+//smallest frame anyone would want, also keeps nfft/2 sensible
+#define FRAME_MIN 16
+
+void config_defaults(struct hive_config *c) {
+	*c = (struct hive_config){
+		.frame_len = BUF_SIZE,
+		//the old fseek loop advanced one whole frame each time
+		.hop = 0,
+		.window = WINDOW_HANN,
+		.fft = NULL,
+		.precision = FFT_FLOAT,
+		.nfft = 0,
+		.analysis = analysis_defaults,
+	};
+}
+
+static int key_is(const json_object_entry *e, const char *key) {
+	return strlen(key) == e->name_length && memcmp(e->name, key, e->name_length) == 0;
+}
+
+static int get_number(const char *path, const char *key, const json_value *v, double *out) {
+	if (v->type == json_integer) {
+		*out = v->u.integer;
+	}
+	else if (v->type == json_double) {
+		*out = v->u.dbl;
+	}
+	else {
+		fprintf(stderr, "%s: %s should be a number\n", path, key);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int get_int(const char *path, const char *key, const json_value *v, int *out) {
+	double d;
+	if (get_number(path, key, v, &d)) {
+		return -EINVAL;
+	}
+	if (d != (int)d) {
+		fprintf(stderr, "%s: %s should be a whole number\n", path, key);
+		return -EINVAL;
+	}
+	*out = d;
+	return 0;
+}
+
+static int get_u32(const char *path, const char *key, const json_value *v, uint32_t *out) {
+	double d;
+	if (get_number(path, key, v, &d)) {
+		return -EINVAL;
+	}
+	if (d < 0 || d > UINT32_MAX || d != (uint32_t)d) {
+		fprintf(stderr, "%s: %s should be a whole number from 0 to %u\n", path, key, UINT32_MAX);
+		return -EINVAL;
+	}
+	*out = d;
+	return 0;
+}
+
+static int get_float(const char *path, const char *key, const json_value *v, float *out) {
+	double d;
+	if (get_number(path, key, v, &d)) {
+		return -EINVAL;
+	}
+	*out = d;
+	return 0;
+}
+
+static int get_string(const char *path, const char *key, const json_value *v, const char **out) {
+	if (v->type != json_string) {
+		fprintf(stderr, "%s: %s should be a string\n", path, key);
+		return -EINVAL;
+	}
+	*out = v->u.string.ptr;
+	return 0;
+}
+
+static int check_object(const char *path, const char *key, const json_value *v) {
+	if (v->type != json_object) {
+		fprintf(stderr, "%s: %s should be an object\n", path, key);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int unknown(const char *path, const char *parent, const json_object_entry *e) {
+	fprintf(stderr, "%s: unknown key %s%s%.*s\n", path, parent ? parent : "", parent ? "." : "",
+			(int)e->name_length, e->name);
+	return -EINVAL;
+}
+
+//{"low": n, "high": n}
+static int get_range(const char *path, const char *key, const json_value *v, uint32_t *low, uint32_t *high) {
+	if (check_object(path, key, v)) {
+		return -EINVAL;
+	}
+	for (unsigned i = 0; i < v->u.object.length; i++) {
+		const json_object_entry *e = &v->u.object.values[i];
+		int err;
+		if (key_is(e, "low")) {
+			err = get_u32(path, key, e->value, low);
+		}
+		else if (key_is(e, "high")) {
+			err = get_u32(path, key, e->value, high);
+		}
+		else {
+			err = unknown(path, key, e);
+		}
+		if (err) {
+			return err;
+		}
+	}
+	return 0;
+}
+
+//keys of "frequencies" and "bee_age_percent", in AUDIO_* order
+static const char *audio_keys[AUDIO_NBINS] = {
+	[AUDIO_4DAY_BEE] = "4day_bee",
+	[AUDIO_6DAY_BEE] = "6day_bee",
+	[AUDIO_9DAY_BEE] = "9day_bee",
+	[AUDIO_QUEEN] = "queen",
+	[AUDIO_QUEEN_REF] = "queen_ref",
+};
+
+static int audio_key(const json_object_entry *e, int n) {
+	for (int i = 0; i < n; i++) {
+		if (key_is(e, audio_keys[i])) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static int get_frequencies(const char *path, const json_value *v, struct analysis_params *a) {
+	if (check_object(path, "frequencies", v)) {
+		return -EINVAL;
+	}
+	for (unsigned i = 0; i < v->u.object.length; i++) {
+		const json_object_entry *e = &v->u.object.values[i];
+		int k = audio_key(e, AUDIO_NBINS);
+		if (k < 0) {
+			return unknown(path, "frequencies", e);
+		}
+		if (get_float(path, audio_keys[k], e->value, &a->freq[k])) {
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+//{"4day_bee": [low, high], "6day_bee": [...], "9day_bee": [...]}
+static int get_age_dist(const char *path, const json_value *v, struct analysis_params *a) {
+	if (check_object(path, "bee_age_percent", v)) {
+		return -EINVAL;
+	}
+	for (unsigned i = 0; i < v->u.object.length; i++) {
+		const json_object_entry *e = &v->u.object.values[i];
+		int k = audio_key(e, AUDIO_9DAY_BEE + 1);
+		if (k < 0) {
+			return unknown(path, "bee_age_percent", e);
+		}
+		const json_value *r = e->value;
+		if (r->type != json_array || r->u.array.length != 2 ||
+		    get_float(path, audio_keys[k], r->u.array.values[0], &a->bee_age_dist[2 * k]) ||
+		    get_float(path, audio_keys[k], r->u.array.values[1], &a->bee_age_dist[2 * k + 1])) {
+			fprintf(stderr, "%s: bee_age_percent.%s should be [low, high]\n", path, audio_keys[k]);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+static int apply(struct hive_config *c, const char *path, const json_value *root) {
+	if (check_object(path, "the top level", root)) {
+		return -EINVAL;
+	}
+	for (unsigned i = 0; i < root->u.object.length; i++) {
+		const json_object_entry *e = &root->u.object.values[i];
+		const json_value *v = e->value;
+		const char *name;
+		int err;
+
+		if (key_is(e, "sample_rate")) {
+			err = get_int(path, "sample_rate", v, &c->analysis.sample_rate);
+		}
+		else if (key_is(e, "frame_size")) {
+			err = get_int(path, "frame_size", v, &c->frame_len);
+		}
+		else if (key_is(e, "hop")) {
+			err = get_int(path, "hop", v, &c->hop);
+		}
+		else if (key_is(e, "fft_size")) {
+			err = get_int(path, "fft_size", v, &c->nfft);
+		}
+		else if (key_is(e, "window")) {
+			err = get_string(path, "window", v, &name);
+			if (!err && window_type_parse(name, &c->window)) {
+				fprintf(stderr, "%s: window should be hann, hamming, blackman or rect\n", path);
+				err = -EINVAL;
+			}
+		}
+		else if (key_is(e, "fft")) {
+			const struct fft_backend *fft = NULL;
+			err = get_string(path, "fft", v, &name);
+			if (!err && !(fft = fft_backend_find(name, FFT_FLOAT))) {
+				fprintf(stderr, "%s: fft should be one of %s\n", path, fft_backend_names());
+				err = -EINVAL;
+			}
+			//the backend's own copy of the name, the parsed JSON is freed
+			c->fft = fft ? fft->name : c->fft;
+		}
+		else if (key_is(e, "precision")) {
+			err = get_string(path, "precision", v, &name);
+			if (!err && fft_precision_parse(name, &c->precision)) {
+				fprintf(stderr, "%s: precision should be float, double or q15\n", path);
+				err = -EINVAL;
+			}
+		}
+		else if (key_is(e, "humidity")) {
+			err = get_range(path, "humidity", v, &c->analysis.humidity_low, &c->analysis.humidity_high);
+		}
+		else if (key_is(e, "temperature")) {
+			err = get_range(path, "temperature", v, &c->analysis.temp_low, &c->analysis.temp_high);
+		}
+		else if (key_is(e, "peak_search_hz")) {
+			err = get_float(path, "peak_search_hz", v, &c->analysis.peak_search_hz);
+		}
+		else if (key_is(e, "frequencies")) {
+			err = get_frequencies(path, v, &c->analysis);
+		}
+		else if (key_is(e, "bee_age_percent")) {
+			err = get_age_dist(path, v, &c->analysis);
+		}
+		else {
+			err = unknown(path, NULL, e);
+		}
+		if (err) {
+			return err;
+		}
+	}
+	return 0;
+}
+
+int config_load(struct hive_config *c, const char *path) {
+	FILE *fp = fopen(path, "rb");
+	if (!fp) {
+		return -errno;
+	}
+	char *text = NULL;
+	size_t len = 0, cap = 0, nr;
+	do {
+		if (len == cap) {
+			cap = cap ? cap * 2 : 4096;
+			char *tmp = realloc(text, cap);
+			if (!tmp) {
+				free(text);
+				fclose(fp);
+				return -ENOMEM;
+			}
+			text = tmp;
+		}
+		nr = fread(text + len, 1, cap - len, fp);
+		len += nr;
+	} while (nr > 0);
+	int err = ferror(fp) ? -EIO : 0;
+	fclose(fp);
+	if (err) {
+		free(text);
+		return err;
+	}
+
+	json_value *root = json_parse(text, len);
+	free(text);
+	if (!root) {
+		fprintf(stderr, "%s: not valid JSON\n", path);
+		return -EINVAL;
+	}
+	err = apply(c, path, root);
+	json_value_free(root);
+	return err;
+}
+
+int config_check(const struct hive_config *c) {
+	const struct analysis_params *a = &c->analysis;
+
+	if (a->sample_rate <= 0) {
+		fprintf(stderr, "hive_process: sample rate must be a positive number of Hz\n");
+		return -EINVAL;
+	}
+	if (c->frame_len < FRAME_MIN || c->frame_len > FFT_MAX_SIZE || c->frame_len % 2) {
+		fprintf(stderr, "hive_process: frame size must be even and %d to %d samples\n",
+				FRAME_MIN, FFT_MAX_SIZE);
+		return -EINVAL;
+	}
+	if (c->hop < 0) {
+		fprintf(stderr, "hive_process: hop must be a positive number of samples\n");
+		return -EINVAL;
+	}
+	const struct fft_backend *fft = config_fft(c);
+	if (!fft) {
+		fprintf(stderr, "hive_process: the %s FFT has no %s precision build\n",
+				c->fft ? c->fft : FFT_DEFAULT_BACKEND, fft_precision_name(c->precision));
+		return -EINVAL;
+	}
+	if (c->nfft && (c->nfft < c->frame_len || c->nfft > FFT_MAX_SIZE || c->nfft % 2 ||
+			(fft->pow2_only && fft_next_pow2(c->nfft) != c->nfft))) {
+		fprintf(stderr, "hive_process: fft size must be even and %d to %d%s\n", c->frame_len, FFT_MAX_SIZE,
+				fft->pow2_only ? ", a power of two for this backend" : "");
+		return -EINVAL;
+	}
+	if (fft->pow2_only && !c->nfft && fft_next_pow2(c->frame_len) > FFT_MAX_SIZE) {
+		fprintf(stderr, "hive_process: frame size too big for %s\n", fft->name);
+		return -EINVAL;
+	}
+	if (a->peak_search_hz < 0) {
+		fprintf(stderr, "hive_process: peak_search_hz can't be negative\n");
+		return -EINVAL;
+	}
+	for (int i = 0; i < AUDIO_NBINS; i++) {
+		if (a->freq[i] < 0 || a->freq[i] > a->sample_rate / 2) {
+			fprintf(stderr, "hive_process: frequencies must be from 0 to %d Hz at this sample rate\n",
+					a->sample_rate / 2);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+const struct fft_backend *config_fft(const struct hive_config *c) {
+	return fft_backend_find(c->fft ? c->fft : FFT_DEFAULT_BACKEND, c->precision);
+}
@@ -0,0 +1,39 @@
+//analysis settings that used to be compile time constants: frame size, hop,
+//sample rate, window, FFT and the flag thresholds.  they start out as the
+//defaults in hive.h and analysis.c, then a JSON file (--config, see
+//hive_config.json) and the command line can change them.
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "analysis.h"
+#include "window.h"
+#include "fft.h"
+
+struct hive_config {
+	//samples per frame and between frame starts, hop 0 is one frame
+	int frame_len;
+	int hop;
+	enum window_type window;
+	//backend name, NULL for FFT_DEFAULT_BACKEND.  frames are zero padded to nfft,
+	//0 is frame_len or the next power of two for backends that need one.
+	const char *fft;
+	enum fft_precision precision;
+	int nfft;
+	//sample rate, frequencies and thresholds
+	struct analysis_params analysis;
+};
+
+void config_defaults(struct hive_config *c);
+
+//sets whatever the file at path has, the rest of c is left alone.
+//returns 0, -errno if it can't be read or -EINVAL (with the reason on stderr).
+int config_load(struct hive_config *c, const char *path);
+
+//0 if c can be used, otherwise -EINVAL with the reason on stderr
+int config_check(const struct hive_config *c);
+
+//the backend c asks for, NULL if it doesn't come in c->precision
+const struct fft_backend *config_fft(const struct hive_config *c);
+
+#endif
@@ -0,0 +1,104 @@
+//spectral features.
+//the whole spectrum values come out of a single pass that keeps FEATURE_LANES
+//independent partial sums, so the compiler can vectorise it without reordering
+//any float additions; the ranges around the bee frequencies are a few bins each.
+
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+
+#include "features.h"
+
+#define FEATURE_LANES 8
+
+//log2 to about 0.005, made of integer ops and a quadratic so it vectorises
+static inline float log2_approx(float x) {
+	uint32_t u;
+	float m;
+	memcpy(&u, &x, sizeof(u));
+	float e = (float)((int)(u >> 23) - 127);
+	u = (u & 0x7fffff) | 0x3f800000;
+	memcpy(&m, &u, sizeof(m));
+	return e + (-0.34484843f * m + 2.02466578f) * m - 1.67487759f;
+}
+
+//sum, bin weighted sum, power and log2 amplitude of bins [1, nbins)
+static void spectrum_sums(const float *amp, int nbins, float *sum, float *wsum, float *power, float *logsum) {
+	float s[FEATURE_LANES] = {0}, w[FEATURE_LANES] = {0}, q[FEATURE_LANES] = {0}, l[FEATURE_LANES] = {0};
+	int k = 1;
+
+	for (; k + FEATURE_LANES <= nbins; k += FEATURE_LANES) {
+		for (int j = 0; j < FEATURE_LANES; j++) {
+			float a = amp[k + j];
+			s[j] += a;
+			w[j] += (float)(k + j) * a;
+			q[j] += a * a;
+			//silent bins would be -inf, clamp them to the smallest normal float
+			l[j] += log2_approx(a > FLT_MIN ? a : FLT_MIN);
+		}
+	}
+	for (int j = 1; j < FEATURE_LANES; j++) {
+		s[0] += s[j];
+		w[0] += w[j];
+		q[0] += q[j];
+		l[0] += l[j];
+	}
+	for (; k < nbins; k++) {
+		float a = amp[k];
+		s[0] += a;
+		w[0] += (float)k * a;
+		q[0] += a * a;
+		l[0] += log2_approx(a > FLT_MIN ? a : FLT_MIN);
+	}
+	*sum = s[0];
+	*wsum = w[0];
+	*power = q[0];
+	*logsum = l[0];
+}
+
+void features_compute(const struct analysis_params *p, const float *amp, int nfft, int full, float *f) {
+	int first[AUDIO_NBINS], last[AUDIO_NBINS];
+	float bin_hz = (float)p->sample_rate / nfft;
+	int nbins = nfft / 2 + 1;
+	float energy[3] = {0};
+
+	memset(f, 0, FEATURE_COUNT * sizeof(float));
+	audio_ranges(p, nfft, first, last);
+	for (int i = 0; i < AUDIO_NBINS; i++) {
+		int best = first[i];
+		float level = 0;
+		for (int k = first[i]; k < last[i]; k++) {
+			if (amp[k] > amp[best]) {
+				best = k;
+			}
+			level += amp[k];
+			if (i < 3) {
+				energy[i] += amp[k] * amp[k];
+			}
+		}
+		f[FEATURE_PEAK_HZ + i] = best * bin_hz;
+		f[FEATURE_PEAK + i] = amp[best];
+		f[FEATURE_LEVEL + i] = level / (last[i] - first[i]);
+	}
+	float total = energy[0] + energy[1] + energy[2];
+	for (int i = 0; i < 3 && total > 0; i++) {
+		f[FEATURE_AGE_RATIO + i] = energy[i] / total;
+	}
+	if (!full || nbins < 2) {
+		return;
+	}
+
+	float sum, wsum, power, logsum;
+	spectrum_sums(amp, nbins, &sum, &wsum, &power, &logsum);
+	float log_floor = logsum / (nbins - 1);
+	float noise = exp2f(log_floor);
+	f[FEATURE_CENTROID] = sum > 0 ? wsum / sum * bin_hz : 0;
+	//the log approximation can push a flat spectrum a hair over 1
+	f[FEATURE_FLATNESS] = power > 0 ? fminf(exp2f(2 * log_floor) / (power / (nbins - 1)), 1) : 0;
+	f[FEATURE_NOISE_FLOOR] = noise;
+	for (int i = 0; i < AUDIO_NBINS; i++) {
+		float peak = f[FEATURE_PEAK + i];
+		f[FEATURE_SNR_DB + i] = peak > 0 && noise > 0 ? 20 * log10f(peak / noise) : 0;
+	}
+}
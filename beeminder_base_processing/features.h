@@ -0,0 +1,30 @@
+//spectral features of an amplitude spectrum, what audio_compare works from.
+//the features are a flat array of FEATURE_COUNT floats, indexed by the FEATURE_*
+//values below, which is also how they are stored in binary reports.
+
+#ifndef FEATURES_H
+#define FEATURES_H
+
+#include "analysis.h"
+
+enum {
+	//whole spectrum, DC left out
+	FEATURE_CENTROID,	//Hz, amplitude weighted mean frequency
+	FEATURE_FLATNESS,	//geometric over arithmetic mean power, 0 for a pure tone, 1 for white noise
+	FEATURE_NOISE_FLOOR,	//geometric mean amplitude, what the spectrum sits on between its peaks
+	//AUDIO_NBINS values each, around every AUDIO_* frequency (audio_ranges)
+	FEATURE_PEAK_HZ,	//where the strongest bin is
+	FEATURE_PEAK = FEATURE_PEAK_HZ + AUDIO_NBINS,	//its amplitude
+	FEATURE_LEVEL = FEATURE_PEAK + AUDIO_NBINS,	//mean amplitude over the range
+	FEATURE_SNR_DB = FEATURE_LEVEL + AUDIO_NBINS,	//peak over the noise floor
+	//energy of the 4, 6 and 9 day bee ranges as shares of their total
+	FEATURE_AGE_RATIO = FEATURE_SNR_DB + AUDIO_NBINS,
+	FEATURE_COUNT = FEATURE_AGE_RATIO + 3,
+};
+
+//features of amp, the nfft/2+1 bin amplitude spectrum of an nfft point FFT.
+//without full only the ranges are looked at (the rest of amp may be missing) and the
+//whole spectrum values and SNRs are 0.
+void features_compute(const struct analysis_params *p, const float *amp, int nfft, int full, float *features);
+
+#endif
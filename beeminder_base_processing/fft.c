@@ -0,0 +1,124 @@
+//backend registry and the kissfft backends.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "kiss_fftr.h"
+#include "fft.h"
+#include "fft_kiss_scalar.h"
+
+static void *kiss_alloc(int n) {
+	return kiss_fftr_alloc(n, 0, NULL, NULL);
+}
+
+static void kiss_forward(void *state, const float *in, kiss_fft_cpx *out) {
+	kiss_fftr(state, in, out);
+}
+
+static void kiss_free(void *state) {
+	kiss_fftr_free(state);
+}
+
+const struct fft_backend fft_backend_kiss = {
+	.name = "kiss",
+	.precision = FFT_FLOAT,
+	.pow2_only = 0,
+	.alloc = kiss_alloc,
+	.forward = kiss_forward,
+	.free = kiss_free,
+};
+
+//kiss_fft_cpx is a pair of floats here, the same layout the variants write
+static void kiss_double_forward(void *state, const float *in, kiss_fft_cpx *out) {
+	fft_kiss_double_forward(state, in, (float *)out);
+}
+
+const struct fft_backend fft_backend_kiss_double = {
+	.name = "kiss",
+	.precision = FFT_DOUBLE,
+	.pow2_only = 0,
+	.alloc = fft_kiss_double_alloc,
+	.forward = kiss_double_forward,
+	.free = fft_kiss_double_free,
+};
+
+static void kiss_q15_forward(void *state, const float *in, kiss_fft_cpx *out) {
+	fft_kiss_q15_forward(state, in, (float *)out);
+}
+
+const struct fft_backend fft_backend_kiss_q15 = {
+	.name = "kiss",
+	.precision = FFT_Q15,
+	.pow2_only = 0,
+	.alloc = fft_kiss_q15_alloc,
+	.forward = kiss_q15_forward,
+	.free = fft_kiss_q15_free,
+};
+
+static const struct fft_backend *backends[] = {
+	&fft_backend_kiss,
+	&fft_backend_kiss_double,
+	&fft_backend_kiss_q15,
+	&fft_backend_radix2,
+};
+
+const struct fft_backend *fft_backend_find(const char *name, enum fft_precision precision) {
+	for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+		if (strcmp(backends[i]->name, name) == 0 && backends[i]->precision == precision) {
+			return backends[i];
+		}
+	}
+	return NULL;
+}
+
+const char *fft_backend_names(void) {
+	return "kiss|radix2";
+}
+
+static const char *precision_names[] = {
+	[FFT_FLOAT] = "float",
+	[FFT_DOUBLE] = "double",
+	[FFT_Q15] = "q15",
+};
+
+const char *fft_precision_name(enum fft_precision precision) {
+	return precision_names[precision];
+}
+
+int fft_precision_parse(const char *name, enum fft_precision *precision) {
+	for (int p = 0; p < (int)(sizeof(precision_names) / sizeof(precision_names[0])); p++) {
+		if (strcmp(name, precision_names[p]) == 0) {
+			*precision = p;
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
+int fft_next_pow2(int n) {
+	int p = 1;
+	while (p < n) {
+		p <<= 1;
+	}
+	return p;
+}
+
+int fft_init(struct fft *f, const struct fft_backend *backend, int n) {
+	f->backend = backend;
+	f->n = n;
+	f->state = NULL;
+	//real transforms work on n/2 complex points, so n has to be even
+	if (n < 2 || n % 2 || (backend->pow2_only && fft_next_pow2(n) != n)) {
+		return -EINVAL;
+	}
+	f->state = backend->alloc(n);
+	return f->state ? 0 : -ENOMEM;
+}
+
+void fft_free(struct fft *f) {
+	if (f->state) {
+		f->backend->free(f->state);
+		f->state = NULL;
+	}
+}
@@ -0,0 +1,70 @@
+//real forward FFT backends.
+//every backend turns n real samples into the n/2+1 bins kiss_fftr produces, in
+//the same layout and with the same (lack of) scaling, so they can be swapped
+//without anything downstream noticing.  pick one by name at run time (--fft) or
+//change the default at build time with -DFFT_DEFAULT_BACKEND='"radix2"'.
+//a backend can come in more than one precision (--precision), frames are floats
+//in and out whatever the arithmetic inside is.
+
+#ifndef FFT_H
+#define FFT_H
+
+#include "kiss_fft.h"
+
+//biggest size the pipeline runs, frame buffers are kept on the stack
+#define FFT_MAX_SIZE 16384
+
+#ifndef FFT_DEFAULT_BACKEND
+#define FFT_DEFAULT_BACKEND "kiss"
+#endif
+
+enum fft_precision {
+	FFT_FLOAT,	//float32 throughout, the fast default
+	FFT_DOUBLE,	//double, the reference the others are checked against
+	FFT_Q15,	//int16 fixed point, what fits on the hive nodes
+};
+
+struct fft_backend {
+	const char *name;
+	enum fft_precision precision;
+	int pow2_only;		//only handles power of two sizes
+	//state for n point transforms, NULL when out of memory
+	void *(*alloc)(int n);
+	//in is n samples, out gets n/2+1 bins.  the state may be written to, so
+	//every thread needs its own
+	void (*forward)(void *state, const float *in, kiss_fft_cpx *out);
+	void (*free)(void *state);
+};
+
+extern const struct fft_backend fft_backend_kiss;
+extern const struct fft_backend fft_backend_kiss_double;
+extern const struct fft_backend fft_backend_kiss_q15;
+extern const struct fft_backend fft_backend_radix2;
+
+//NULL for an unknown name or a precision the backend doesn't come in
+const struct fft_backend *fft_backend_find(const char *name, enum fft_precision precision);
+//"kiss|radix2", for usage messages
+const char *fft_backend_names(void);
+
+//"float", "double" or "q15".  parse returns 0 or -EINVAL.
+const char *fft_precision_name(enum fft_precision precision);
+int fft_precision_parse(const char *name, enum fft_precision *precision);
+
+struct fft {
+	const struct fft_backend *backend;
+	int n;
+	void *state;
+};
+
+//returns 0, -EINVAL if the backend can't do n points or -ENOMEM
+int fft_init(struct fft *f, const struct fft_backend *backend, int n);
+void fft_free(struct fft *f);
+
+static inline void fft_forward(const struct fft *f, const float *in, kiss_fft_cpx *out) {
+	f->backend->forward(f->state, in, out);
+}
+
+//smallest power of two >= n
+int fft_next_pow2(int n);
+
+#endif
@@ -0,0 +1,77 @@
+//kissfft with a scalar other than float.
+//the Makefile builds this twice, with kiss_fft_scalar=double and with
+//FIXED_POINT=16, each time next to its own copy of kissfft whose symbols carry
+//the same suffix (KISS_DOUBLE and KISS_Q15), so all three link into one binary.
+//frames come in and go out as floats either way.
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "kiss_fftr.h"
+#include "fft_kiss_scalar.h"
+
+#ifdef FIXED_POINT
+#define VARIANT(f) fft_kiss_q15_##f
+#else
+#define VARIANT(f) fft_kiss_double_##f
+#endif
+
+struct kiss_scalar {
+	kiss_fftr_cfg cfg;
+	int n;
+	kiss_fft_scalar *in;
+	kiss_fft_cpx *out;
+};
+
+void VARIANT(free)(void *state) {
+	struct kiss_scalar *s = state;
+	if (!s) {
+		return;
+	}
+	kiss_fftr_free(s->cfg);
+	free(s->in);
+	free(s->out);
+	free(s);
+}
+
+void *VARIANT(alloc)(int n) {
+	struct kiss_scalar *s = calloc(1, sizeof(*s));
+	if (!s) {
+		return NULL;
+	}
+	s->n = n;
+	s->cfg = kiss_fftr_alloc(n, 0, NULL, NULL);
+	s->in = malloc(n * sizeof(kiss_fft_scalar));
+	s->out = malloc((n / 2 + 1) * sizeof(kiss_fft_cpx));
+	if (!s->cfg || !s->in || !s->out) {
+		VARIANT(free)(s);
+		return NULL;
+	}
+	return s;
+}
+
+void VARIANT(forward)(void *state, const float *in, float *out) {
+	struct kiss_scalar *s = state;
+	int n = s->n;
+
+	for (int i = 0; i < n; i++) {
+#ifdef FIXED_POINT
+		//frames are windowed int16 so they already fit, rounding is all that is lost
+		long v = lrintf(in[i]);
+		s->in[i] = v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+#else
+		s->in[i] = in[i];
+#endif
+	}
+	kiss_fftr(s->cfg, s->in, s->out);
+	for (int k = 0; k <= n / 2; k++) {
+#ifdef FIXED_POINT
+		//the fixed point transform divides by n on the way to keep in range
+		out[2 * k] = (float)s->out[k].r * n;
+		out[2 * k + 1] = (float)s->out[k].i * n;
+#else
+		out[2 * k] = s->out[k].r;
+		out[2 * k + 1] = s->out[k].i;
+#endif
+	}
+}
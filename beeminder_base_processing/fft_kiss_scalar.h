@@ -0,0 +1,16 @@
+//kissfft built with double and with Q15 (FIXED_POINT=16) scalars, see
+//fft_kiss_scalar.c.  no kissfft types in here, it sits next to the float kiss_fft.h.
+//in is n floats, out gets n/2+1 interleaved re, im pairs (the kiss_fft_cpx layout).
+
+#ifndef FFT_KISS_SCALAR_H
+#define FFT_KISS_SCALAR_H
+
+void *fft_kiss_double_alloc(int n);
+void fft_kiss_double_forward(void *state, const float *in, float *out);
+void fft_kiss_double_free(void *state);
+
+void *fft_kiss_q15_alloc(int n);
+void fft_kiss_q15_forward(void *state, const float *in, float *out);
+void fft_kiss_q15_free(void *state);
+
+#endif
@@ -0,0 +1,55 @@
+//power of two real FFT, the one the nodes run (hive_fft.h) so the spectra they
+//send match what this backend works out from the audio.  the transform is done in
+//place in the output, whose float kiss_fft_cpx bins have room for its n/2 points.
+
+#include <stdlib.h>
+
+#include "fft.h"
+#include "hive_fft.h"
+
+static void radix2_free(void *state) {
+	struct hive_fft *f = state;
+	if (!f) {
+		return;
+	}
+	hive_fft_free(f);
+	free(f);
+}
+
+static void *radix2_alloc(int n) {
+	struct hive_fft *f = malloc(sizeof(*f));
+	if (!f) {
+		return NULL;
+	}
+	if (hive_fft_init(f, n)) {
+		free(f);
+		return NULL;
+	}
+	return f;
+}
+
+static void radix2_forward(void *state, const float *in, kiss_fft_cpx *out) {
+	const struct hive_fft *f = state;
+	int half = f->half;
+	float *z = (float *)out;
+
+	for (int i = 0; i < half; i++) {
+		int j = f->bitrev[i];
+		z[2 * i] = in[2 * j];
+		z[2 * i + 1] = in[2 * j + 1];
+	}
+	hive_fft_real(f, z);
+	//the nyquist bin comes back next to the DC one
+	out[half].r = out[0].i;
+	out[half].i = 0;
+	out[0].i = 0;
+}
+
+const struct fft_backend fft_backend_radix2 = {
+	.name = "radix2",
+	.precision = FFT_FLOAT,
+	.pow2_only = 1,
+	.alloc = radix2_alloc,
+	.forward = radix2_forward,
+	.free = radix2_free,
+};
@@ -0,0 +1,126 @@
+//writes synthetic recordings in the format the hive nodes upload: a raw_hivedata
+//header followed by int16 audio.  the audio is a tone at each of the bee
+//frequencies plus white noise.  the tone levels are drawn from the seed, so
+//different seeds give different bee_flags, and the same seed always gives the
+//same file.
+//usage: gen_hive [--seconds s] [--seed n] [--amp a] [--noise rms] [--rate hz]
+//                [--weight w] [--humidity h] [--temperature t] [out.in]
+//writes to stdout without a file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hive.h"
+#include "analysis.h"
+
+#define PI 3.14159265358979323846
+#define CHUNK 4096
+
+//xorshift64*, so the output doesn't depend on the libc's rand()
+static uint64_t rng_state;
+
+static double rng_uniform(void) {
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return ((rng_state * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_gauss(void) {
+	double u = rng_uniform(), v = rng_uniform();
+	return sqrt(-2 * log(u + 1e-300)) * cos(2 * PI * v);
+}
+
+int main(int argc, char **argv) {
+	static const int freqs[] = {HIVE_FREQ_9DAY_BEE, HIVE_FREQ_6DAY_BEE, HIVE_FREQ_4DAY_BEE, HIVE_FREQ_QUEEN};
+	double seconds = 10, amp = 2000, noise = 300;
+	unsigned long seed = 1;
+	int rate = SAMPLE_RATE;
+	struct raw_hivedata hdr = {.weight = 1500, .humidity = 5500, .temperature = 9450};
+	const char *path = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoul(argv[++i], NULL, 0);
+		}
+		else if (strcmp(argv[i], "--amp") == 0 && i + 1 < argc) {
+			amp = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc) {
+			noise = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+			rate = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--weight") == 0 && i + 1 < argc) {
+			hdr.weight = strtoul(argv[++i], NULL, 0);
+		}
+		else if (strcmp(argv[i], "--humidity") == 0 && i + 1 < argc) {
+			hdr.humidity = strtoul(argv[++i], NULL, 0);
+		}
+		else if (strcmp(argv[i], "--temperature") == 0 && i + 1 < argc) {
+			hdr.temperature = strtoul(argv[++i], NULL, 0);
+		}
+		else if (argv[i][0] != '-' && !path) {
+			path = argv[i];
+		}
+		else {
+			fprintf(stderr, "usage: %s [--seconds s] [--seed n] [--amp a] [--noise rms] [--rate hz]\n"
+					"       [--weight w] [--humidity h] [--temperature t] [out.in]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (seconds < 0) {
+		fprintf(stderr, "gen_hive: seconds can't be negative\n");
+		return 2;
+	}
+	if (rate <= 0) {
+		fprintf(stderr, "gen_hive: rate must be a positive number of Hz\n");
+		return 2;
+	}
+	rng_state = seed * 0x9e3779b97f4a7c15ULL + 1;
+
+	int ntones = sizeof(freqs) / sizeof(freqs[0]);
+	double level[sizeof(freqs) / sizeof(freqs[0])], phase[sizeof(freqs) / sizeof(freqs[0])];
+	for (int k = 0; k < ntones; k++) {
+		level[k] = amp * rng_uniform();
+		phase[k] = 2 * PI * rng_uniform();
+	}
+
+	FILE *fp = path ? fopen(path, "wb") : stdout;
+	if (!fp) {
+		perror(path);
+		return 1;
+	}
+	//the header goes out as the node sends it, little endian
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+
+	size_t total = seconds * rate;
+	int16_t chunk[CHUNK];
+	for (size_t done = 0; done < total; ) {
+		size_t n = total - done < CHUNK ? total - done : CHUNK;
+		for (size_t i = 0; i < n; i++) {
+			double t = (double)(done + i) / rate;
+			double v = noise * rng_gauss();
+			for (int k = 0; k < ntones; k++) {
+				v += level[k] * sin(2 * PI * freqs[k] * t + phase[k]);
+			}
+			chunk[i] = v > 32767 ? 32767 : v < -32768 ? -32768 : lrint(v);
+		}
+		fwrite(chunk, sizeof(int16_t), n, fp);
+		done += n;
+	}
+	if (fflush(fp) || ferror(fp)) {
+		perror(path ? path : "stdout");
+		return 1;
+	}
+	if (path) {
+		fclose(fp);
+	}
+	return 0;
+}
@@ -0,0 +1,46 @@
+//Goertzel recurrence, run for every bin side by side so x is only read once.
+//state is kept in double: over thousands of samples the float recurrence drifts
+//noticeably for bins near the ends of the spectrum.
+
+#include <errno.h>
+#include <math.h>
+
+#include "goertzel.h"
+
+#define PI 3.14159265358979323846
+
+int goertzel_init(struct goertzel *g, const int *bins, int nbins, int n, int len) {
+	if (nbins <= 0 || nbins > GOERTZEL_MAX_BINS || len <= 0 || n < len) {
+		return -EINVAL;
+	}
+	g->len = len;
+	g->nbins = nbins;
+	for (int k = 0; k < nbins; k++) {
+		if (bins[k] < 0 || bins[k] > n / 2) {
+			return -EINVAL;
+		}
+		g->bin[k] = bins[k];
+		g->coef[k] = 2 * cos(2 * PI * bins[k] / n);
+	}
+	return 0;
+}
+
+void goertzel_run(const struct goertzel *g, const float *x, double *power) {
+	double s1[GOERTZEL_MAX_BINS] = {0}, s2[GOERTZEL_MAX_BINS] = {0};
+	int nbins = g->nbins;
+
+	for (int i = 0; i < g->len; i++) {
+		double v = x[i];
+		for (int k = 0; k < nbins; k++) {
+			double s = v + g->coef[k] * s1[k] - s2[k];
+			s2[k] = s1[k];
+			s1[k] = s;
+		}
+	}
+	for (int k = 0; k < nbins; k++) {
+		power[k] = s1[k] * s1[k] + s2[k] * s2[k] - g->coef[k] * s1[k] * s2[k];
+		if (power[k] < 0) {
+			power[k] = 0;
+		}
+	}
+}
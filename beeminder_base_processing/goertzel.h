@@ -0,0 +1,26 @@
+//Goertzel filters: single DFT bins without a full FFT.
+//each bin costs one multiply-add per sample, so for a handful of bins this is
+//much cheaper than the FFT and gives the same values.
+
+#ifndef GOERTZEL_H
+#define GOERTZEL_H
+
+//enough for the few bins searched around each bee frequency
+#define GOERTZEL_MAX_BINS 128
+
+struct goertzel {
+	int len;
+	int nbins;
+	int bin[GOERTZEL_MAX_BINS];
+	double coef[GOERTZEL_MAX_BINS];	//2cos(2 pi bin / n)
+};
+
+//filters for bins of an n point DFT of a len point frame.  n > len is the same
+//as zero padding the frame to n, without running over the zeros.
+//returns 0 or -EINVAL.
+int goertzel_init(struct goertzel *g, const int *bins, int nbins, int n, int len);
+
+//|X[bin]|^2 of x for every bin, all bins in one pass over x
+void goertzel_run(const struct goertzel *g, const float *x, double *power);
+
+#endif
@@ -0,0 +1,33 @@
+//data shared between hive_process and the report readers/writers.
+
+#ifndef HIVE_H
+#define HIVE_H
+
+#include <stdint.h>
+
+//the nodes record at SAMPLE_RATE and the spectrum is taken over BUF_SIZE sample frames
+#define SAMPLE_RATE 16000
+#define BUF_SIZE 4000
+//bins a real FFT of BUF_SIZE samples fills, the rest of fft_array is always 0
+#define NBINS (BUF_SIZE/2+1)
+
+#define OK_FLAG 0
+#define LOW_FLAG 1
+#define HIGH_FLAG 2
+
+//header the hive node sends in front of the audio
+struct raw_hivedata{
+	uint32_t weight;
+	uint32_t humidity;
+	uint32_t temperature;
+};
+struct hivedata{
+	uint32_t weight;
+	uint32_t humidity;
+	uint32_t temperature;
+	uint8_t humidity_flag;
+	uint8_t temperature_flag;
+	uint8_t bee_flags[6];
+};
+
+#endif
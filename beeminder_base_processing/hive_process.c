@@ -8,234 +8,627 @@
  #include <errno.h>
  #include <stdint.h>
  #include <string.h>
- #include <sys/mman.h>
+ #include <sys/stat.h>
  #include <fcntl.h>
  #include <unistd.h>
- #include <math.h>
- #include <sys/time.h>
- #include <time.h>
+ #include <pthread.h>
+ #include <dirent.h>
  
- #include "kiss_fft.h"
- #include "kiss_fftr.h"
- #include "json-builder.h"
+ #include "fft.h"
+ #include "pipeline.h"
+ #include "monitor.h"
  
- #define HUMIDITY_LOW 4500
-#define HUMIDITY_HIGH 6500
-#define TEMP_LOW 9300
-#define TEMP_HIGH 9600
-
-#define BUF_SIZE 4000
-#define WINDOW_SIZE 2000
-
-#define OK_FLAG 0
-#define LOW_FLAG 1
-#define HIGH_FLAG 2
-
-#define FREQ_4DAY_BEE 285
-#define FREQ_6DAY_BEE 225
-#define FREQ_9DAY_BEE 190
-#define FREQ_QUEEN 400
-#define SAMPLE_RATE 16000
-
-#define PI 3.141592653
-
-struct raw_hivedata{
-	uint32_t weight;
-	uint32_t humidity;
-	uint32_t temperature;
-};
-struct hivedata{
-	uint32_t weight;
-	uint32_t humidity;
-	uint32_t temperature;
-	uint8_t humidity_flag;
-	uint8_t temperature_flag;
-	uint8_t bee_flags[6];
-};
-
-//read wave header
- int read_hivedata(FILE *fp, struct raw_hivedata *dest) {
-   if (!dest || !fp) {
-	printf("could not find file \n");
-     return -ENOENT;
-   }
-
-   fseek(fp, 0, SEEK_SET);
-   fread(dest, sizeof(struct raw_hivedata), 1, fp);
-   //printf("done read hive data \n");
-   return 0;
+ #include "analysis.h"
+
+//--monitor time scales in seconds without --monitor-scales: one burst the nodes
+//record, a minute and ten minutes
+#define MONITOR_SCALES {5, 60, 600}
+//--fmin for log bands without one
+#define BANDS_LOG_FMIN 50
+
+ //frames are a 4 byte little endian length followed by that many bytes
+ static int read_frame_len(FILE *fp, uint32_t *len) {
+	uint8_t hdr[4];
+	if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr)) {
+		return -1;
+	}
+	*len = hdr[0] | hdr[1] << 8 | hdr[2] << 16 | (uint32_t)hdr[3] << 24;
+	return 0;
+ }
+
+ static int write_frame(FILE *fp, const char *data, uint32_t len) {
+	uint8_t hdr[4] = {len, len >> 8, len >> 16, len >> 24};
+	if (fwrite(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) ||
+	    fwrite(data, 1, len, fp) != len || fflush(fp)) {
+		return -EIO;
+	}
+	return 0;
+ }
+
+ //--stats: one line of JSON on stderr per recording, built in the caller's line buffer
+ static void emit_stats(const struct fft_plan *plan, const char *file, struct report_buf *line) {
+	plan->stats->scratch_bytes = plan->scratch->total;
+	if (stats_json(line, plan->stats, file) == 0 && report_raw(line, "\n") == 0) {
+		//one write per line so lines from batch workers don't interleave
+		fwrite(line->data, 1, line->len, stderr);
+	}
+ }
+
+ //long running mode: one framed recording in on stdin, one framed report out on stdout.
+ //the FFT plan and window are made once and reused for every request.
+ int serve(const struct fft_plan *plan) {
+	char *req = NULL;
+	size_t cap = 0;
+	uint32_t len;
+	struct report_buf report, line;
+
+	report_buf_init(&report);
+	report_buf_init(&line);
+
+	while (read_frame_len(stdin, &len) == 0) {
+		uint64_t t = 0;
+		arena_reset(plan->scratch);
+		if (plan->stats) {
+			stats_begin(plan->stats);
+			t = plan->stats->start;
+		}
+		if (len > cap) {
+			char *tmp = realloc(req, len);
+			if (!tmp) {
+				fprintf(stderr, "hive_process: request of %u bytes too large\n", len);
+				break;
+			}
+			req = tmp;
+			cap = len;
+		}
+		if (fread(req, 1, len, stdin) != len) {
+			fprintf(stderr, "hive_process: truncated request\n");
+			break;
+		}
+		if (plan->stats) {
+			STATS_ADD(plan->stats, STAT_READ, t);
+			plan->stats->bytes_read = len;
+		}
+		//an empty or short request still gets a (zeroed) report so the client never blocks
+		if (process_recording((uint8_t *)req, len, plan, &report) ||
+		    write_frame(stdout, report.data, report.len)) {
+			break;
+		}
+		if (plan->stats) {
+			stats_end(plan->stats);
+			emit_stats(plan, NULL, &line);
+		}
+	}
+	report_buf_free(&line);
+	report_buf_free(&report);
+	free(req);
+	return feof(stdin) ? 0 : 1;
+ }
+
+ //batch mode: a pool of workers pulls recordings off a shared list.
+ //every worker builds its own plan so nothing but the list and stdout is shared.
+ struct batch {
+	char **files;
+	size_t nfiles;
+	size_t next;
+	pthread_mutex_t lock;
+	struct plan_options opt;
+	int jsonl;
+	const char *out_dir;
+	int failed;
+ };
+
+ static int has_suffix(const char *s, const char *suffix) {
+	size_t ls = strlen(s), lx = strlen(suffix);
+	return ls >= lx && strcmp(s + ls - lx, suffix) == 0;
  }
- 
- //handles temperature, humidity, and timestamp reading into hive struct
- //as well as comparing to threshold values predetermined by bee science :)
- void th_handle(struct raw_hivedata *raw_hive, struct hivedata *hive) {
 
-	hive->weight = raw_hive->weight;
-	hive->temperature = raw_hive->temperature;
-	hive->humidity = raw_hive->humidity;
+ static int add_file(struct batch *b, const char *path) {
+	char **tmp = realloc(b->files, (b->nfiles + 1) * sizeof(char *));
+	if (!tmp) {
+		return -ENOMEM;
+	}
+	//the old block may be gone already, so keep the new one even if strdup fails
+	b->files = tmp;
+	if (!(tmp[b->nfiles] = strdup(path))) {
+		return -ENOMEM;
+	}
+	b->nfiles++;
+	return 0;
+ }
 
-	if(hive->humidity > HUMIDITY_HIGH) {
-		hive->humidity_flag = HIGH_FLAG;
+ static int cmp_names(const void *a, const void *b) {
+	return strcmp(*(char *const *)a, *(char *const *)b);
+ }
+
+ //files are taken as given, directories contribute every *.in inside them
+ static int add_input(struct batch *b, const char *path) {
+	struct stat st;
+	if (stat(path, &st)) {
+		perror(path);
+		return -ENOENT;
 	}
-	else if (hive->humidity < HUMIDITY_LOW) {
-		hive->humidity_flag = LOW_FLAG;
+	if (!S_ISDIR(st.st_mode)) {
+		return add_file(b, path);
 	}
-	else {
-		hive->humidity_flag = OK_FLAG;
+	DIR *dir = opendir(path);
+	if (!dir) {
+		perror(path);
+		return -ENOENT;
+	}
+	size_t first = b->nfiles;
+	struct dirent *de;
+	char full[4096];
+	while ((de = readdir(dir))) {
+		if (!has_suffix(de->d_name, ".in")) {
+			continue;
+		}
+		snprintf(full, sizeof(full), "%s/%s", path, de->d_name);
+		if (add_file(b, full)) {
+			closedir(dir);
+			return -ENOMEM;
+		}
 	}
-	
-	if(hive->temperature > TEMP_HIGH) {
-		hive->temperature_flag = HIGH_FLAG;
+	closedir(dir);
+	qsort(b->files + first, b->nfiles - first, sizeof(char *), cmp_names);
+	return 0;
+ }
+
+ //Data/dev.in -> Data/dev.<ext>, or <out_dir>/dev.<ext> with an out_dir
+ static void output_path(const char *out_dir, const char *in, const char *ext, char *out, size_t len) {
+	const char *name = in;
+	if (out_dir) {
+		const char *slash = strrchr(in, '/');
+		name = slash ? slash + 1 : in;
 	}
-	else if (hive->temperature < TEMP_LOW) {
-		hive->temperature_flag = LOW_FLAG;
+	size_t n = strlen(name);
+	if (has_suffix(name, ".in")) {
+		n -= 3;
+	}
+	if (out_dir) {
+		snprintf(out, len, "%s/%.*s.%s", out_dir, (int)n, name, ext);
 	}
 	else {
-		hive->temperature_flag = OK_FLAG;
+		snprintf(out, len, "%.*s.%s", (int)n, name, ext);
+	}
+ }
+
+ //line is the worker's buffer for the quoted file name
+ static int batch_output(struct batch *b, const char *in, const struct report_buf *report,
+		 struct report_buf *line) {
+	if (b->jsonl) {
+		report_buf_reset(line);
+		if (report_string(line, in)) {
+			return -ENOMEM;
+		}
+		pthread_mutex_lock(&b->lock);
+		printf("{\"file\":%s,\"report\":", line->data);
+		fwrite(report->data, 1, report->len, stdout);
+		fputs("}\n", stdout);
+		pthread_mutex_unlock(&b->lock);
+		return 0;
+	}
+	char out[4096];
+	output_path(b->out_dir, in, b->opt.format == FORMAT_JSON ? "json" : "bin", out, sizeof(out));
+	FILE *fp = fopen(out, "wb");
+	if (!fp) {
+		perror(out);
+		return -EIO;
+	}
+	fwrite(report->data, 1, report->len, fp);
+	return fclose(fp) ? -EIO : 0;
+ }
+
+ static void *batch_worker(void *arg) {
+	struct batch *b = arg;
+	struct fft_plan plan;
+	struct report_buf report, line;
+	struct hive_stats stats;
+
+	if (fft_plan_init(&plan, &b->opt)) {
+		pthread_mutex_lock(&b->lock);
+		b->failed = 1;
+		pthread_mutex_unlock(&b->lock);
+		return NULL;
+	}
+	if (b->opt.stats) {
+		plan.stats = &stats;
+	}
+	report_buf_init(&report);
+	report_buf_init(&line);
+	while (1) {
+		pthread_mutex_lock(&b->lock);
+		size_t i = b->next < b->nfiles ? b->next++ : b->nfiles;
+		pthread_mutex_unlock(&b->lock);
+		if (i == b->nfiles) {
+			break;
+		}
+		const char *in = b->files[i];
+		int err = -ENOENT;
+		arena_reset(plan.scratch);
+		if (plan.stats) {
+			stats_begin(plan.stats);
+		}
+		//the spectrogram goes next to the report, dev.spec
+		if (plan.spectrogram) {
+			char spec[4096];
+			output_path(b->out_dir, in, "spec", spec, sizeof(spec));
+			if (!(plan.spectrogram_out = fopen(spec, "wb"))) {
+				perror(spec);
+			}
+		}
+		int fd = open(in, O_RDONLY);
+		if (fd >= 0 && (!plan.spectrogram || plan.spectrogram_out)) {
+			err = process_fd(fd, &plan, 0, &report);
+		}
+		if (fd >= 0) {
+			close(fd);
+		}
+		if (plan.spectrogram_out) {
+			if (fclose(plan.spectrogram_out) && !err) {
+				err = -EIO;
+			}
+			plan.spectrogram_out = NULL;
+		}
+		if (plan.stats && !err) {
+			stats_end(plan.stats);
+			emit_stats(&plan, in, &line);
+		}
+		if (err || batch_output(b, in, &report, &line)) {
+			fprintf(stderr, "hive_process: failed to process %s\n", in);
+			pthread_mutex_lock(&b->lock);
+			b->failed = 1;
+			pthread_mutex_unlock(&b->lock);
+		}
 	}
-	//printf("finished th handle");
+	report_buf_free(&line);
+	report_buf_free(&report);
+	fft_plan_free(&plan);
+	return NULL;
  }
 
-//handles the FFT process for the entire WAVE file.   
-void FFT_handle(FILE *fp, float* master_fft_array) {
-	kiss_fftr_cfg cfg = kiss_fftr_alloc(BUF_SIZE, 0, NULL, NULL);
-	int16_t int_buf[BUF_SIZE];
-	float buf[BUF_SIZE];
-	size_t nr;
-	kiss_fft_cpx fft_output[BUF_SIZE/2+1];
-	unsigned int start = sizeof(struct raw_hivedata);
-	fseek(fp, start, SEEK_SET);
-	
-	//loop through the whole file
-	while(!feof(fp)) {
-		//read into the buffer
-		nr = fread(int_buf, 1, sizeof(int_buf), fp);
-		if (nr != sizeof(int_buf)) {
+ int run_batch(struct batch *b, int jobs) {
+	if (jobs <= 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		jobs = n > 0 ? n : 1;
+	}
+	if ((size_t)jobs > b->nfiles) {
+		jobs = b->nfiles ? b->nfiles : 1;
+	}
+	pthread_t *threads = calloc(jobs, sizeof(pthread_t));
+	if (!threads) {
+		return 1;
+	}
+	pthread_mutex_init(&b->lock, NULL);
+	int started = 0;
+	for (; started < jobs; started++) {
+		if (pthread_create(&threads[started], NULL, batch_worker, b)) {
 			break;
 		}
-		//window the buffer
-		for(int i = 0; i < sizeof(int_buf)/2; i++) {
-			buf[i] = (float)int_buf[i]*0.5*(1-cos(2*PI*i/(BUF_SIZE - 1)));
-		}
-		//run fft on this window, calculate magnitudes and add it to master array
-		kiss_fftr(cfg, buf, fft_output);
-		for(int i = 0; i < sizeof(fft_output)/8; i++) {
-			float magnitude = sqrt(pow(fft_output[i].r, 2)+pow(fft_output[i].i, 2));
-			master_fft_array[i] += magnitude;
-		}
-		//advance the start offset for the next loop by half a window length
-		start += WINDOW_SIZE*sizeof(float);
-		//go to the next position
-		fseek(fp, start, SEEK_SET); 
-	}
-	kiss_fftr_free(cfg);
-	fclose(fp);
-	//printf("finished fft \n");
-}
-
-//compares fft output of the file to expected values and modifies hive data file
-//with flags corresponding to levels of desired frequencies.
-int audio_compare(float *fft_array, int numsamples, struct hivedata *hive) {
-	
-	//define thresholds for bee age distribution as percentages of total population
-	//4daybee_low, 4daybee_high, 6daybee_low, 6daybee_high, 9daybee_low, 9daybee_high
-	float bee_age_dist[] = {17.9, 28.1, 34.6, 47.5, 33.2, 41.6};
-
-	//frequency bin size is 4Hz
-	int freq_bin_size = SAMPLE_RATE/numsamples;
-	//calculate amplitudes of different bee ages
-	float amp_3day_bee = fft_array[FREQ_4DAY_BEE/freq_bin_size];
-	float amp_6day_bee = fft_array[FREQ_6DAY_BEE/freq_bin_size];
-	float amp_9day_bee = fft_array[FREQ_9DAY_BEE/freq_bin_size];
-	float amp_queen = fft_array[FREQ_QUEEN/freq_bin_size];
-	//the 3 age ranges only cover about 80% of the population of the hive.
-	//assuming the other 20% of the bees are still in the hive, 
-	//we will need to scale the amplitude by a factor of 1.2.
-	//since the queen is only 1 bee, we do not include her in this calculation.
-	float amp_total_bee = 1.2*(amp_3day_bee + amp_6day_bee + amp_9day_bee);
-	for (int i = 0; i < sizeof(hive->bee_flags); i++) {
-		hive->bee_flags[i] = OK_FLAG;
-	}
-	
-	//get age distribution as percentages and flag
-	float amp_3day_bee_percentage = (float)amp_3day_bee/amp_total_bee*100;
-	float amp_6day_bee_percentage = (float)amp_6day_bee/amp_total_bee*100;
-	float amp_9day_bee_percentage = (float)amp_9day_bee/amp_total_bee*100;
-	if (amp_3day_bee_percentage < bee_age_dist[0]) {
-		hive->bee_flags[3] = LOW_FLAG;
-		hive->bee_flags[2] = 1;
-	}
-	else if(amp_3day_bee_percentage > bee_age_dist[1]) {
-		hive->bee_flags[3] = HIGH_FLAG;
-	}
-	if (amp_6day_bee_percentage < bee_age_dist[2]) {
-		hive->bee_flags[4] = LOW_FLAG;
-	}
-	else if(amp_6day_bee_percentage > bee_age_dist[3]) {
-		hive->bee_flags[4] = HIGH_FLAG;
-	}
-	if (amp_9day_bee_percentage < bee_age_dist[4]) {
-		hive->bee_flags[5] = LOW_FLAG;
-	}
-	else if(amp_9day_bee_percentage > bee_age_dist[5]) {
-		hive->bee_flags[5] = HIGH_FLAG;
-	}
-	
-	//check presence of queen.  if her amplitude is higher 
-	//than the amplitude of much higher frequencies (which we would not expect to see much of)
-	//we can say we have detected a queen.  Flag for presence is 0 for false, 1 for true.
-	if (amp_queen > 2*fft_array[FREQ_QUEEN*2]) {
-		hive->bee_flags[0] = 1;
-		if (amp_queen > amp_3day_bee) {
-			hive->bee_flags[1] = 1;
-		}
-	}
-	
-	//printf("3 Day Bee percentage: %f\n", amp_3day_bee_percentage);
-	//printf("6 Day Bee percentage: %f\n", amp_6day_bee_percentage);
-	//printf("9 Day Bee percentage: %f\n", amp_9day_bee_percentage);
-	//printf("Queen in hive?: %d\n", hive->bee_flags[3]);
+	}
+	if (started == 0) {
+		//no threads available, do the work here
+		batch_worker(b);
+	}
+	for (int i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&b->lock);
+	free(threads);
+	return b->failed;
+ }
+
+ static int parse_format(const char *s, enum report_format *format) {
+	if (strcmp(s, "json") == 0) {
+		*format = FORMAT_JSON;
+	}
+	else if (strcmp(s, "bin") == 0) {
+		*format = FORMAT_BIN;
+	}
+	else if (strcmp(s, "bin16") == 0) {
+		*format = FORMAT_BIN16;
+	}
+	else {
+		return -EINVAL;
+	}
 	return 0;
-} 
+ }
 
  int main(int argc, char** argv) {
-	//printf("starting hive process \n");
-  	FILE* fp;
-   	FILE* hivefp;
-   	struct hivedata hive;
-   	struct raw_hivedata raw_hive;
-   	fp = stdin;
-   	float fft_array[BUF_SIZE];
-   	FFT_handle(fp, fft_array);
-   	read_hivedata(fp, &raw_hive);
-   	th_handle(&raw_hive, &hive);
-   	audio_compare(fft_array, sizeof(fft_array)/4, &hive);
-   	hivefp = stdout;
-   	//fseek(hivefp, 0, SEEK_SET);
-	
-	//printf("arrived at json object creation \n");
-
-	json_value *arr = json_array_new(0);
-	json_value *bee_flags = json_object_new(0);
-	for (int i = 0; i < sizeof(fft_array)/sizeof(float); i++) {
-			json_array_push(arr, json_double_new((double)fft_array[i]));
-	}
-	json_object_push(bee_flags, "queen_present", json_integer_new((int)hive.bee_flags[0]));
-	json_object_push(bee_flags, "multiple_queen", json_integer_new((int)hive.bee_flags[1]));
-	json_object_push(bee_flags, "possible_mites", json_integer_new((int)hive.bee_flags[2]));
-	json_object_push(bee_flags, "three_day_in_range", json_integer_new((int)hive.bee_flags[3]));
-	json_object_push(bee_flags, "six_day_in_range", json_integer_new((int)hive.bee_flags[4]));
-	json_object_push(bee_flags, "nine_day_in_range", json_integer_new((int)hive.bee_flags[0]));
-	
-	json_value *output = json_object_new(0);
-	json_object_push(output, "temp", json_integer_new((int)hive.temperature));
-	json_object_push(output, "humidity", json_integer_new((int)hive.humidity));
-	json_object_push(output, "weight", json_integer_new((int)hive.weight));
-	json_object_push(output, "bee_flags", bee_flags);
-	json_object_push(output, "fft_data", arr);
-
-	char *buf = malloc(json_measure(output));
-	json_serialize(buf, output);
-
-    	printf("%s",buf);
+	struct fft_plan plan;
+	struct plan_options opt = {
+		.mode = SPECTRUM_MAGNITUDE,
+		.threads = 1,
+		.format = FORMAT_JSON,
+		.nbands = -1,
+		.band_scale = BANDS_MEL,
+		.fmin = -1,
+	};
+	int band_opts = 0;
+	int serve_mode = 0;
+	int partial = 0;
+	const char *path = NULL;
+	int batch_mode = 0;
+	int jobs = 0;
+	const char *spectrogram_path = NULL;
+	int monitor_mode = 0;
+	float scales[MONITOR_MAX_SCALES] = MONITOR_SCALES;
+	int nscales = 3;
+	struct batch batch = {0};
+	int ret = 0;
+
+	config_defaults(&opt.cfg);
+	//the file goes in first so anything on the command line overrides it
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--config") == 0) {
+			int err = config_load(&opt.cfg, argv[++i]);
+			if (err == -EINVAL) {
+				return 2;
+			}
+			if (err) {
+				fprintf(stderr, "hive_process: %s: %s\n", argv[i], strerror(-err));
+				return 2;
+			}
+		}
+	}
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--serve") == 0) {
+			serve_mode = 1;
+		}
+		else if (strcmp(argv[i], "--power") == 0) {
+			opt.mode = SPECTRUM_POWER;
+		}
+		else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+			i++;
+		}
+		else if (strcmp(argv[i], "--hop") == 0 && i + 1 < argc) {
+			opt.cfg.hop = atoi(argv[++i]);
+			if (opt.cfg.hop <= 0) {
+				fprintf(stderr, "hive_process: hop must be a positive number of samples\n");
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--frame-size") == 0 && i + 1 < argc) {
+			opt.cfg.frame_len = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--sample-rate") == 0 && i + 1 < argc) {
+			opt.cfg.analysis.sample_rate = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc &&
+				window_type_parse(argv[i + 1], &opt.cfg.window) == 0) {
+			i++;
+		}
+		else if (strcmp(argv[i], "--humidity-low") == 0 && i + 1 < argc) {
+			opt.cfg.analysis.humidity_low = strtoul(argv[++i], NULL, 0);
+		}
+		else if (strcmp(argv[i], "--humidity-high") == 0 && i + 1 < argc) {
+			opt.cfg.analysis.humidity_high = strtoul(argv[++i], NULL, 0);
+		}
+		else if (strcmp(argv[i], "--temp-low") == 0 && i + 1 < argc) {
+			opt.cfg.analysis.temp_low = strtoul(argv[++i], NULL, 0);
+		}
+		else if (strcmp(argv[i], "--temp-high") == 0 && i + 1 < argc) {
+			opt.cfg.analysis.temp_high = strtoul(argv[++i], NULL, 0);
+		}
+		else if (strcmp(argv[i], "--partial") == 0 && i + 1 < argc) {
+			partial = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			opt.threads = atoi(argv[++i]);
+		}
+		else if (strncmp(argv[i], "--format=", 9) == 0 && parse_format(argv[i] + 9, &opt.format) == 0) {
+		}
+		else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc && parse_format(argv[i + 1], &opt.format) == 0) {
+			i++;
+		}
+		else if (strcmp(argv[i], "--bands") == 0 && i + 1 < argc) {
+			opt.nbands = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--band-scale") == 0 && i + 1 < argc &&
+				(strcmp(argv[i + 1], "mel") == 0 || strcmp(argv[i + 1], "log") == 0)) {
+			opt.band_scale = strcmp(argv[++i], "log") == 0 ? BANDS_LOG : BANDS_MEL;
+			band_opts = 1;
+		}
+		else if (strcmp(argv[i], "--fmin") == 0 && i + 1 < argc) {
+			opt.fmin = atof(argv[++i]);
+			band_opts = 1;
+		}
+		else if (strcmp(argv[i], "--fmax") == 0 && i + 1 < argc) {
+			opt.fmax = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--trim") == 0) {
+			opt.trim = 1;
+		}
+		else if (strcmp(argv[i], "--flags-only") == 0) {
+			opt.flags_only = 1;
+		}
+		else if (strcmp(argv[i], "--stats") == 0) {
+			opt.stats = 1;
+		}
+		else if (strcmp(argv[i], "--spectrogram") == 0 && i + 1 < argc) {
+			opt.spectrogram = atoi(argv[++i]);
+			if (opt.spectrogram <= 0) {
+				fprintf(stderr, "hive_process: spectrogram rows need at least 1 frame\n");
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--spectrogram-out") == 0 && i + 1 < argc) {
+			spectrogram_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--monitor") == 0) {
+			monitor_mode = 1;
+		}
+		else if (strcmp(argv[i], "--monitor-scales") == 0 && i + 1 < argc) {
+			nscales = monitor_parse_scales(argv[++i], scales, MONITOR_MAX_SCALES);
+			if (nscales < 0) {
+				fprintf(stderr, "hive_process: --monitor-scales takes up to %d comma separated seconds\n",
+						MONITOR_MAX_SCALES);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--fft") == 0 && i + 1 < argc && fft_backend_find(argv[i + 1], FFT_FLOAT)) {
+			opt.cfg.fft = argv[++i];
+		}
+		else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc &&
+				fft_precision_parse(argv[i + 1], &opt.cfg.precision) == 0) {
+			i++;
+		}
+		else if (strcmp(argv[i], "--fft-size") == 0 && i + 1 < argc) {
+			opt.cfg.nfft = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--batch") == 0) {
+			batch_mode = 1;
+		}
+		else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			jobs = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--jsonl") == 0) {
+			batch.jsonl = 1;
+		}
+		else if (strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc) {
+			batch.out_dir = argv[++i];
+		}
+		else if (argv[i][0] != '-' && batch_mode) {
+			if (add_input(&batch, argv[i])) {
+				ret = 1;
+			}
+		}
+		else if (argv[i][0] != '-' && !path) {
+			path = argv[i];
+		}
+		else {
+			fprintf(stderr, "usage: %s [--serve] [--power] [--format json|bin|bin16] [--hop samples] [--threads n]\n"
+					"           [--bands n] [--band-scale mel|log] [--fmin hz] [--fmax hz] [--trim]\n"
+					"           [--flags-only] [--stats] [--fft %s] [--fft-size n] [--precision float|double|q15]\n"
+					"           [--config file] [--sample-rate hz] [--frame-size samples]\n"
+					"           [--window hann|hamming|blackman|rect] [--humidity-low n] [--humidity-high n]\n"
+					"           [--temp-low n] [--temp-high n] [--spectrogram frames] [--spectrogram-out file]\n"
+					"           [--partial frames] [recording]\n"
+					"       %s --batch [options] [--jobs n] [--jsonl | --out-dir dir] recording|dir...\n"
+					"       %s --monitor [options] [--monitor-scales s,s,...] [stream]\n",
+					argv[0], fft_backend_names(), argv[0], argv[0]);
+			return 2;
+		}
+	}
+	if (opt.threads <= 0) {
+		fprintf(stderr, "hive_process: threads must be at least 1\n");
+		return 2;
+	}
+	if (config_check(&opt.cfg)) {
+		return 2;
+	}
+	//--band-scale or --fmin on their own ask for the default number of bands
+	if (opt.nbands < 0) {
+		opt.nbands = band_opts ? BANDS_DEFAULT : 0;
+	}
+	if (opt.fmin < 0) {
+		opt.fmin = opt.band_scale == BANDS_LOG ? BANDS_LOG_FMIN : 0;
+	}
+	if (batch_mode && batch.jsonl && opt.format != FORMAT_JSON) {
+		fprintf(stderr, "hive_process: --jsonl only works with --format json\n");
+		return 2;
+	}
+	if (opt.spectrogram && (serve_mode || opt.flags_only)) {
+		fprintf(stderr, "hive_process: --spectrogram doesn't work with --serve or --flags-only\n");
+		return 2;
+	}
+	if (monitor_mode && (serve_mode || batch_mode || opt.spectrogram || opt.stats ||
+			opt.format != FORMAT_JSON)) {
+		fprintf(stderr, "hive_process: --monitor writes JSON lines on its own, without --serve, --batch,"
+				" --spectrogram, --stats or --format\n");
+		return 2;
+	}
+	if (opt.spectrogram && !batch_mode && !path && !spectrogram_path) {
+		fprintf(stderr, "hive_process: --spectrogram on stdin needs --spectrogram-out\n");
+		return 2;
+	}
+	//checks the options before any work is started, the batch workers make their own plans
+	int err = fft_plan_init(&plan, &opt);
+	if (err == -E2BIG) {
+		fprintf(stderr, "hive_process: --flags-only can run at most %d filters, use a smaller peak_search_hz\n",
+				GOERTZEL_MAX_BINS);
+		return 2;
+	}
+	if (err == -EINVAL) {
+		fprintf(stderr, "hive_process: bands need 0 <= fmin < fmax (fmin > 0 for log bands)\n");
+		return 2;
+	}
+	if (err) {
+		fprintf(stderr, "hive_process: out of memory\n");
+		return 1;
+	}
+	if (batch_mode) {
+		fft_plan_free(&plan);
+		batch.opt = opt;
+		ret |= run_batch(&batch, jobs);
+		for (size_t i = 0; i < batch.nfiles; i++) {
+			free(batch.files[i]);
+		}
+		free(batch.files);
+		return ret;
+	}
+	struct hive_stats stats;
+	if (opt.stats) {
+		plan.stats = &stats;
+		stats_begin(&stats);
+	}
+	if (serve_mode) {
+		ret = serve(&plan);
+	}
+	else if (monitor_mode) {
+		FILE *fp = path ? fopen(path, "rb") : stdin;
+		if (!fp) {
+			perror(path);
+			fft_plan_free(&plan);
+			return 1;
+		}
+		err = monitor(fp, &plan, scales, nscales);
+		if (err) {
+			fprintf(stderr, "hive_process: monitor: %s\n", strerror(-err));
+			ret = 1;
+		}
+		if (path) {
+			fclose(fp);
+		}
+	}
+	else {
+		int fd = path ? open(path, O_RDONLY) : STDIN_FILENO;
+		if (fd < 0) {
+			perror(path);
+			fft_plan_free(&plan);
+			return 1;
+		}
+		char spec[4096];
+		if (opt.spectrogram && !spectrogram_path) {
+			output_path(NULL, path, "spec", spec, sizeof(spec));
+			spectrogram_path = spec;
+		}
+		if (opt.spectrogram && !(plan.spectrogram_out = fopen(spectrogram_path, "wb"))) {
+			perror(spectrogram_path);
+			fft_plan_free(&plan);
+			return 1;
+		}
+		struct report_buf report;
+		report_buf_init(&report);
+		err = process_fd(fd, &plan, partial, &report);
+		if (plan.spectrogram_out && fclose(plan.spectrogram_out) && !err) {
+			err = -EIO;
+		}
+		if (err == 0) {
+			fwrite(report.data, 1, report.len, stdout);
+			if (plan.stats) {
+				stats_end(plan.stats);
+				emit_stats(&plan, path ? path : "stdin", &report);
+			}
+		}
+		else {
+			ret = 1;
+		}
+		report_buf_free(&report);
+		if (path) {
+			close(fd);
+		}
+	}
+	fft_plan_free(&plan);
+	return ret;
  }
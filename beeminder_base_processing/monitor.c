@@ -0,0 +1,77 @@
+//running averages for --monitor.  see monitor.h.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "monitor.h"
+
+int monitor_init(struct monitor *m, const float *tau, int nscales, float frame_seconds, int nbins, void *mem) {
+	if (nscales <= 0 || nscales > MONITOR_MAX_SCALES || nbins <= 0 || !(frame_seconds > 0)) {
+		return -EINVAL;
+	}
+	for (int s = 0; s < nscales; s++) {
+		if (!(tau[s] > 0)) {
+			return -EINVAL;
+		}
+		m->tau[s] = tau[s];
+		//a decay of exp(-1) per time constant whatever the hop
+		m->alpha[s] = 1 - expf(-frame_seconds / tau[s]);
+		m->warmup[s] = (size_t)ceilf(tau[s] / frame_seconds);
+	}
+	m->own_mem = !mem;
+	m->ema = mem ? mem : malloc(monitor_mem_size(nscales, nbins));
+	if (!m->ema) {
+		return -ENOMEM;
+	}
+	m->nbins = nbins;
+	m->nscales = nscales;
+	m->frames = 0;
+	return 0;
+}
+
+void monitor_free(struct monitor *m) {
+	if (m->own_mem) {
+		free(m->ema);
+	}
+	m->ema = NULL;
+}
+
+void monitor_update(struct monitor *m, const float *spectrum) {
+	int n = m->nbins;
+
+	if (m->frames++ == 0) {
+		//start from the first frame rather than decaying up from silence
+		for (int s = 0; s < m->nscales; s++) {
+			memcpy(monitor_spectrum(m, s), spectrum, n * sizeof(float));
+		}
+		return;
+	}
+	for (int s = 0; s < m->nscales; s++) {
+		float *restrict ema = monitor_spectrum(m, s);
+		const float *restrict x = spectrum;
+		float a = m->alpha[s];
+		for (int k = 0; k < n; k++) {
+			ema[k] += a * (x[k] - ema[k]);
+		}
+	}
+}
+
+int monitor_parse_scales(const char *s, float *tau, int max) {
+	int n = 0;
+	char *end;
+
+	while (*s) {
+		if (n == max) {
+			return -EINVAL;
+		}
+		tau[n] = strtof(s, &end);
+		if (end == s || !(tau[n] > 0) || (*end && *end != ',')) {
+			return -EINVAL;
+		}
+		n++;
+		s = *end ? end + 1 : end;
+	}
+	return n ? n : -EINVAL;
+}
@@ -0,0 +1,50 @@
+//exponentially decayed spectra for --monitor.
+//every frame's spectrum is folded into one running average per time scale, so a
+//stream of any length is summarised in nscales spectra and nothing else.
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <stddef.h>
+
+#define MONITOR_MAX_SCALES 8
+
+struct monitor {
+	int nbins;
+	int nscales;
+	//time constant of each scale in seconds, and the weight a new frame gets
+	float tau[MONITOR_MAX_SCALES];
+	float alpha[MONITOR_MAX_SCALES];
+	//frames until a scale has seen a whole time constant
+	size_t warmup[MONITOR_MAX_SCALES];
+	//nscales spectra of nbins values
+	float *ema;
+	size_t frames;
+	int own_mem;
+};
+
+//bytes of memory the averages of nscales nbins bin spectra need
+#define monitor_mem_size(nscales, nbins) ((size_t)(nscales) * (size_t)(nbins) * sizeof(float))
+
+//scales of tau[0..nscales) seconds for frames frame_seconds apart.
+//mem is monitor_mem_size bytes the caller keeps alive until monitor_free, or NULL
+//to have it malloc'd.  returns 0, -EINVAL or -ENOMEM.
+int monitor_init(struct monitor *m, const float *tau, int nscales, float frame_seconds, int nbins, void *mem);
+void monitor_free(struct monitor *m);
+//folds one frame's spectrum into every scale
+void monitor_update(struct monitor *m, const float *spectrum);
+
+//the averaged spectrum of scale s
+static inline float *monitor_spectrum(const struct monitor *m, int s) {
+	return m->ema + (size_t)s * m->nbins;
+}
+
+//whether scale s has averaged over at least its time constant
+static inline int monitor_ready(const struct monitor *m, int s) {
+	return m->frames >= m->warmup[s];
+}
+
+//"5,60,600" -> tau, at most max scales.  returns the number of scales or -EINVAL.
+int monitor_parse_scales(const char *s, float *tau, int max);
+
+#endif
@@ -0,0 +1,872 @@
+//hive_process's pipeline, see pipeline.h.
+
+ #include <stdio.h>
+ #include <stdlib.h>
+ #include <errno.h>
+ #include <stdint.h>
+ #include <string.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #include <math.h>
+ #include <pthread.h>
+
+ #include "kiss_fft.h"
+ #include "fft.h"
+ #include "pipeline.h"
+ #include "stft.h"
+ #include "report_bin.h"
+ #include "spectrogram.h"
+ #include "monitor.h"
+ #include "hive_dsp.h"
+ #include "hive_adpcm.h"
+
+ #include "analysis.h"
+
+//samples read from a pipe per push into the STFT
+#define STREAM_CHUNK 4096
+//scratch arena block, enough for the STFT ring and a few threads' partial spectra
+#define SCRATCH_BLOCK (64 * 1024)
+
+void fft_plan_free(struct fft_plan *plan) {
+	window_free(&plan->window);
+	bands_free(&plan->bands);
+	bands_free(&plan->sg_bands);
+	if (plan->scratch) {
+		arena_free(plan->scratch);
+		free(plan->scratch);
+		plan->scratch = NULL;
+	}
+	for (int i = 0; i < plan->threads; i++) {
+		fft_free(&plan->fft[i]);
+	}
+	free(plan->fft);
+	plan->fft = NULL;
+}
+
+//a filter is a multiply-add in double per sample and bin, a real FFT about
+//2.5 nfft log2(nfft) float operations.  with the range bins around the bee
+//frequencies the filters only win for small frames or a narrow peak search.
+static int goertzel_cheaper(const struct fft_plan *plan) {
+	return 2.0 * plan->nrange * plan->frame_len < 2.5 * plan->nfft * log2(plan->nfft);
+}
+
+int fft_plan_init(struct fft_plan *plan, const struct plan_options *opt) {
+	const struct hive_config *cfg = &opt->cfg;
+	const struct fft_backend *backend = config_fft(cfg);
+	int threads = opt->threads;
+
+	if (!backend) {
+		return -EINVAL;
+	}
+	plan->frame_len = cfg->frame_len;
+	plan->nfft = cfg->nfft;
+	if (plan->nfft == 0) {
+		plan->nfft = backend->pow2_only ? fft_next_pow2(plan->frame_len) : plan->frame_len;
+	}
+	plan->fft_bins = plan->nfft / 2 + 1;
+	plan->analysis = cfg->analysis;
+	plan->bin_hz = (float)plan->analysis.sample_rate/plan->nfft;
+	plan->mode = opt->mode;
+	plan->hop = cfg->hop ? cfg->hop : plan->frame_len;
+	plan->format = opt->format;
+	plan->nbins = opt->trim ? plan->fft_bins : plan->nfft;
+	if (opt->fmax > 0 && opt->fmax < (plan->fft_bins - 1) * plan->bin_hz) {
+		plan->nbins = (int)(opt->fmax / plan->bin_hz) + 1;
+	}
+	plan->threads = 0;
+	plan->fft = NULL;
+	plan->window.coef = NULL;
+	plan->bands = (struct bands){0};
+	plan->sg_bands = (struct bands){0};
+	plan->flags_only = opt->flags_only;
+	plan->stats = NULL;
+	plan->spectrogram = opt->spectrogram;
+	plan->spectrogram_out = NULL;
+	plan->scratch = NULL;
+	if (plan->nfft < plan->frame_len || plan->nfft > FFT_MAX_SIZE) {
+		return -EINVAL;
+	}
+	plan->nrange = 0;
+	if (plan->flags_only || plan->mode == SPECTRUM_POWER) {
+		plan->nrange = audio_range_bins(&plan->analysis, plan->nfft, plan->range_bin, GOERTZEL_MAX_BINS);
+		if (plan->nrange < 0) {
+			return -E2BIG;
+		}
+	}
+	plan->acc_bins = plan->fft_bins + (plan->mode == SPECTRUM_POWER ? plan->nrange : 0);
+	plan->goertzel.nbins = 0;
+	if (plan->flags_only && goertzel_cheaper(plan) &&
+			goertzel_init(&plan->goertzel, plan->range_bin, plan->nrange, plan->nfft, plan->frame_len)) {
+		return -EINVAL;
+	}
+	if (opt->nbands > 0) {
+		int err = bands_init(&plan->bands, opt->band_scale, opt->nbands, opt->fmin, opt->fmax,
+				plan->bin_hz, plan->fft_bins);
+		if (err) {
+			return err;
+		}
+	}
+	if (plan->spectrogram > 0) {
+		int err = bands_init(&plan->sg_bands, opt->band_scale, opt->nbands > 0 ? opt->nbands : BANDS_DEFAULT,
+				opt->fmin, opt->fmax, plan->bin_hz, plan->fft_bins);
+		if (err) {
+			bands_free(&plan->bands);
+			return err;
+		}
+	}
+	plan->fft = calloc(threads, sizeof(struct fft));
+	if (!plan->fft) {
+		fft_plan_free(plan);
+		return -ENOMEM;
+	}
+	for (; plan->threads < threads; plan->threads++) {
+		int err = fft_init(&plan->fft[plan->threads], backend, plan->nfft);
+		if (err) {
+			fft_plan_free(plan);
+			return err;
+		}
+	}
+	plan->scratch = malloc(sizeof(*plan->scratch));
+	if (!plan->scratch) {
+		fft_plan_free(plan);
+		return -ENOMEM;
+	}
+	arena_init(plan->scratch, SCRATCH_BLOCK);
+	if (window_init(&plan->window, cfg->window, plan->frame_len)) {
+		fft_plan_free(plan);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+//read wave header
+ int read_hivedata(FILE *fp, struct raw_hivedata *dest) {
+   if (!dest || !fp) {
+	printf("could not find file \n");
+     return -ENOENT;
+   }
+
+   //the header is the first thing in the stream, read from where we are so pipes work too
+   if (fread(dest, sizeof(struct raw_hivedata), 1, fp) != 1) {
+     memset(dest, 0, sizeof(struct raw_hivedata));
+     return -EIO;
+   }
+   //printf("done read hive data \n");
+   return 0;
+ }
+ 
+//what the STFT hands back to FFT_frame
+struct fft_accum {
+	const struct fft_plan *plan;
+	const struct fft *fft;
+	float *master_fft_array;
+	//frames [first, last) of samples, for the threaded path
+	const int16_t *samples;
+	size_t first, last;
+	//frame timings, NULL without --stats.  worker threads point it at their own
+	//thread_stats so nothing is shared while the frames run.
+	struct hive_stats *stats;
+	struct hive_stats thread_stats;
+	//rows of the recording's spectrogram, NULL when there isn't one
+	struct spectrogram *sg;
+};
+
+//--power: magnitudes of the range bins, after the power spectrum in acc
+static void range_accumulate(const struct fft_plan *plan, const kiss_fft_cpx *bins, float *acc) {
+	float *mag = acc + plan->fft_bins;
+	for (int k = 0; k < plan->nrange; k++) {
+		const kiss_fft_cpx *c = &bins[plan->range_bin[k]];
+		mag[k] += sqrtf(c->r * c->r + c->i * c->i);
+	}
+}
+
+//windows one frame, runs the fft on it and adds the magnitudes to the master array
+static void FFT_frame(void *ctx, const int16_t *frame) {
+	struct fft_accum *acc = ctx;
+	const struct fft_plan *plan = acc->plan;
+	float buf[plan->nfft];
+	kiss_fft_cpx fft_output[plan->fft_bins];
+	uint64_t t = STATS_START(acc->stats);
+
+	window_apply_s16(&plan->window, frame, buf);
+	//zero padding for FFTs bigger than a frame
+	memset(buf + plan->frame_len, 0, (plan->nfft - plan->frame_len) * sizeof(float));
+	if (acc->stats) {
+		uint64_t w = stats_now();
+		fft_forward(acc->fft, buf, fft_output);
+		uint64_t f = stats_now();
+		spectrum_accumulate(fft_output, acc->master_fft_array, plan->fft_bins, plan->mode);
+		if (plan->nrange && plan->mode == SPECTRUM_POWER) {
+			range_accumulate(plan, fft_output, acc->master_fft_array);
+		}
+		if (acc->sg) {
+			spectrogram_frame(acc->sg, fft_output);
+		}
+		acc->stats->ns[STAT_WINDOW] += w - t;
+		acc->stats->ns[STAT_FFT] += f - w;
+		STATS_ADD(acc->stats, STAT_MAGNITUDE, f);
+		acc->stats->frames++;
+		return;
+	}
+	fft_forward(acc->fft, buf, fft_output);
+	spectrum_accumulate(fft_output, acc->master_fft_array, plan->fft_bins, plan->mode);
+	if (plan->nrange && plan->mode == SPECTRUM_POWER) {
+		range_accumulate(plan, fft_output, acc->master_fft_array);
+	}
+	if (acc->sg) {
+		spectrogram_frame(acc->sg, fft_output);
+	}
+}
+
+//--flags-only when the filters are cheaper: the same window, then just the bins
+//audio_compare reads.  the rest of the master array stays 0.  the filters run over
+//plan->range_bin, so with --power filter k's magnitude is range value k.
+static void goertzel_frame(void *ctx, const int16_t *frame) {
+	struct fft_accum *acc = ctx;
+	const struct goertzel *g = &acc->plan->goertzel;
+	float buf[acc->plan->frame_len];
+	double power[GOERTZEL_MAX_BINS];
+	uint64_t t = STATS_START(acc->stats);
+
+	window_apply_s16(&acc->plan->window, frame, buf);
+	STATS_ADD(acc->stats, STAT_WINDOW, t);
+	t = STATS_START(acc->stats);
+	goertzel_run(g, buf, power);
+	STATS_ADD(acc->stats, STAT_FFT, t);
+	t = STATS_START(acc->stats);
+	for (int k = 0; k < g->nbins; k++) {
+		float p = power[k];
+		if (acc->plan->mode == SPECTRUM_POWER) {
+			acc->master_fft_array[g->bin[k]] += p;
+			acc->master_fft_array[acc->plan->fft_bins + k] += sqrtf(p);
+		}
+		else {
+			acc->master_fft_array[g->bin[k]] += sqrtf(p);
+		}
+	}
+	STATS_ADD(acc->stats, STAT_MAGNITUDE, t);
+	if (acc->stats) {
+		acc->stats->frames++;
+	}
+}
+
+static stft_frame_fn frame_fn(const struct fft_plan *plan) {
+	return plan->goertzel.nbins ? goertzel_frame : FFT_frame;
+}
+
+static void *FFT_frames(void *ctx) {
+	struct fft_accum *acc = ctx;
+	stft_frame_fn fn = frame_fn(acc->plan);
+	for (size_t f = acc->first; f < acc->last; f++) {
+		fn(acc, acc->samples + f * acc->plan->hop);
+	}
+	return NULL;
+}
+
+//--spectrogram: starts the current recording's spectrogram with memory from the
+//scratch arena.  returns 0, -ENOMEM or -EIO.
+static int spectrogram_start(const struct fft_plan *plan, struct spectrogram *sg) {
+	const struct bands *b = &plan->sg_bands;
+	void *mem = arena_alloc(plan->scratch, spectrogram_mem_size(plan->fft_bins, b->nbands));
+	if (!mem) {
+		return -ENOMEM;
+	}
+	//rows are in dB, half precision is closer than anything a microphone resolves
+	return spectrogram_init(sg, b, plan->fft_bins, plan->spectrogram,
+			(float)plan->hop * plan->spectrogram / plan->analysis.sample_rate, REPORT_F16,
+			plan->spectrogram_out, mem);
+}
+
+void fft_handle_scratch(const struct fft_plan *plan, int threads, size_t size[FFT_HANDLE_ALLOCS]) {
+	size[0] = threads * sizeof(struct fft_accum);
+	size[1] = (size_t)threads * plan->acc_bins * sizeof(float);
+	size[2] = threads * sizeof(pthread_t);
+	size[3] = threads * sizeof(char);
+}
+
+//handles the FFT process for the entire recording.
+//samples can point straight into a mapped file, every frame is read in place.
+//the plan is owned by the caller so a long running process only builds it once.
+//
+//with more than one thread the frames are cut into contiguous runs, one per thread,
+//each summed into its own array and then added pairwise in a fixed tree order.
+//the result only depends on the thread count, never on scheduling.
+//a spectrogram is written in the same pass; its rows have to come out in order, so
+//a recording with one runs on a single thread.
+int FFT_handle(const int16_t *samples, size_t nsamples, const struct fft_plan *plan, float* master_fft_array) {
+	size_t frame_len = plan->frame_len;
+	size_t nframes = nsamples >= frame_len ? (nsamples - frame_len) / plan->hop + 1 : 0;
+	int threads = plan->threads;
+	if ((size_t)threads > nframes) {
+		threads = nframes ? nframes : 1;
+	}
+
+	memset(master_fft_array, 0, plan->acc_bins*sizeof(float));
+	if (threads == 1 || plan->spectrogram_out) {
+		struct fft_accum acc = {.plan = plan, .fft = &plan->fft[0], .master_fft_array = master_fft_array,
+			.samples = samples, .first = 0, .last = nframes, .stats = plan->stats};
+		struct arena_mark mark = arena_mark(plan->scratch);
+		struct spectrogram sg;
+		int err = 0;
+		if (plan->spectrogram_out && !(err = spectrogram_start(plan, &sg))) {
+			acc.sg = &sg;
+		}
+		if (!err) {
+			FFT_frames(&acc);
+		}
+		if (acc.sg) {
+			err = spectrogram_finish(&sg);
+			spectrogram_free(&sg);
+		}
+		arena_release(plan->scratch, mark);
+		return err;
+	}
+
+	size_t size[FFT_HANDLE_ALLOCS];
+	fft_handle_scratch(plan, threads, size);
+	struct arena_mark mark = arena_mark(plan->scratch);
+	struct fft_accum *acc = arena_calloc(plan->scratch, 1, size[0]);
+	float *partial = arena_calloc(plan->scratch, 1, size[1]);
+	pthread_t *tid = arena_calloc(plan->scratch, 1, size[2]);
+	//pthread_t has no value that means "no thread", so which ones run is kept apart
+	char *started = arena_calloc(plan->scratch, 1, size[3]);
+	if (!acc || !partial || !tid || !started) {
+		arena_release(plan->scratch, mark);
+		return -ENOMEM;
+	}
+	for (int t = 0; t < threads; t++) {
+		acc[t] = (struct fft_accum){.plan = plan, .fft = &plan->fft[t],
+			.master_fft_array = partial + (size_t)t * plan->acc_bins, .samples = samples,
+			.first = nframes * t / threads, .last = nframes * (t + 1) / threads};
+		acc[t].stats = plan->stats ? &acc[t].thread_stats : NULL;
+		//thread 0 is this one; if a thread can't be started its frames are done here too
+		started[t] = t != 0 && !pthread_create(&tid[t], NULL, FFT_frames, &acc[t]);
+	}
+	for (int t = 0; t < threads; t++) {
+		if (started[t]) {
+			pthread_join(tid[t], NULL);
+		}
+		else {
+			FFT_frames(&acc[t]);
+		}
+	}
+	//pairwise tree: (0+1) (2+3) ..., then (0+2) ..., so the float sums are always in the same order
+	for (int step = 1; step < threads; step *= 2) {
+		for (int t = 0; t + step < threads; t += 2 * step) {
+			float *dst = partial + (size_t)t * plan->acc_bins;
+			const float *src = partial + (size_t)(t + step) * plan->acc_bins;
+			for (int i = 0; i < plan->acc_bins; i++) {
+				dst[i] += src[i];
+			}
+		}
+	}
+	memcpy(master_fft_array, partial, plan->acc_bins*sizeof(float));
+	if (plan->stats) {
+		for (int t = 0; t < threads; t++) {
+			stats_merge(plan->stats, &acc[t].thread_stats);
+		}
+	}
+	arena_release(plan->scratch, mark);
+	//printf("finished fft \n");
+	return 0;
+}
+
+ //sets the bee flags from a spectrum of plan->mode values.  features gets the
+ //spectrum's features, only the ones around the bee frequencies unless full.
+ //the thresholds are for summed magnitudes.  with --power the ranges the flags come
+ //from use the magnitudes summed alongside the power, so both modes flag the same.
+ //the whole spectrum features (centroid, flatness, noise floor and so the SNRs) are
+ //worked out from the square root of the summed power, which is below the summed
+ //magnitude wherever a bin's level changes between frames.
+ void compare_spectrum(const struct fft_plan *plan, const float *fft_array, int full, float *features,
+		 struct hivedata *hive) {
+	float amp_array[plan->fft_bins];
+	const float *amp = fft_array;
+	if (plan->mode == SPECTRUM_POWER) {
+		for (int i = 0; i < plan->fft_bins; i++) {
+			amp_array[i] = sqrtf(fft_array[i]);
+		}
+		for (int k = 0; k < plan->nrange; k++) {
+			amp_array[plan->range_bin[k]] = fft_array[plan->fft_bins + k];
+		}
+		amp = amp_array;
+	}
+	features_compute(&plan->analysis, amp, plan->nfft, full, features);
+	audio_compare(&plan->analysis, features, hive);
+ }
+
+ //threshold checks and report for a recording whose spectrum is already in fft_array
+ static int finish_recording(struct raw_hivedata *raw_hive, float *fft_array, const struct fft_plan *plan,
+		 struct report_buf *out) {
+	struct hivedata hive;
+	float features[FEATURE_COUNT];
+	uint64_t t = STATS_START(plan->stats);
+	struct arena_mark mark = arena_mark(plan->scratch);
+	int err;
+
+	th_handle(&plan->analysis, raw_hive, &hive);
+	//with flags_only there is no spectrum to work the whole spectrum features out from
+	compare_spectrum(plan, fft_array, !plan->flags_only, features, &hive);
+
+	struct report_content c = {
+		.power = plan->mode == SPECTRUM_POWER,
+		.bin_hz = plan->bin_hz,
+	};
+	int nbands = plan->bands.nbands;
+	//a few dozen bands, fine on the stack
+	float mean[nbands ? nbands : 1], peak[nbands ? nbands : 1], energy[nbands ? nbands : 1];
+	if (plan->flags_only) {
+		//nothing but the hive data and flags
+	}
+	else if (nbands) {
+		bands_summarise(&plan->bands, fft_array, c.power, mean, peak, energy);
+		c.nbands = nbands;
+		c.band_scale = plan->bands.scale;
+		c.band_edge = plan->bands.edge;
+		c.band_mean = mean;
+		c.band_peak = peak;
+		c.band_energy = energy;
+	}
+	else if (plan->nbins > plan->fft_bins) {
+		float *padded = arena_calloc(plan->scratch, plan->nbins, sizeof(float));
+		if (!padded) {
+			arena_release(plan->scratch, mark);
+			return -ENOMEM;
+		}
+		memcpy(padded, fft_array, plan->fft_bins * sizeof(float));
+		c.spectrum = padded;
+		c.nspectrum = plan->nbins;
+	}
+	else {
+		c.spectrum = fft_array;
+		c.nspectrum = plan->nbins;
+	}
+	if (!plan->flags_only) {
+		c.features = features;
+	}
+	STATS_ADD(plan->stats, STAT_COMPARE, t);
+	t = STATS_START(plan->stats);
+	if (plan->format == FORMAT_JSON) {
+		err = report_json(out, &hive, &c);
+	}
+	else {
+		err = report_bin(out, &hive, &c, plan->format == FORMAT_BIN16 ? REPORT_F16 : REPORT_F32);
+	}
+	STATS_ADD(plan->stats, STAT_SERIALIZE, t);
+	if (plan->stats) {
+		plan->stats->bytes_out = out->len;
+	}
+	arena_release(plan->scratch, mark);
+	return err;
+ }
+
+ //report for a recording a node has already reduced to a spectrum packet (hive_dsp.h).
+ //the flags come from the bins it sent around the bee frequencies and the band
+ //summary is the node's, there is no spectrum or whole spectrum features.
+ static int finish_packet(struct raw_hivedata *raw_hive, const struct hive_spectrum *pkt,
+		 const struct fft_plan *plan, struct report_buf *out) {
+	struct analysis_params p = plan->analysis;
+	struct hivedata hive;
+	float features[FEATURE_COUNT];
+	int nbins = pkt->nfft / 2 + 1;
+	int err = -ENOMEM;
+
+	//the bins are the node's, at its sample rate
+	p.sample_rate = pkt->sample_rate;
+	struct arena_mark mark = arena_mark(plan->scratch);
+	float *amp = arena_calloc(plan->scratch, nbins, sizeof(float));
+	uint8_t *sent = arena_calloc(plan->scratch, nbins, 1);
+	int *bins = arena_alloc(plan->scratch, nbins * sizeof(int));
+	if (!amp || !sent || !bins) {
+		arena_release(plan->scratch, mark);
+		return err;
+	}
+	for (int r = 0; r < pkt->nranges; r++) {
+		hive_spectrum_range(pkt, r, amp + pkt->range_first[r]);
+		memset(sent + pkt->range_first[r], 1, pkt->range_count[r]);
+	}
+	//a node set up for other frequencies than the config still gets its report
+	int n = audio_range_bins(&p, pkt->nfft, bins, nbins);
+	for (int i = 0; i < n; i++) {
+		if (!sent[bins[i]]) {
+			fprintf(stderr, "hive_process: spectrum packet has no bin %d, the flags are unreliable\n", bins[i]);
+			break;
+		}
+	}
+	th_handle(&p, raw_hive, &hive);
+	features_compute(&p, amp, pkt->nfft, 0, features);
+	audio_compare(&p, features, &hive);
+
+	int nbands = pkt->nbands;
+	float mean[nbands], peak[nbands], energy[nbands];
+	hive_spectrum_bands(pkt, mean, peak, energy);
+	struct report_content c = {
+		.nbands = nbands,
+		.band_scale = BANDS_MEL,
+		.band_edge = pkt->edge,
+		.band_mean = mean,
+		.band_peak = peak,
+		.band_energy = energy,
+	};
+	if (plan->format == FORMAT_JSON) {
+		err = report_json(out, &hive, &c);
+	}
+	else {
+		err = report_bin(out, &hive, &c, plan->format == FORMAT_BIN16 ? REPORT_F16 : REPORT_F32);
+	}
+	if (plan->stats) {
+		plan->stats->bytes_out = out->len;
+	}
+	arena_release(plan->scratch, mark);
+	return err;
+ }
+
+ //decodes the ADPCM blocks of an upload into memory from the arena.  an upload cut
+ //short keeps the blocks that made it.
+ static int adpcm_samples(struct hive_adpcm_header *h, const uint8_t *blocks, size_t len, struct arena *a,
+		 int16_t **out) {
+	size_t whole = len / h->block_len * hive_adpcm_block_samples(h->block_len);
+	if (whole < h->nsamples) {
+		h->nsamples = whole;
+	}
+	if (!(*out = arena_alloc(a, ((size_t)h->nsamples + 1) * sizeof(int16_t)))) {
+		return -ENOMEM;
+	}
+	return hive_adpcm_decode(h, blocks, len, *out);
+ }
+
+ //runs the whole pipeline on one recording (hive header followed by audio) held in memory.
+ //the audio can be IMA-ADPCM (hive_adpcm.h), and a node that worked the spectrum out
+ //itself sends a spectrum packet after the header instead.
+ int process_recording(const uint8_t *data, size_t len, const struct fft_plan *plan, struct report_buf *out) {
+	struct raw_hivedata raw_hive = {0};
+	float fft_array[plan->acc_bins];
+	const int16_t *samples = NULL;
+	size_t nsamples = 0;
+	int err;
+	struct hive_spectrum pkt;
+	struct hive_adpcm_header adpcm;
+	struct arena_mark mark = arena_mark(plan->scratch);
+
+	if (len >= sizeof(raw_hive)) {
+		memcpy(&raw_hive, data, sizeof(raw_hive));
+		data += sizeof(raw_hive);
+		len -= sizeof(raw_hive);
+		if (hive_spectrum_read(data, len, &pkt) == 0) {
+			return finish_packet(&raw_hive, &pkt, plan, out);
+		}
+		//the header is 12 bytes so the samples stay 2 byte aligned
+		samples = (const int16_t *)data;
+		nsamples = len / sizeof(int16_t);
+	}
+	if (hive_adpcm_header_read(data, len, &adpcm) == 0) {
+		//compressed audio is decoded up front, it takes a fraction of the time the FFTs do
+		int16_t *pcm;
+		uint64_t t = STATS_START(plan->stats);
+		if ((err = adpcm_samples(&adpcm, data + HIVE_ADPCM_HEADER_LEN, len - HIVE_ADPCM_HEADER_LEN,
+				plan->scratch, &pcm))) {
+			arena_release(plan->scratch, mark);
+			return err;
+		}
+		//decoding is counted as reading, as it is on the stream path
+		STATS_ADD(plan->stats, STAT_READ, t);
+		samples = pcm;
+		nsamples = adpcm.nsamples;
+	}
+	err = FFT_handle(samples, nsamples, plan, fft_array);
+	if (!err) {
+		err = finish_recording(&raw_hive, fft_array, plan, out);
+	}
+	arena_release(plan->scratch, mark);
+	return err;
+ }
+
+ //where process_stream's samples come from: the pipe as it is, or ADPCM blocks
+ //decoded as they arrive.  a spectrum packet has no samples, it is read whole.
+ struct stream_source {
+	FILE *fp;
+	int adpcm;
+	struct hive_adpcm_header h;	//nsamples counts down to 0
+	uint8_t *block;
+	int spectrum;
+	struct hive_spectrum pkt;	//points into head
+	//bytes read looking for an ADPCM header or a spectrum packet that turned out
+	//to be samples.  one more than a packet can take, so a longer upload isn't one.
+	uint8_t head[HIVE_SPECTRUM_MAX_LEN + 1];
+	size_t nhead;
+	//bytes read from the pipe since the caller last looked
+	size_t bytes;
+ };
+
+ static int stream_open(struct stream_source *src, FILE *fp, struct arena *a) {
+	src->fp = fp;
+	src->adpcm = 0;
+	src->spectrum = 0;
+	src->nhead = fread(src->head, 1, HIVE_ADPCM_HEADER_LEN, fp);
+	if (src->nhead >= 4 && memcmp(src->head, HIVE_SPECTRUM_MAGIC, 4) == 0) {
+		//the packet is the rest of the upload, as process_recording takes it
+		src->nhead += fread(src->head + src->nhead, 1, sizeof(src->head) - src->nhead, fp);
+		src->spectrum = hive_spectrum_read(src->head, src->nhead, &src->pkt) == 0;
+	}
+	src->bytes = src->nhead;
+	if (!src->spectrum && hive_adpcm_header_read(src->head, src->nhead, &src->h) == 0) {
+		//a chunk has to hold at least a block
+		if (hive_adpcm_block_samples(src->h.block_len) > STREAM_CHUNK) {
+			return -EINVAL;
+		}
+		if (!(src->block = arena_alloc(a, src->h.block_len))) {
+			return -ENOMEM;
+		}
+		src->adpcm = 1;
+		src->nhead = 0;
+	}
+	return 0;
+ }
+
+ //up to max samples into chunk, 0 at the end
+ static size_t stream_read(struct stream_source *src, int16_t *chunk, size_t max) {
+	if (src->adpcm) {
+		size_t per_block = hive_adpcm_block_samples(src->h.block_len);
+		size_t n = 0;
+		while (src->h.nsamples > 0 && n + per_block <= max) {
+			//an upload cut short ends at its last whole block
+			if (fread(src->block, 1, src->h.block_len, src->fp) != (size_t)src->h.block_len) {
+				src->h.nsamples = 0;
+				break;
+			}
+			src->bytes += src->h.block_len;
+			size_t k = src->h.nsamples < per_block ? src->h.nsamples : per_block;
+			hive_adpcm_decode_block(src->block, src->h.block_len, chunk + n, k);
+			n += k;
+			src->h.nsamples -= k;
+		}
+		return n;
+	}
+	uint8_t *p = (uint8_t *)chunk;
+	size_t len = src->nhead;
+	memcpy(p, src->head, len);
+	src->nhead = 0;
+	size_t got = fread(p + len, 1, max * sizeof(int16_t) - len, src->fp);
+	src->bytes += got;
+	return (len + got) / sizeof(int16_t);
+ }
+
+ //same for a recording that can only be read front to back (a pipe).
+ //samples go through the STFT as they arrive, so this keeps up with an upload that is
+ //still coming in, ADPCM blocks are decoded as they come.  with partial > 0 a report
+ //of the spectrum so far is printed, one per line, every partial frames.
+ int process_stream(FILE *fp, const struct fft_plan *plan, int partial, struct report_buf *out) {
+	struct raw_hivedata raw_hive;
+	float fft_array[plan->acc_bins];
+	struct fft_accum acc = {.plan = plan, .fft = &plan->fft[0], .master_fft_array = fft_array,
+		.stats = plan->stats};
+	struct stft stft;
+	struct spectrogram sg;
+	struct stream_source src;
+	int16_t chunk[STREAM_CHUNK];
+	size_t nr, reported = 0;
+	int err;
+	uint64_t t = STATS_START(plan->stats);
+
+	if (read_hivedata(fp, &raw_hive) == 0 && plan->stats) {
+		plan->stats->bytes_read += sizeof(raw_hive);
+	}
+	memset(fft_array, 0, plan->acc_bins * sizeof(float));
+	struct arena_mark mark = arena_mark(plan->scratch);
+	if ((err = stream_open(&src, fp, plan->scratch))) {
+		arena_release(plan->scratch, mark);
+		return err;
+	}
+	STATS_ADD(plan->stats, STAT_READ, t);
+	if (src.spectrum) {
+		if (plan->stats) {
+			plan->stats->bytes_read += src.bytes;
+		}
+		arena_release(plan->scratch, mark);
+		return finish_packet(&raw_hive, &src.pkt, plan, out);
+	}
+	void *ring = arena_alloc(plan->scratch, stft_mem_size(plan->frame_len));
+	if (!ring || stft_init(&stft, plan->frame_len, plan->hop, frame_fn(plan), &acc, ring)) {
+		arena_release(plan->scratch, mark);
+		return -ENOMEM;
+	}
+	if (plan->spectrogram_out) {
+		if ((err = spectrogram_start(plan, &sg))) {
+			stft_free(&stft);
+			arena_release(plan->scratch, mark);
+			return err;
+		}
+		acc.sg = &sg;
+	}
+	while (t = STATS_START(plan->stats), (nr = stream_read(&src, chunk, STREAM_CHUNK)) > 0) {
+		if (plan->stats) {
+			STATS_ADD(plan->stats, STAT_READ, t);
+			plan->stats->bytes_read += src.bytes;
+		}
+		src.bytes = 0;
+		stft_push(&stft, chunk, nr);
+		if (partial > 0 && stft.frames - reported >= (size_t)partial) {
+			reported = stft.frames;
+			if (finish_recording(&raw_hive, fft_array, plan, out) == 0) {
+				fwrite(out->data, 1, out->len, stdout);
+				//binary reports carry their own length, they go back to back
+				if (plan->format == FORMAT_JSON) {
+					putchar('\n');
+				}
+				fflush(stdout);
+			}
+		}
+	}
+	stft_free(&stft);
+	if (acc.sg) {
+		err = spectrogram_finish(&sg);
+		spectrogram_free(&sg);
+		if (err) {
+			arena_release(plan->scratch, mark);
+			return err;
+		}
+	}
+	arena_release(plan->scratch, mark);
+	return finish_recording(&raw_hive, fft_array, plan, out);
+ }
+
+ //maps regular files so the frames are read straight out of the page cache,
+ //anything else (pipes, sockets, terminals) is streamed.
+ int process_fd(int fd, const struct fft_plan *plan, int partial, struct report_buf *out) {
+	struct stat st;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		uint64_t t = STATS_START(plan->stats);
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			//the pages come in lazily, so page faults are counted in the window stage
+			STATS_ADD(plan->stats, STAT_READ, t);
+			if (plan->stats) {
+				plan->stats->bytes_read = st.st_size;
+			}
+			int err = process_recording(map, st.st_size, plan, out);
+			munmap(map, st.st_size);
+			return err;
+		}
+	}
+	FILE *fp = fdopen(dup(fd), "rb");
+	if (!fp) {
+		return -errno;
+	}
+	int err = process_stream(fp, plan, partial, out);
+	fclose(fp);
+	return err;
+ }
+
+ //--monitor state, handed to monitor_frame by the STFT
+ struct monitor_run {
+	struct fft_accum acc;	//the frame's spectrum goes to acc.master_fft_array
+	struct monitor mon;
+	struct hivedata hive;	//the header's readings and flags, the bee flags are filled in per scale
+	//bee flags last written for each scale
+	uint8_t flags[MONITOR_MAX_SCALES][sizeof(((struct hivedata *)0)->bee_flags)];
+	int written[MONITOR_MAX_SCALES];
+	//flags that differ from the written ones and for how many frames they have held
+	uint8_t pending[MONITOR_MAX_SCALES][sizeof(((struct hivedata *)0)->bee_flags)];
+	size_t held[MONITOR_MAX_SCALES];
+	struct report_buf report, line;
+	int err;
+ };
+
+ //one frame of a monitored stream: fold it into the averages and write a line for
+ //every scale whose flags have changed.  a change has to hold for a quarter of the
+ //scale's time constant, so a value sitting on a threshold doesn't flap.
+ static void monitor_frame(void *ctx, const int16_t *frame) {
+	struct monitor_run *run = ctx;
+	const struct fft_plan *plan = run->acc.plan;
+	struct monitor *mon = &run->mon;
+
+	memset(run->acc.master_fft_array, 0, plan->acc_bins * sizeof(float));
+	frame_fn(plan)(&run->acc, frame);
+	monitor_update(mon, run->acc.master_fft_array);
+	for (int s = 0; s < mon->nscales && !run->err; s++) {
+		struct hivedata hive = run->hive;
+		float features[FEATURE_COUNT];
+		if (!monitor_ready(mon, s)) {
+			continue;
+		}
+		compare_spectrum(plan, monitor_spectrum(mon, s), 0, features, &hive);
+		if (run->written[s]) {
+			if (memcmp(run->flags[s], hive.bee_flags, sizeof(hive.bee_flags)) == 0) {
+				run->held[s] = 0;
+				continue;
+			}
+			if (run->held[s] == 0 || memcmp(run->pending[s], hive.bee_flags, sizeof(hive.bee_flags))) {
+				memcpy(run->pending[s], hive.bee_flags, sizeof(hive.bee_flags));
+				run->held[s] = 0;
+			}
+			if (++run->held[s] < (mon->warmup[s] + 3) / 4) {
+				continue;
+			}
+		}
+		memcpy(run->flags[s], hive.bee_flags, sizeof(hive.bee_flags));
+		run->written[s] = 1;
+		run->held[s] = 0;
+		//seconds from the start of the stream to the end of this frame
+		float t = ((float)(mon->frames - 1) * plan->hop + plan->frame_len) / plan->analysis.sample_rate;
+		struct report_content c = {.power = plan->mode == SPECTRUM_POWER};
+		struct report_buf *line = &run->line;
+		int err = report_json(&run->report, &hive, &c);
+		report_buf_reset(line);
+		err |= report_raw(line, "{\"time\":");
+		err |= report_float(line, t);
+		err |= report_raw(line, ",\"scale\":");
+		err |= report_float(line, mon->tau[s]);
+		err |= report_raw(line, ",\"report\":");
+		err |= report_raw(line, run->report.data);
+		err |= report_raw(line, "}\n");
+		if (err) {
+			run->err = -ENOMEM;
+		}
+		//flushed straight away, whoever is watching wants to know now
+		else if (fwrite(line->data, 1, line->len, stdout) != line->len || fflush(stdout)) {
+			run->err = -EIO;
+		}
+	}
+ }
+
+ //long running mode for a stream with no end: a hive header then samples for as
+ //long as the node keeps sending.  each time scale keeps an exponentially decayed
+ //spectrum and a JSON line goes out only when the flags from one of them change.
+ //memory is fixed by the FFT size and the number of scales.
+ int monitor(FILE *fp, const struct fft_plan *plan, const float *tau, int nscales) {
+	struct raw_hivedata raw_hive;
+	float frame_array[plan->acc_bins];
+	struct monitor_run run = {.acc = {.plan = plan, .fft = &plan->fft[0], .master_fft_array = frame_array}};
+	struct stft stft;
+	int16_t chunk[STREAM_CHUNK];
+	size_t nr;
+
+	if (read_hivedata(fp, &raw_hive)) {
+		return -EIO;
+	}
+	th_handle(&plan->analysis, &raw_hive, &run.hive);
+	void *ema = arena_alloc(plan->scratch, monitor_mem_size(nscales, plan->acc_bins));
+	void *ring = arena_alloc(plan->scratch, stft_mem_size(plan->frame_len));
+	if (!ema || !ring) {
+		return -ENOMEM;
+	}
+	int err = monitor_init(&run.mon, tau, nscales, (float)plan->hop / plan->analysis.sample_rate,
+			plan->acc_bins, ema);
+	if (err || (err = stft_init(&stft, plan->frame_len, plan->hop, monitor_frame, &run, ring))) {
+		return err;
+	}
+	report_buf_init(&run.report);
+	report_buf_init(&run.line);
+	while (!run.err && (nr = fread(chunk, sizeof(int16_t), STREAM_CHUNK, fp)) > 0) {
+		stft_push(&stft, chunk, nr);
+	}
+	report_buf_free(&run.line);
+	report_buf_free(&run.report);
+	stft_free(&stft);
+	monitor_free(&run.mon);
+	return run.err ? run.err : ferror(fp) ? -EIO : 0;
+ }
@@ -0,0 +1,136 @@
+//the processing pipeline behind hive_process: a plan built once from the options,
+//then recordings in memory, from a pipe or a stream with no end go through it to a
+//report.  bench_hive times the same calls.
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "hive.h"
+#include "config.h"
+#include "window.h"
+#include "spectrum.h"
+#include "report.h"
+#include "bands.h"
+#include "goertzel.h"
+#include "features.h"
+#include "stats.h"
+#include "arena.h"
+
+enum report_format {
+	FORMAT_JSON,
+	FORMAT_BIN,	//report_bin.h with a float32 spectrum
+	FORMAT_BIN16,	//same with float16
+};
+
+//bands for --spectrogram, and for --bands without a count
+#define BANDS_DEFAULT 32
+
+//how reports are made, from the command line
+struct plan_options {
+	//frame size, hop, window, FFT and thresholds, from --config and the command line
+	struct hive_config cfg;
+	enum spectrum_mode mode;
+	int threads;
+	enum report_format format;
+	//band summary instead of the full spectrum when nbands > 0
+	int nbands;
+	enum band_scale band_scale;
+	float fmin;
+	//highest frequency reported, 0 for all of them
+	float fmax;
+	//fft_data only holds the nfft/2+1 bins the FFT fills.  without it there are nfft
+	//values as there always were, the rest 0.
+	int trim;
+	//only work out the bins audio_compare needs, the report has no spectrum
+	int flags_only;
+	//timings of every recording on stderr
+	int stats;
+	//frames per spectrogram row, 0 for no spectrogram
+	int spectrogram;
+};
+
+//everything that only depends on the frame size, built once per process
+struct fft_plan {
+	//samples per frame, frames are zero padded up to the FFT size
+	int frame_len;
+	//FFT size, its nfft/2+1 bins and their width
+	int nfft;
+	int fft_bins;
+	float bin_hz;
+	struct window window;
+	enum spectrum_mode mode;
+	//the bins audio_compare reads, audio_range_bins order.  only for --flags-only
+	//and --power, nrange is 0 otherwise.
+	int nrange;
+	int range_bin[GOERTZEL_MAX_BINS];
+	//values in a summed spectrum: the fft_bins of plan->mode, then with --power the
+	//summed magnitudes of the range bins, so the flags don't depend on the mode
+	int acc_bins;
+	int hop;
+	//threads FFT_handle splits a recording over, each with its own FFT state.
+	//fft[0] is for this thread and the stream path.
+	int threads;
+	struct fft *fft;
+	//what the reports are written as
+	enum report_format format;
+	//spectrum values in a report, bins above fmax are left out.  can be more than
+	//fft_bins, the ones past it are 0.
+	int nbins;
+	//bands.nbands is 0 when the report carries the spectrum
+	struct bands bands;
+	//flags_only reports leave the spectrum out.  their frames go through the goertzel
+	//filters instead of the FFT when that is cheaper, goertzel.nbins is 0 otherwise.
+	int flags_only;
+	struct goertzel goertzel;
+	//where the current recording's timings go, NULL without --stats
+	struct hive_stats *stats;
+	//frames per spectrogram row and the bands the rows are made of
+	int spectrogram;
+	struct bands sg_bands;
+	//where the current recording's spectrogram goes, NULL for none
+	FILE *spectrogram_out;
+	//per recording scratch memory, everything taken from it is given back before
+	//the recording's report is returned
+	struct arena *scratch;
+	//sample rate, frequencies and thresholds audio_compare uses
+	struct analysis_params analysis;
+};
+
+//allocations FFT_handle takes from the scratch arena for a threaded recording
+#define FFT_HANDLE_ALLOCS 4
+
+//returns 0, -EINVAL for options it can't do, -E2BIG or -ENOMEM
+int fft_plan_init(struct fft_plan *plan, const struct plan_options *opt);
+void fft_plan_free(struct fft_plan *plan);
+
+//the hive header at the start of fp.  returns 0, -ENOENT or -EIO.
+int read_hivedata(FILE *fp, struct raw_hivedata *dest);
+
+//sums the spectrum of every frame of samples into master_fft_array, plan->acc_bins
+//values.  returns 0, -ENOMEM or -EIO from the spectrogram.
+int FFT_handle(const int16_t *samples, size_t nsamples, const struct fft_plan *plan, float *master_fft_array);
+//sizes of what FFT_handle takes from the scratch arena to split a recording over
+//threads threads, in the order it takes them
+void fft_handle_scratch(const struct fft_plan *plan, int threads, size_t size[FFT_HANDLE_ALLOCS]);
+//bee flags into hive and the features of a summed spectrum from FFT_handle, only the
+//ones around the bee frequencies unless full
+void compare_spectrum(const struct fft_plan *plan, const float *fft_array, int full, float *features,
+		struct hivedata *hive);
+
+//one recording (hive header, then audio or a spectrum packet) held in memory.
+//returns 0 or -errno.
+int process_recording(const uint8_t *data, size_t len, const struct fft_plan *plan, struct report_buf *out);
+//the same read front to back, with partial > 0 a report of the spectrum so far goes
+//to stdout every partial frames
+int process_stream(FILE *fp, const struct fft_plan *plan, int partial, struct report_buf *out);
+//regular files are mapped and go to process_recording, anything else is streamed
+int process_fd(int fd, const struct fft_plan *plan, int partial, struct report_buf *out);
+//--monitor: JSON lines on stdout whenever the flags of one of nscales time scales of
+//tau[] seconds change, until fp ends
+int monitor(FILE *fp, const struct fft_plan *plan, const float *tau, int nscales);
+
+#endif
@@ -0,0 +1,287 @@
+//report text buffer.
+//report_format_float avoids printf: the value is scaled by a power of ten into a
+//six digit integer and the digits are written out directly, which is several times
+//quicker than snprintf("%g") and gives the same digits.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "report.h"
+#include "features.h"
+
+#define SIG_DIGITS 6
+
+//covers the decimal exponents the fast path takes, -5..15 (plus one either side)
+static const double pow10_tab[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+};
+
+void report_buf_init(struct report_buf *b) {
+	b->data = NULL;
+	b->len = 0;
+	b->cap = 0;
+}
+
+void report_buf_free(struct report_buf *b) {
+	free(b->data);
+	report_buf_init(b);
+}
+
+void report_buf_reset(struct report_buf *b) {
+	b->len = 0;
+	if (b->data) {
+		b->data[0] = '\0';
+	}
+}
+
+int report_reserve(struct report_buf *b, size_t extra) {
+	size_t need = b->len + extra + 1;
+	if (need <= b->cap) {
+		return 0;
+	}
+	size_t cap = b->cap ? b->cap : 256;
+	while (cap < need) {
+		cap *= 2;
+	}
+	char *tmp = realloc(b->data, cap);
+	if (!tmp) {
+		return -ENOMEM;
+	}
+	b->data = tmp;
+	b->cap = cap;
+	return 0;
+}
+
+static int report_append(struct report_buf *b, const char *s, size_t n) {
+	if (report_reserve(b, n)) {
+		return -ENOMEM;
+	}
+	memcpy(b->data + b->len, s, n);
+	b->len += n;
+	b->data[b->len] = '\0';
+	return 0;
+}
+
+int report_raw(struct report_buf *b, const char *s) {
+	return report_append(b, s, strlen(s));
+}
+
+int report_string(struct report_buf *b, const char *s) {
+	//worst case every byte becomes \u00XX
+	if (report_reserve(b, 6 * strlen(s) + 2)) {
+		return -ENOMEM;
+	}
+	char *p = b->data + b->len;
+	*p++ = '"';
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			*p++ = '\\';
+			*p++ = *s;
+		}
+		else if ((unsigned char)*s < 0x20) {
+			p += sprintf(p, "\\u%04x", *s);
+		}
+		else {
+			*p++ = *s;
+		}
+	}
+	*p++ = '"';
+	*p = '\0';
+	b->len = p - b->data;
+	return 0;
+}
+
+int report_int(struct report_buf *b, int64_t v) {
+	char tmp[24];
+	char *p = tmp + sizeof(tmp);
+	uint64_t u = v < 0 ? -(uint64_t)v : (uint64_t)v;
+	do {
+		*--p = '0' + u % 10;
+		u /= 10;
+	} while (u);
+	if (v < 0) {
+		*--p = '-';
+	}
+	return report_append(b, p, tmp + sizeof(tmp) - p);
+}
+
+int report_format_float(char *out, float v) {
+	char *p = out;
+	double a = fabs((double)v);
+
+	if (isnan(v) || isinf(v)) {
+		memcpy(out, "null", 4);
+		return 4;
+	}
+	if (signbit(v) && a != 0) {
+		*p++ = '-';
+	}
+	if (a == 0) {
+		memcpy(p, "0.0", 3);
+		return p - out + 3;
+	}
+	//decimal exponent from the binary one (log10(2) ~ 1233/4096), then fix it up
+	int bexp;
+	frexp(a, &bexp);
+	int e = ((bexp - 1) * 1233) >> 12;
+	if (e < -5 || e > 15) {
+		//far outside anything a spectrum holds, not worth a fast path
+		int n = snprintf(p, REPORT_FLOAT_MAX - 1, "%g", a);
+		if (!strpbrk(p, ".e")) {
+			memcpy(p + n, ".0", 2);
+			n += 2;
+		}
+		return p - out + n;
+	}
+	double scaled = e >= SIG_DIGITS - 1 ? a / pow10_tab[e - (SIG_DIGITS - 1)]
+					    : a * pow10_tab[SIG_DIGITS - 1 - e];
+	if (scaled >= 999999.5) {
+		e++;
+		scaled /= 10;
+	}
+	else if (scaled < 99999.5) {
+		e--;
+		scaled *= 10;
+	}
+	//round half to even like printf does
+	uint32_t m = (uint32_t)scaled;
+	double frac = scaled - m;
+	if (frac > 0.5 || (frac == 0.5 && (m & 1))) {
+		m++;
+	}
+	if (m >= 1000000) {
+		m /= 10;
+		e++;
+	}
+
+	char digits[SIG_DIGITS];
+	for (int i = SIG_DIGITS - 1; i >= 0; i--) {
+		digits[i] = '0' + m % 10;
+		m /= 10;
+	}
+	int nd = SIG_DIGITS;
+	while (nd > 1 && digits[nd - 1] == '0') {
+		nd--;
+	}
+
+	if (e >= 0) {
+		//integer part is digits[0..e], padded with zeros past the significant ones
+		for (int i = 0; i <= e; i++) {
+			*p++ = i < nd ? digits[i] : '0';
+		}
+		*p++ = '.';
+		if (e + 1 < nd) {
+			memcpy(p, digits + e + 1, nd - e - 1);
+			p += nd - e - 1;
+		}
+		else {
+			*p++ = '0';
+		}
+	}
+	else {
+		*p++ = '0';
+		*p++ = '.';
+		for (int i = -1; i > e; i--) {
+			*p++ = '0';
+		}
+		memcpy(p, digits, nd);
+		p += nd;
+	}
+	return p - out;
+}
+
+int report_float(struct report_buf *b, float v) {
+	if (report_reserve(b, REPORT_FLOAT_MAX)) {
+		return -ENOMEM;
+	}
+	b->len += report_format_float(b->data + b->len, v);
+	b->data[b->len] = '\0';
+	return 0;
+}
+
+int report_floats(struct report_buf *b, const float *v, size_t n) {
+	//one reservation for the whole array, then plain stores
+	if (report_reserve(b, n * (REPORT_FLOAT_MAX + 1) + 2)) {
+		return -ENOMEM;
+	}
+	char *p = b->data + b->len;
+	*p++ = '[';
+	for (size_t i = 0; i < n; i++) {
+		if (i) {
+			*p++ = ',';
+		}
+		p += report_format_float(p, v[i]);
+	}
+	*p++ = ']';
+	*p = '\0';
+	b->len = p - b->data;
+	return 0;
+}
+
+int report_json(struct report_buf *out, const struct hivedata *hive, const struct report_content *c) {
+	static const char *flag_names[] = {
+		"queen_present", "multiple_queen", "possible_mites",
+		"three_day_in_range", "six_day_in_range", "nine_day_in_range",
+	};
+	int err = 0;
+
+	report_buf_reset(out);
+	err |= report_raw(out, "{\"temp\":");
+	err |= report_int(out, hive->temperature);
+	err |= report_raw(out, ",\"humidity\":");
+	err |= report_int(out, hive->humidity);
+	err |= report_raw(out, ",\"weight\":");
+	err |= report_int(out, hive->weight);
+	err |= report_raw(out, ",\"bee_flags\":{");
+	for (size_t i = 0; i < sizeof(hive->bee_flags); i++) {
+		err |= report_raw(out, i ? ",\"" : "\"");
+		err |= report_raw(out, flag_names[i]);
+		err |= report_raw(out, "\":");
+		err |= report_int(out, hive->bee_flags[i]);
+	}
+	err |= report_raw(out, "},\"spectrum\":");
+	err |= report_string(out, c->power ? "power" : "magnitude");
+	if (c->spectrum) {
+		err |= report_raw(out, ",\"fft_data\":");
+		err |= report_floats(out, c->spectrum, c->nspectrum);
+	}
+	if (c->nbands) {
+		err |= report_raw(out, ",\"bands\":{\"scale\":");
+		err |= report_string(out, band_scale_name(c->band_scale));
+		err |= report_raw(out, ",\"edges\":");
+		err |= report_floats(out, c->band_edge, c->nbands + 1);
+		err |= report_raw(out, ",\"mean\":");
+		err |= report_floats(out, c->band_mean, c->nbands);
+		err |= report_raw(out, ",\"peak\":");
+		err |= report_floats(out, c->band_peak, c->nbands);
+		err |= report_raw(out, ",\"energy\":");
+		err |= report_floats(out, c->band_energy, c->nbands);
+		err |= report_raw(out, "}");
+	}
+	if (c->features) {
+		const float *f = c->features;
+		err |= report_raw(out, ",\"features\":{\"centroid\":");
+		err |= report_float(out, f[FEATURE_CENTROID]);
+		err |= report_raw(out, ",\"flatness\":");
+		err |= report_float(out, f[FEATURE_FLATNESS]);
+		err |= report_raw(out, ",\"noise_floor\":");
+		err |= report_float(out, f[FEATURE_NOISE_FLOOR]);
+		//AUDIO_* order: 4 day, 6 day, 9 day bee, queen, queen reference
+		err |= report_raw(out, ",\"peak_hz\":");
+		err |= report_floats(out, f + FEATURE_PEAK_HZ, AUDIO_NBINS);
+		err |= report_raw(out, ",\"peak\":");
+		err |= report_floats(out, f + FEATURE_PEAK, AUDIO_NBINS);
+		err |= report_raw(out, ",\"level\":");
+		err |= report_floats(out, f + FEATURE_LEVEL, AUDIO_NBINS);
+		err |= report_raw(out, ",\"snr_db\":");
+		err |= report_floats(out, f + FEATURE_SNR_DB, AUDIO_NBINS);
+		err |= report_raw(out, ",\"age_ratio\":");
+		err |= report_floats(out, f + FEATURE_AGE_RATIO, 3);
+		err |= report_raw(out, "}");
+	}
+	err |= report_raw(out, "}");
+	return err ? -ENOMEM : 0;
+}
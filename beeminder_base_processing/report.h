@@ -0,0 +1,66 @@
+//append-only text buffer and the number formatting used to write reports.
+//the buffer is reused between reports, so after the first one a report costs
+//no allocations at all.
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hive.h"
+#include "bands.h"
+
+struct report_buf {
+	char *data;
+	size_t len;
+	size_t cap;
+};
+
+//longest text report_float can produce
+#define REPORT_FLOAT_MAX 24
+
+void report_buf_init(struct report_buf *b);
+void report_buf_free(struct report_buf *b);
+//empties the buffer but keeps its memory
+void report_buf_reset(struct report_buf *b);
+//makes room for extra more bytes plus the terminating nul.  returns 0 or -ENOMEM.
+int report_reserve(struct report_buf *b, size_t extra);
+
+//the append functions grow the buffer as needed and return 0 or -ENOMEM.
+//data is always nul terminated.
+int report_raw(struct report_buf *b, const char *s);
+int report_string(struct report_buf *b, const char *s);
+int report_int(struct report_buf *b, int64_t v);
+int report_float(struct report_buf *b, float v);
+//[v0,v1,...]
+int report_floats(struct report_buf *b, const float *v, size_t n);
+
+//writes v with 6 significant digits (what %g gives) into out, returns the length.
+//the text always reads back as a float in JSON ("12.0", not "12"); NaN and
+//infinities become null.
+int report_format_float(char *out, float v);
+
+//what a report carries besides the hive data
+struct report_content {
+	int power;		//spectrum and band values are power, not magnitude
+	//full spectrum, NULL to leave it out
+	const float *spectrum;
+	size_t nspectrum;
+	float bin_hz;		//Hz between spectrum values
+	//band summary, nbands 0 to leave it out
+	int nbands;
+	enum band_scale band_scale;
+	const float *band_edge;	//nbands+1 edges in Hz
+	const float *band_mean;
+	const float *band_peak;
+	const float *band_energy;
+	//FEATURE_COUNT spectral features of the amplitudes (features.h), NULL to leave them out
+	const float *features;
+};
+
+//writes the JSON report for one hive into out (which is emptied first).
+//returns 0 or -ENOMEM.
+int report_json(struct report_buf *out, const struct hivedata *hive, const struct report_content *c);
+
+#endif
@@ -0,0 +1,130 @@
+//turns binary reports from hive_process --format bin/bin16 back into the JSON
+//report hive_process would have written.
+//usage: report2json [file...], reads stdin without files.  a file can hold several
+//reports back to back (--partial output), each becomes one line.
+//a --spectrogram file becomes a single line with its band edges and rows of dB.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "report.h"
+#include "report_bin.h"
+#include "spectrogram.h"
+
+static int read_all(FILE *fp, uint8_t **data, size_t *len) {
+	size_t cap = 1 << 16;
+	*len = 0;
+	*data = malloc(cap);
+	if (!*data) {
+		return -ENOMEM;
+	}
+	size_t got;
+	while ((got = fread(*data + *len, 1, cap - *len, fp)) > 0) {
+		*len += got;
+		if (*len == cap) {
+			uint8_t *grown = realloc(*data, cap * 2);
+			if (!grown) {
+				return -ENOMEM;
+			}
+			*data = grown;
+			cap *= 2;
+		}
+	}
+	return ferror(fp) ? -EIO : 0;
+}
+
+static int convert_one(const struct report_view *view, struct report_buf *out) {
+	struct report_content c;
+	int err = report_bin_content(view, &c);
+
+	if (!err) {
+		err = report_json(out, &view->hive, &c);
+	}
+	if (!err) {
+		fwrite(out->data, 1, out->len, stdout);
+		putchar('\n');
+	}
+	report_content_free(&c);
+	return err;
+}
+
+static int convert_spectrogram(const struct spectrogram_view *view, struct report_buf *out) {
+	float v[view->nbands + 1];
+	int err = 0;
+
+	report_buf_reset(out);
+	err |= report_raw(out, "{\"spectrogram\":{\"scale\":");
+	err |= report_string(out, band_scale_name(view->scale));
+	err |= report_raw(out, ",\"frames_per_row\":");
+	err |= report_int(out, view->frames_per_row);
+	err |= report_raw(out, ",\"row_seconds\":");
+	err |= report_float(out, view->row_seconds);
+	err |= report_raw(out, ",\"edges\":");
+	spectrogram_edges(view, v);
+	err |= report_floats(out, v, view->nbands + 1);
+	err |= report_raw(out, ",\"db\":[");
+	for (size_t r = 0; r < view->nrows; r++) {
+		if (r) {
+			err |= report_raw(out, ",");
+		}
+		spectrogram_row(view, r, v);
+		err |= report_floats(out, v, view->nbands);
+	}
+	err |= report_raw(out, "]}}");
+	if (err) {
+		return -ENOMEM;
+	}
+	fwrite(out->data, 1, out->len, stdout);
+	putchar('\n');
+	return 0;
+}
+
+static int convert(FILE *fp, const char *name, struct report_buf *out) {
+	uint8_t *data;
+	size_t len, off = 0;
+	struct report_view view;
+	struct spectrogram_view sg;
+	int err = read_all(fp, &data, &len);
+
+	if (!err && spectrogram_read(data, len, &sg) == 0) {
+		err = convert_spectrogram(&sg, out);
+		free(data);
+		return err;
+	}
+	while (!err && off < len) {
+		if ((err = report_bin_read(data + off, len - off, &view))) {
+			fprintf(stderr, "%s: not a hive report at byte %zu\n", name, off);
+			break;
+		}
+		err = convert_one(&view, out);
+		off += view.size;
+	}
+	free(data);
+	return err;
+}
+
+int main(int argc, char **argv) {
+	struct report_buf out;
+	int ret = 0;
+
+	report_buf_init(&out);
+	if (argc < 2) {
+		ret = convert(stdin, "stdin", &out) ? 1 : 0;
+	}
+	for (int i = 1; i < argc; i++) {
+		FILE *fp = fopen(argv[i], "rb");
+		if (!fp) {
+			perror(argv[i]);
+			ret = 1;
+			continue;
+		}
+		if (convert(fp, argv[i], &out)) {
+			ret = 1;
+		}
+		fclose(fp);
+	}
+	report_buf_free(&out);
+	return ret;
+}
@@ -0,0 +1,269 @@
+//binary report writer and reader, see report_bin.h for the layout.
+//fields are written a byte at a time so the result doesn't depend on the
+//host's byte order or struct padding.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "report_bin.h"
+#include "hive_f16.h"
+#include "features.h"
+
+static void put_u16(uint8_t *p, uint16_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void put_f32(uint8_t *p, float v) {
+	uint32_t u;
+	memcpy(&u, &v, sizeof(u));
+	put_u32(p, u);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+	return p[0] | p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static float get_f32(const uint8_t *p) {
+	uint32_t u = get_u32(p);
+	float v;
+	memcpy(&v, &u, sizeof(v));
+	return v;
+}
+
+static int dtype_size(enum report_dtype dtype) {
+	return dtype == REPORT_F16 ? 2 : 4;
+}
+
+static size_t section_size(enum report_dtype dtype, size_t n) {
+	return REPORT_BIN_SECTION_LEN + ((n * dtype_size(dtype) + 3) & ~(size_t)3);
+}
+
+//writes one section at p and returns where the next one goes
+static uint8_t *put_section(uint8_t *p, uint16_t type, enum report_dtype dtype,
+		const float *v, size_t n, float step) {
+	float scale = dtype == REPORT_F16 ? hive_f16_scale(v, n) : 1;
+
+	put_u16(p, type);
+	p[2] = dtype;
+	p[3] = dtype_size(dtype);
+	put_u32(p + 4, n);
+	put_f32(p + 8, scale);
+	put_f32(p + 12, step);
+	if (dtype == REPORT_F16) {
+		float inv = 1 / scale;
+		for (size_t i = 0; i < n; i++) {
+			put_u16(p + REPORT_BIN_SECTION_LEN + 2 * i, hive_f32_to_f16(v[i] * inv));
+		}
+	} else {
+		for (size_t i = 0; i < n; i++) {
+			put_f32(p + REPORT_BIN_SECTION_LEN + 4 * i, v[i]);
+		}
+	}
+	return p + section_size(dtype, n);
+}
+
+int report_bin(struct report_buf *out, const struct hivedata *hive,
+		const struct report_content *c, enum report_dtype dtype) {
+	size_t len = REPORT_BIN_HEADER_LEN;
+	int nsections = 0;
+
+	if (c->nspectrum > UINT32_MAX || c->nbands < 0 || (dtype != REPORT_F32 && dtype != REPORT_F16)) {
+		return -EINVAL;
+	}
+	if (c->spectrum) {
+		len += section_size(dtype, c->nspectrum);
+		nsections++;
+	}
+	if (c->nbands) {
+		len += section_size(REPORT_F32, c->nbands + 1) + 3 * section_size(dtype, c->nbands);
+		nsections += 4;
+	}
+	if (c->features) {
+		len += section_size(REPORT_F32, FEATURE_COUNT);
+		nsections++;
+	}
+	report_buf_reset(out);
+	if (report_reserve(out, len)) {
+		return -ENOMEM;
+	}
+	uint8_t *p = (uint8_t *)out->data;
+	memset(p, 0, len);
+
+	memcpy(p, REPORT_BIN_MAGIC, 4);
+	put_u16(p + 4, REPORT_BIN_VERSION);
+	put_u16(p + 6, REPORT_BIN_HEADER_LEN);
+	put_u32(p + 8, hive->temperature);
+	put_u32(p + 12, hive->humidity);
+	put_u32(p + 16, hive->weight);
+	p[20] = hive->humidity_flag;
+	p[21] = hive->temperature_flag;
+	memcpy(p + 22, hive->bee_flags, sizeof(hive->bee_flags));
+	put_u16(p + 28, (c->power ? REPORT_BIN_POWER : 0) |
+			(c->nbands && c->band_scale == BANDS_LOG ? REPORT_BIN_LOG_BANDS : 0));
+	put_u16(p + 30, nsections);
+	p += REPORT_BIN_HEADER_LEN;
+
+	if (c->spectrum) {
+		p = put_section(p, REPORT_SECTION_SPECTRUM, dtype, c->spectrum, c->nspectrum, c->bin_hz);
+	}
+	if (c->nbands) {
+		//edges stay f32, half precision would move them by several Hz
+		p = put_section(p, REPORT_SECTION_BAND_EDGES, REPORT_F32, c->band_edge, c->nbands + 1, 0);
+		p = put_section(p, REPORT_SECTION_BAND_MEAN, dtype, c->band_mean, c->nbands, 0);
+		p = put_section(p, REPORT_SECTION_BAND_PEAK, dtype, c->band_peak, c->nbands, 0);
+		p = put_section(p, REPORT_SECTION_BAND_ENERGY, dtype, c->band_energy, c->nbands, 0);
+	}
+	if (c->features) {
+		//a handful of values of very different sizes, not worth halving
+		p = put_section(p, REPORT_SECTION_FEATURES, REPORT_F32, c->features, FEATURE_COUNT, 0);
+	}
+	out->len = len;
+	return 0;
+}
+
+int report_bin_read(const uint8_t *buf, size_t len, struct report_view *view) {
+	if (len < REPORT_BIN_HEADER_LEN || memcmp(buf, REPORT_BIN_MAGIC, 4)) {
+		return -EINVAL;
+	}
+	size_t header_len = get_u16(buf + 6);
+	view->version = get_u16(buf + 4);
+	if (view->version != REPORT_BIN_VERSION || header_len < REPORT_BIN_HEADER_LEN || header_len > len) {
+		return -EINVAL;
+	}
+	view->hive.temperature = get_u32(buf + 8);
+	view->hive.humidity = get_u32(buf + 12);
+	view->hive.weight = get_u32(buf + 16);
+	view->hive.humidity_flag = buf[20];
+	view->hive.temperature_flag = buf[21];
+	memcpy(view->hive.bee_flags, buf + 22, sizeof(view->hive.bee_flags));
+	view->flags = get_u16(buf + 28);
+
+	int nsections = get_u16(buf + 30);
+	size_t off = header_len;
+	view->nsections = 0;
+	for (int i = 0; i < nsections; i++) {
+		if (len - off < REPORT_BIN_SECTION_LEN) {
+			return -EINVAL;
+		}
+		const uint8_t *p = buf + off;
+		struct report_section s = {
+			.type = get_u16(p),
+			.dtype = p[2],
+			.count = get_u32(p + 4),
+			.scale = get_f32(p + 8),
+			.step = get_f32(p + 12),
+			.data = p + REPORT_BIN_SECTION_LEN,
+		};
+		//a dtype from a newer writer is skipped by its value size, like an unknown type.
+		//reports from before the size was written have 0 there and only known dtypes.
+		int known = s.dtype == REPORT_F32 || s.dtype == REPORT_F16;
+		int size = known ? dtype_size(s.dtype) : p[3];
+		if (!size) {
+			return -EINVAL;
+		}
+		uint64_t payload = ((uint64_t)s.count * size + 3) & ~(uint64_t)3;
+		off += REPORT_BIN_SECTION_LEN;
+		if (payload > len - off) {
+			return -EINVAL;
+		}
+		off += payload;
+		if (known && view->nsections < REPORT_BIN_MAX_SECTIONS) {
+			view->sections[view->nsections++] = s;
+		}
+	}
+	view->size = off;
+	return 0;
+}
+
+const struct report_section *report_bin_section(const struct report_view *view, uint16_t type) {
+	for (int i = 0; i < view->nsections; i++) {
+		if (view->sections[i].type == type) {
+			return &view->sections[i];
+		}
+	}
+	return NULL;
+}
+
+void report_section_floats(const struct report_section *s, float *out) {
+	if (s->dtype == REPORT_F16) {
+		for (uint32_t i = 0; i < s->count; i++) {
+			out[i] = hive_f16_to_f32(get_u16(s->data + 2 * i)) * s->scale;
+		}
+	} else {
+		for (uint32_t i = 0; i < s->count; i++) {
+			out[i] = get_f32(s->data + 4 * i) * s->scale;
+		}
+	}
+}
+
+//decodes a section of the given type into a new array, *n is its length
+static int section_array(const struct report_view *view, uint16_t type, const float **v, size_t *n) {
+	const struct report_section *s = report_bin_section(view, type);
+	*v = NULL;
+	*n = 0;
+	if (!s) {
+		return 0;
+	}
+	float *out = malloc((s->count ? s->count : 1) * sizeof(float));
+	if (!out) {
+		return -ENOMEM;
+	}
+	report_section_floats(s, out);
+	*v = out;
+	*n = s->count;
+	return 0;
+}
+
+int report_bin_content(const struct report_view *view, struct report_content *c) {
+	const struct report_section *spectrum = report_bin_section(view, REPORT_SECTION_SPECTRUM);
+	size_t nedges, nmean, npeak, nenergy, nfeatures;
+	int err = 0;
+
+	memset(c, 0, sizeof(*c));
+	c->power = !!(view->flags & REPORT_BIN_POWER);
+	c->band_scale = view->flags & REPORT_BIN_LOG_BANDS ? BANDS_LOG : BANDS_MEL;
+	c->bin_hz = spectrum ? spectrum->step : 0;
+	err |= section_array(view, REPORT_SECTION_SPECTRUM, &c->spectrum, &c->nspectrum);
+	err |= section_array(view, REPORT_SECTION_BAND_EDGES, &c->band_edge, &nedges);
+	err |= section_array(view, REPORT_SECTION_BAND_MEAN, &c->band_mean, &nmean);
+	err |= section_array(view, REPORT_SECTION_BAND_PEAK, &c->band_peak, &npeak);
+	err |= section_array(view, REPORT_SECTION_BAND_ENERGY, &c->band_energy, &nenergy);
+	err |= section_array(view, REPORT_SECTION_FEATURES, &c->features, &nfeatures);
+	if (err) {
+		report_content_free(c);
+		return -ENOMEM;
+	}
+	//all four band sections, agreeing on the band count, or no bands
+	if (nedges > 1 && nmean == nedges - 1 && npeak == nmean && nenergy == nmean) {
+		c->nbands = nmean;
+	}
+	//features from a different layout can't be named, leave them out
+	if (c->features && nfeatures != FEATURE_COUNT) {
+		free((float *)c->features);
+		c->features = NULL;
+	}
+	return 0;
+}
+
+void report_content_free(struct report_content *c) {
+	free((float *)c->spectrum);
+	free((float *)c->band_edge);
+	free((float *)c->band_mean);
+	free((float *)c->band_peak);
+	free((float *)c->band_energy);
+	free((float *)c->features);
+	memset(c, 0, sizeof(*c));
+}
@@ -0,0 +1,97 @@
+//compact binary reports (--format bin / bin16).
+//
+//everything is little endian.  a report is a fixed header followed by sections:
+//
+//  header (REPORT_BIN_HEADER_LEN bytes)
+//    0  char[4] magic "HIVR"
+//    4  u16     version (REPORT_BIN_VERSION, bumped only for incompatible changes)
+//    6  u16     header_len, sections start here.  new fields are appended to the
+//               header, so readers must skip to header_len rather than assume 32
+//    8  u32     temperature
+//    12 u32     humidity
+//    16 u32     weight
+//    20 u8      humidity_flag
+//    21 u8      temperature_flag
+//    22 u8[6]   bee_flags, same order as the JSON report
+//    28 u16     flags (REPORT_BIN_*)
+//    30 u16     number of sections
+//
+//  section (REPORT_BIN_SECTION_LEN bytes, then the payload)
+//    0  u16     type (REPORT_SECTION_*); readers skip types they don't know
+//    2  u8      dtype (REPORT_F32 / REPORT_F16)
+//    3  u8      bytes per value, so readers can skip a dtype they don't know
+//    4  u32     count, number of values
+//    8  f32     scale, value = stored * scale
+//    12 f32     step, hertz between values (0 when they aren't evenly spaced)
+//    16 ...     payload, count values padded to a multiple of 4 bytes
+
+#ifndef REPORT_BIN_H
+#define REPORT_BIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hive.h"
+#include "report.h"
+
+#define REPORT_BIN_MAGIC "HIVR"
+#define REPORT_BIN_VERSION 1
+#define REPORT_BIN_HEADER_LEN 32
+#define REPORT_BIN_SECTION_LEN 16
+
+//header flags
+#define REPORT_BIN_POWER 0x1	//spectrum holds power instead of magnitude
+#define REPORT_BIN_LOG_BANDS 0x2	//bands are log spaced, mel otherwise
+
+//section types
+#define REPORT_SECTION_SPECTRUM 1
+#define REPORT_SECTION_BAND_EDGES 2	//nbands+1 edges in Hz, always f32
+#define REPORT_SECTION_BAND_MEAN 3
+#define REPORT_SECTION_BAND_PEAK 4
+#define REPORT_SECTION_BAND_ENERGY 5
+#define REPORT_SECTION_FEATURES 6	//FEATURE_COUNT values in features.h order, always f32
+
+enum report_dtype {
+	REPORT_F32 = 1,
+	REPORT_F16 = 2,	//IEEE half, scaled by a power of two to fit its range
+};
+
+//a reader will look at this many sections at most
+#define REPORT_BIN_MAX_SECTIONS 16
+
+struct report_section {
+	uint16_t type;
+	uint8_t dtype;
+	uint32_t count;
+	float scale;
+	float step;
+	const uint8_t *data;	//points into the buffer given to report_bin_read
+};
+
+struct report_view {
+	uint16_t version;
+	uint16_t flags;
+	size_t size;	//bytes the report takes up, reports can be read back to back
+	struct hivedata hive;
+	int nsections;
+	struct report_section sections[REPORT_BIN_MAX_SECTIONS];
+};
+
+//writes the binary report for one hive into out (which is emptied first).
+//dtype is used for the spectrum and band values.  returns 0, -EINVAL or -ENOMEM.
+int report_bin(struct report_buf *out, const struct hivedata *hive,
+		const struct report_content *c, enum report_dtype dtype);
+//the report_content a view describes.  the arrays are allocated with malloc and
+//belong to the caller (report_content_free).  returns 0 or -ENOMEM.
+int report_bin_content(const struct report_view *view, struct report_content *c);
+void report_content_free(struct report_content *c);
+
+//parses the report at the start of buf without copying it.  returns 0 or -EINVAL
+//if buf isn't a report this reader understands or is cut short.
+int report_bin_read(const uint8_t *buf, size_t len, struct report_view *view);
+//first section of the given type, NULL if there is none
+const struct report_section *report_bin_section(const struct report_view *view, uint16_t type);
+//decodes the section's count values (scale applied) into out
+void report_section_floats(const struct report_section *s, float *out);
+
+#endif
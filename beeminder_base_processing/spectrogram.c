@@ -0,0 +1,187 @@
+//spectrogram writer and reader, see spectrogram.h for the layout.
+//each frame is added to a one row accumulator with the same kernel as the summed
+//spectrum; a row is reduced to bands and written out as soon as it is complete.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "spectrogram.h"
+#include "spectrum.h"
+#include "hive_f16.h"
+
+static void put_u16(uint8_t *p, uint16_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void put_f32(uint8_t *p, float v) {
+	uint32_t u;
+	memcpy(&u, &v, sizeof(u));
+	put_u32(p, u);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+	return p[0] | p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static float get_f32(const uint8_t *p) {
+	uint32_t u = get_u32(p);
+	float v;
+	memcpy(&v, &u, sizeof(v));
+	return v;
+}
+
+static size_t value_size(enum report_dtype dtype) {
+	return dtype == REPORT_F16 ? 2 : 4;
+}
+
+int spectrogram_init(struct spectrogram *s, const struct bands *bands, int nbins, int frames_per_row,
+		float row_seconds, enum report_dtype dtype, FILE *out, void *mem) {
+	int nbands = bands->nbands;
+
+	if (nbands <= 0 || nbands > UINT16_MAX || frames_per_row <= 0 || nbins <= 0 ||
+	    (dtype != REPORT_F32 && dtype != REPORT_F16)) {
+		return -EINVAL;
+	}
+	s->own_mem = !mem;
+	if (!mem && !(mem = malloc(spectrogram_mem_size(nbins, nbands)))) {
+		return -ENOMEM;
+	}
+	s->bands = bands;
+	s->nbins = nbins;
+	s->frames_per_row = frames_per_row;
+	s->dtype = dtype;
+	s->out = out;
+	s->power = mem;
+	s->mean = s->power + nbins;
+	s->peak = s->mean + nbands;
+	s->energy = s->peak + nbands;
+	s->row = (uint8_t *)(s->energy + nbands);
+	s->frames = 0;
+	s->rows = 0;
+	s->err = 0;
+	memset(s->power, 0, nbins * sizeof(float));
+
+	uint8_t hdr[SPECTROGRAM_HEADER_LEN];
+	size_t header_len = SPECTROGRAM_HEADER_LEN + 4 * ((size_t)nbands + 1);
+	memcpy(hdr, SPECTROGRAM_MAGIC, 4);
+	put_u16(hdr + 4, SPECTROGRAM_VERSION);
+	put_u16(hdr + 6, header_len);
+	put_u16(hdr + 8, nbands);
+	hdr[10] = dtype;
+	hdr[11] = bands->scale == BANDS_LOG ? REPORT_BIN_LOG_BANDS : 0;
+	put_u32(hdr + 12, frames_per_row);
+	put_f32(hdr + 16, row_seconds);
+	if (fwrite(hdr, 1, sizeof(hdr), out) != sizeof(hdr)) {
+		s->err = -EIO;
+	}
+	//the row buffer is big enough for one edge at a time
+	for (int i = 0; i <= nbands && !s->err; i++) {
+		put_f32(s->row, bands->edge[i]);
+		if (fwrite(s->row, 1, 4, out) != 4) {
+			s->err = -EIO;
+		}
+	}
+	if (s->err) {
+		spectrogram_free(s);
+	}
+	return s->err;
+}
+
+void spectrogram_free(struct spectrogram *s) {
+	if (s->own_mem) {
+		free(s->power);
+	}
+	s->power = NULL;
+}
+
+static void write_row(struct spectrogram *s) {
+	int nbands = s->bands->nbands;
+	float inv = 1.0f / s->frames;
+
+	bands_summarise(s->bands, s->power, 1, s->mean, s->peak, s->energy);
+	for (int i = 0; i < nbands; i++) {
+		float e = s->energy[i] * inv;
+		//0 dB is below one LSB of 16 bit audio, nothing real lives under it
+		float db = e > 1 ? 10 * log10f(e) : 0;
+		if (s->dtype == REPORT_F16) {
+			put_u16(s->row + 2 * i, hive_f32_to_f16(db));
+		}
+		else {
+			put_f32(s->row + 4 * i, db);
+		}
+	}
+	size_t len = nbands * value_size(s->dtype);
+	if (!s->err && fwrite(s->row, 1, len, s->out) != len) {
+		s->err = -EIO;
+	}
+	memset(s->power, 0, s->nbins * sizeof(float));
+	s->frames = 0;
+	s->rows++;
+}
+
+void spectrogram_frame(struct spectrogram *s, const kiss_fft_cpx *bins) {
+	spectrum_accumulate(bins, s->power, s->nbins, SPECTRUM_POWER);
+	if (++s->frames == s->frames_per_row) {
+		write_row(s);
+	}
+}
+
+int spectrogram_finish(struct spectrogram *s) {
+	if (s->frames > 0) {
+		write_row(s);
+	}
+	if (fflush(s->out) && !s->err) {
+		s->err = -EIO;
+	}
+	return s->err;
+}
+
+int spectrogram_read(const uint8_t *buf, size_t len, struct spectrogram_view *view) {
+	if (len < SPECTROGRAM_HEADER_LEN || memcmp(buf, SPECTROGRAM_MAGIC, 4)) {
+		return -EINVAL;
+	}
+	view->version = get_u16(buf + 4);
+	size_t header_len = get_u16(buf + 6);
+	view->nbands = get_u16(buf + 8);
+	view->dtype = buf[10];
+	view->scale = buf[11] & REPORT_BIN_LOG_BANDS ? BANDS_LOG : BANDS_MEL;
+	view->frames_per_row = get_u32(buf + 12);
+	view->row_seconds = get_f32(buf + 16);
+	if (view->version != SPECTROGRAM_VERSION || view->nbands == 0 ||
+	    (view->dtype != REPORT_F32 && view->dtype != REPORT_F16) ||
+	    header_len < SPECTROGRAM_HEADER_LEN + 4 * ((size_t)view->nbands + 1) || header_len > len) {
+		return -EINVAL;
+	}
+	view->edges = buf + SPECTROGRAM_HEADER_LEN;
+	view->data = buf + header_len;
+	//a row cut short by a writer that died is dropped
+	view->nrows = (len - header_len) / (view->nbands * value_size(view->dtype));
+	return 0;
+}
+
+void spectrogram_edges(const struct spectrogram_view *view, float *out) {
+	for (int i = 0; i <= view->nbands; i++) {
+		out[i] = get_f32(view->edges + 4 * i);
+	}
+}
+
+void spectrogram_row(const struct spectrogram_view *view, size_t r, float *out) {
+	const uint8_t *p = view->data + r * view->nbands * value_size(view->dtype);
+	for (int i = 0; i < view->nbands; i++) {
+		out[i] = view->dtype == REPORT_F16 ? hive_f16_to_f32(get_u16(p + 2 * i)) : get_f32(p + 4 * i);
+	}
+}
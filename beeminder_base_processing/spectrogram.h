@@ -0,0 +1,91 @@
+//time resolved output (--spectrogram): band energies every few frames, written
+//while the frames go by so an hour long recording takes no more memory than a
+//short one.
+//
+//everything is little endian.  a header, then one row per frames_per_row frames:
+//
+//  header (SPECTROGRAM_HEADER_LEN bytes, then the band edges)
+//    0  char[4] magic "HIVS"
+//    4  u16     version (SPECTROGRAM_VERSION)
+//    6  u16     header_len, the first row starts here
+//    8  u16     nbands
+//    10 u8      dtype (REPORT_F32 / REPORT_F16) of the row values
+//    11 u8      flags (REPORT_BIN_LOG_BANDS)
+//    12 u32     frames_per_row
+//    16 f32     row_seconds, time from the start of one row to the next
+//    20 f32[nbands+1] band edges in Hz
+//
+//  row
+//    nbands values, 10*log10 of the mean energy per frame in each band, floored
+//    at 0 dB.  the last row can be made of fewer frames.
+//
+//there is no row count, rows run to the end of the file, so it can be written to a pipe.
+
+#ifndef SPECTROGRAM_H
+#define SPECTROGRAM_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kiss_fft.h"
+#include "bands.h"
+#include "report_bin.h"
+
+#define SPECTROGRAM_MAGIC "HIVS"
+#define SPECTROGRAM_VERSION 1
+#define SPECTROGRAM_HEADER_LEN 20
+
+struct spectrogram {
+	const struct bands *bands;
+	int nbins;
+	int frames_per_row;
+	enum report_dtype dtype;
+	FILE *out;
+	//power of the frames in the current row, summed per bin
+	float *power;
+	//bands_summarise output and the encoded row
+	float *mean, *peak, *energy;
+	uint8_t *row;
+	int frames;	//frames in the current row
+	size_t rows;
+	int err;	//first write error
+	int own_mem;
+};
+
+//bytes of memory a spectrogram of nbins bins and nbands bands needs
+#define spectrogram_mem_size(nbins, nbands) \
+	(((size_t)(nbins) + 3 * (size_t)(nbands)) * sizeof(float) + 4 * (size_t)(nbands))
+
+//starts a spectrogram of nbins bin spectra on out and writes its header.
+//mem is spectrogram_mem_size bytes the caller keeps alive until spectrogram_free,
+//or NULL to have it malloc'd.  returns 0, -EINVAL, -ENOMEM or -EIO.
+int spectrogram_init(struct spectrogram *s, const struct bands *bands, int nbins, int frames_per_row,
+		float row_seconds, enum report_dtype dtype, FILE *out, void *mem);
+void spectrogram_free(struct spectrogram *s);
+//adds one frame's FFT output, writes a row every frames_per_row frames
+void spectrogram_frame(struct spectrogram *s, const kiss_fft_cpx *bins);
+//writes the last, short row if there is one and flushes.  returns 0 or -EIO.
+int spectrogram_finish(struct spectrogram *s);
+
+//a spectrogram file read back, the edges and rows point into the buffer
+struct spectrogram_view {
+	uint16_t version;
+	int nbands;
+	enum report_dtype dtype;
+	enum band_scale scale;
+	uint32_t frames_per_row;
+	float row_seconds;
+	const uint8_t *edges;
+	const uint8_t *data;
+	size_t nrows;
+};
+
+//returns 0 or -EINVAL if buf doesn't start with a spectrogram this reader understands
+int spectrogram_read(const uint8_t *buf, size_t len, struct spectrogram_view *view);
+//the nbands+1 band edges
+void spectrogram_edges(const struct spectrogram_view *view, float *out);
+//the nbands values of row r
+void spectrogram_row(const struct spectrogram_view *view, size_t r, float *out);
+
+#endif
@@ -0,0 +1,93 @@
+//magnitude/power accumulation kernels.
+//like window.c the kernel is chosen at compile time: AVX2, SSE2, NEON (aarch64) or plain C.
+//all of them work in single precision, the scalar tail handles whatever is left.
+//the bin counts of the usual FFT sizes get their own copy with both the count and
+//the mode fixed.
+
+#include <math.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "spectrum.h"
+
+const char *spectrum_mode_name(enum spectrum_mode mode) {
+	return mode == SPECTRUM_POWER ? "power" : "magnitude";
+}
+
+//always inlined so every caller below gets a copy built for its nbins and sq
+static inline __attribute__((always_inline))
+void accumulate(const kiss_fft_cpx *bins, float *acc, int nbins, int sq) {
+	const float *in = (const float *)bins;
+	int k = 0;
+
+#if defined(__AVX2__)
+	for (; k + 8 <= nbins; k += 8) {
+		__m256 a = _mm256_loadu_ps(in + 2*k);
+		__m256 b = _mm256_loadu_ps(in + 2*k + 8);
+		a = _mm256_mul_ps(a, a);
+		b = _mm256_mul_ps(b, b);
+		//per 128 bit lane: re^2 + im^2 of bins 0 1 4 5 | 2 3 6 7, then put them back in order
+		__m256 p = _mm256_add_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)),
+					 _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		p = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(p), _MM_SHUFFLE(3, 1, 2, 0)));
+		if (sq) {
+			p = _mm256_sqrt_ps(p);
+		}
+		_mm256_storeu_ps(acc + k, _mm256_add_ps(_mm256_loadu_ps(acc + k), p));
+	}
+#elif defined(__SSE2__)
+	for (; k + 4 <= nbins; k += 4) {
+		__m128 a = _mm_loadu_ps(in + 2*k);
+		__m128 b = _mm_loadu_ps(in + 2*k + 4);
+		a = _mm_mul_ps(a, a);
+		b = _mm_mul_ps(b, b);
+		__m128 p = _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)),
+				      _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		if (sq) {
+			p = _mm_sqrt_ps(p);
+		}
+		_mm_storeu_ps(acc + k, _mm_add_ps(_mm_loadu_ps(acc + k), p));
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	for (; k + 4 <= nbins; k += 4) {
+		float32x4x2_t c = vld2q_f32(in + 2*k);
+		float32x4_t p = vmlaq_f32(vmulq_f32(c.val[0], c.val[0]), c.val[1], c.val[1]);
+		if (sq) {
+			p = vsqrtq_f32(p);
+		}
+		vst1q_f32(acc + k, vaddq_f32(vld1q_f32(acc + k), p));
+	}
+#endif
+	for (; k < nbins; k++) {
+		float p = bins[k].r*bins[k].r + bins[k].i*bins[k].i;
+		acc[k] += sq ? sqrtf(p) : p;
+	}
+}
+
+#define ACCUMULATE_FIXED(n) \
+	case n: \
+		if (sq) { \
+			accumulate(bins, acc, n, 1); \
+		} \
+		else { \
+			accumulate(bins, acc, n, 0); \
+		} \
+		break;
+
+void spectrum_accumulate(const kiss_fft_cpx *bins, float *acc, int nbins, enum spectrum_mode mode) {
+	int sq = mode == SPECTRUM_MAGNITUDE;
+
+	//BUF_SIZE, 4096 and 2048 point FFTs
+	switch (nbins) {
+	ACCUMULATE_FIXED(2001)
+	ACCUMULATE_FIXED(2049)
+	ACCUMULATE_FIXED(1025)
+	default:
+		accumulate(bins, acc, nbins, sq);
+		break;
+	}
+}
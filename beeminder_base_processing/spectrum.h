@@ -0,0 +1,19 @@
+//accumulation of FFT output into the summed spectrum.
+//each frame's bins are turned into magnitude or power and added to acc.
+
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include "kiss_fft.h"
+
+enum spectrum_mode {
+	SPECTRUM_MAGNITUDE,	//sqrt(r*r + i*i), what the reports have always carried
+	SPECTRUM_POWER,		//r*r + i*i, skips the square root
+};
+
+//acc[k] += |bins[k]| (or |bins[k]|^2) for k in [0, nbins)
+void spectrum_accumulate(const kiss_fft_cpx *bins, float *acc, int nbins, enum spectrum_mode mode);
+
+const char *spectrum_mode_name(enum spectrum_mode mode);
+
+#endif
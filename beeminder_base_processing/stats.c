@@ -0,0 +1,64 @@
+//--stats bookkeeping and output.
+
+#include <string.h>
+#include <errno.h>
+#include <sys/resource.h>
+
+#include "stats.h"
+
+static const char *stage_names[STAT_NSTAGES] = {
+	"read_us", "window_us", "fft_us", "magnitude_us", "compare_us", "serialize_us",
+};
+
+void stats_begin(struct hive_stats *s) {
+	memset(s, 0, sizeof(*s));
+	s->start = stats_now();
+}
+
+void stats_end(struct hive_stats *s) {
+	s->total_ns = stats_now() - s->start;
+}
+
+void stats_merge(struct hive_stats *s, const struct hive_stats *from) {
+	for (int i = 0; i < STAT_NSTAGES; i++) {
+		s->ns[i] += from->ns[i];
+	}
+	s->frames += from->frames;
+}
+
+int stats_json(struct report_buf *out, const struct hive_stats *s, const char *file) {
+	struct rusage ru;
+	int err = 0;
+
+	report_buf_reset(out);
+	err |= report_raw(out, "{\"stats\":{");
+	if (file) {
+		err |= report_raw(out, "\"file\":");
+		err |= report_string(out, file);
+		err |= report_raw(out, ",");
+	}
+	err |= report_raw(out, "\"frames\":");
+	err |= report_int(out, s->frames);
+	err |= report_raw(out, ",\"bytes_read\":");
+	err |= report_int(out, s->bytes_read);
+	err |= report_raw(out, ",\"bytes_out\":");
+	err |= report_int(out, s->bytes_out);
+	//with threads the frame stages add up the time of every thread
+	for (int i = 0; i < STAT_NSTAGES; i++) {
+		err |= report_raw(out, ",\"");
+		err |= report_raw(out, stage_names[i]);
+		err |= report_raw(out, "\":");
+		err |= report_int(out, s->ns[i] / 1000);
+	}
+	err |= report_raw(out, ",\"scratch_bytes\":");
+	err |= report_int(out, s->scratch_bytes);
+	err |= report_raw(out, ",\"total_us\":");
+	err |= report_int(out, s->total_ns / 1000);
+	if (getrusage(RUSAGE_SELF, &ru) == 0) {
+		//kilobytes on linux
+		err |= report_raw(out, ",\"peak_rss_kb\":");
+		err |= report_int(out, ru.ru_maxrss);
+	}
+	err |= report_raw(out, "}}");
+	return err ? -ENOMEM : 0;
+}
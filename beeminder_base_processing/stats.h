@@ -0,0 +1,55 @@
+//optional per stage timings for hive_process --stats.
+//every counter is only touched through a struct hive_stats pointer that is NULL
+//when stats are off, so a disabled run pays one untaken branch per stage and
+//never reads the clock.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "report.h"
+
+enum stats_stage {
+	STAT_READ,		//header and samples in, mmap or fread
+	STAT_WINDOW,
+	STAT_FFT,		//kiss_fftr, or the Goertzel filters with --flags-only
+	STAT_MAGNITUDE,		//adding the frame into the summed spectrum
+	STAT_COMPARE,		//th_handle, audio_compare and the band summary
+	STAT_SERIALIZE,
+	STAT_NSTAGES,
+};
+
+struct hive_stats {
+	uint64_t ns[STAT_NSTAGES];
+	uint64_t start;		//stats_now() when the recording was started
+	uint64_t total_ns;
+	uint64_t frames;
+	uint64_t bytes_read;
+	uint64_t bytes_out;
+	uint64_t scratch_bytes;	//held by the plan's scratch arena
+};
+
+static inline uint64_t stats_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//t = STATS_START(s); ...work...; STATS_ADD(s, STAT_FFT, t);
+#define STATS_START(s) ((s) ? stats_now() : 0)
+#define STATS_ADD(s, stage, t0) do { if (s) (s)->ns[stage] += stats_now() - (t0); } while (0)
+
+//zeroes the counters and starts the clock for a new recording
+void stats_begin(struct hive_stats *s);
+//stops the clock for the recording
+void stats_end(struct hive_stats *s);
+//adds the frame counters of a worker thread into s
+void stats_merge(struct hive_stats *s, const struct hive_stats *from);
+
+//{"stats":{...}} for one recording, file may be NULL.  also reports the peak
+//resident size of the process.  returns 0 or -ENOMEM.
+int stats_json(struct report_buf *out, const struct hive_stats *s, const char *file);
+
+#endif
@@ -0,0 +1,103 @@
+//streaming STFT framing.
+//while nothing is buffered, whole frames are handed out straight from the caller's
+//memory (so a mapped recording is never copied); only the partial frame at the end
+//of each push goes through the ring.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "stft.h"
+
+int stft_init(struct stft *s, int frame_len, int hop, stft_frame_fn fn, void *ctx, void *mem) {
+	if (frame_len <= 0 || hop <= 0) {
+		return -EINVAL;
+	}
+	s->own_ring = !mem;
+	s->ring = mem ? mem : malloc(stft_mem_size(frame_len));
+	if (!s->ring) {
+		return -ENOMEM;
+	}
+	s->frame_len = frame_len;
+	s->hop = hop;
+	s->fn = fn;
+	s->ctx = ctx;
+	stft_reset(s);
+	return 0;
+}
+
+void stft_free(struct stft *s) {
+	if (s->own_ring) {
+		free(s->ring);
+	}
+	s->ring = NULL;
+}
+
+void stft_reset(struct stft *s) {
+	s->wr = 0;
+	s->fill = 0;
+	s->skip = 0;
+	s->frames = 0;
+}
+
+//drops hop samples from the front of the buffered frame
+static void stft_advance(struct stft *s) {
+	if (s->hop >= s->fill) {
+		s->skip = s->hop - s->fill;
+		s->fill = 0;
+	}
+	else {
+		s->fill -= s->hop;
+	}
+}
+
+void stft_push(struct stft *s, const int16_t *samples, size_t n) {
+	int len = s->frame_len;
+
+	while (n > 0) {
+		if (s->skip) {
+			size_t d = n < s->skip ? n : s->skip;
+			samples += d;
+			n -= d;
+			s->skip -= d;
+			continue;
+		}
+		if (s->fill == 0) {
+			//zero copy: frames that lie entirely inside this push
+			while (n >= (size_t)len) {
+				s->fn(s->ctx, samples);
+				s->frames++;
+				if ((size_t)s->hop > n) {
+					s->skip = s->hop - n;
+					n = 0;
+					break;
+				}
+				samples += s->hop;
+				n -= s->hop;
+			}
+			if (n == 0) {
+				break;
+			}
+		}
+		//buffer towards the next frame, never wrapping inside one memcpy
+		size_t c = len - s->fill;
+		if (c > (size_t)(len - s->wr)) {
+			c = len - s->wr;
+		}
+		if (c > n) {
+			c = n;
+		}
+		memcpy(s->ring + s->wr, samples, c * sizeof(int16_t));
+		memcpy(s->ring + s->wr + len, samples, c * sizeof(int16_t));
+		s->wr = (s->wr + c) % len;
+		s->fill += c;
+		samples += c;
+		n -= c;
+		if (s->fill == len) {
+			//full ring: the oldest sample is at wr and the mirror keeps the frame contiguous
+			s->fn(s->ctx, s->ring + s->wr);
+			s->frames++;
+			stft_advance(s);
+		}
+	}
+}
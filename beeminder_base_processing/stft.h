@@ -0,0 +1,40 @@
+//streaming short time fourier transform framing.
+//samples are pushed in whatever chunks they arrive in and every complete frame
+//is handed to a callback as soon as it exists.  each sample is consumed once and
+//memory is bounded by the frame size no matter how long the stream is.
+
+#ifndef STFT_H
+#define STFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//called once per frame with frame_len contiguous samples
+typedef void (*stft_frame_fn)(void *ctx, const int16_t *frame);
+
+struct stft {
+	int frame_len;
+	int hop;
+	//ring of frame_len samples stored twice so any frame is contiguous
+	int16_t *ring;
+	int wr;		//next write position in the ring
+	int fill;	//samples in the ring that belong to the next frame
+	size_t skip;	//samples still to drop when hop > frame_len
+	size_t frames;
+	stft_frame_fn fn;
+	void *ctx;
+	int own_ring;	//ring was allocated by stft_init
+};
+
+//bytes of ring memory a frame_len stft needs
+#define stft_mem_size(frame_len) (2 * (size_t)(frame_len) * sizeof(int16_t))
+
+//mem is stft_mem_size(frame_len) bytes the caller keeps alive until stft_free, or
+//NULL to have the ring malloc'd.  returns 0, -EINVAL for a bad frame/hop or -ENOMEM
+int stft_init(struct stft *s, int frame_len, int hop, stft_frame_fn fn, void *ctx, void *mem);
+void stft_free(struct stft *s);
+//forget any buffered samples so the next push starts a new stream
+void stft_reset(struct stft *s);
+void stft_push(struct stft *s, const int16_t *samples, size_t n);
+
+#endif
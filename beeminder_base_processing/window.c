@@ -0,0 +1,118 @@
+//window coefficient tables and the int16 -> windowed float kernel.
+//the kernel is picked at compile time from what the target supports
+//(AVX2, SSE2, or plain C), see ARCH_FLAGS in the Makefile.
+//the usual frame sizes get their own copy of it with the length fixed.
+
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "window.h"
+
+#define PI 3.141592653
+
+static const char *type_names[] = {
+	[WINDOW_HANN] = "hann",
+	[WINDOW_HAMMING] = "hamming",
+	[WINDOW_BLACKMAN] = "blackman",
+	[WINDOW_RECT] = "rect",
+};
+
+const char *window_type_name(enum window_type type) {
+	return type_names[type];
+}
+
+int window_type_parse(const char *name, enum window_type *type) {
+	for (int t = 0; t < (int)(sizeof(type_names) / sizeof(type_names[0])); t++) {
+		if (strcmp(name, type_names[t]) == 0) {
+			*type = t;
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
+int window_init(struct window *w, enum window_type type, int len) {
+	void *mem;
+	//32 byte aligned so the vector loads never split a cache line
+	if (posix_memalign(&mem, 32, len * sizeof(float))) {
+		return -ENOMEM;
+	}
+	w->coef = mem;
+	w->len = len;
+	for (int i = 0; i < len; i++) {
+		double x = 2*PI*i/(len - 1);
+		switch (type) {
+		case WINDOW_HANN:
+			w->coef[i] = 0.5*(1-cos(x));
+			break;
+		case WINDOW_HAMMING:
+			w->coef[i] = 0.54 - 0.46*cos(x);
+			break;
+		case WINDOW_BLACKMAN:
+			w->coef[i] = 0.42 - 0.5*cos(x) + 0.08*cos(2*x);
+			break;
+		case WINDOW_RECT:
+			w->coef[i] = 1;
+			break;
+		}
+	}
+	return 0;
+}
+
+void window_free(struct window *w) {
+	free(w->coef);
+	w->coef = NULL;
+	w->len = 0;
+}
+
+//always inlined so every caller below gets a copy built for its n
+static inline __attribute__((always_inline))
+void apply_s16(const float *coef, const int16_t *in, float *out, int n) {
+	int i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 16 <= n; i += 16) {
+		__m256i s = _mm256_loadu_si256((const __m256i *)(in + i));
+		__m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(s)));
+		__m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1)));
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(lo, _mm256_loadu_ps(coef + i)));
+		_mm256_storeu_ps(out + i + 8, _mm256_mul_ps(hi, _mm256_loadu_ps(coef + i + 8)));
+	}
+#elif defined(__SSE2__)
+	for (; i + 8 <= n; i += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(in + i));
+		//sign extend by unpacking into the high half and shifting back down
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+		_mm_storeu_ps(out + i, _mm_mul_ps(lo, _mm_loadu_ps(coef + i)));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(hi, _mm_loadu_ps(coef + i + 4)));
+	}
+#endif
+	for (; i < n; i++) {
+		out[i] = (float)in[i] * coef[i];
+	}
+}
+
+void window_apply_s16(const struct window *w, const int16_t *in, float *out) {
+	//with n a constant the vector loop is unrolled and the tail disappears
+	switch (w->len) {
+	case 4000:
+		apply_s16(w->coef, in, out, 4000);
+		break;
+	case 4096:
+		apply_s16(w->coef, in, out, 4096);
+		break;
+	case 2048:
+		apply_s16(w->coef, in, out, 2048);
+		break;
+	default:
+		apply_s16(w->coef, in, out, w->len);
+		break;
+	}
+}
@@ -0,0 +1,33 @@
+//window functions for the FFT frames.
+//coefficients are built once per frame size and reused for every frame,
+//the apply kernel converts the int16 samples and windows them in one pass.
+
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include <stdint.h>
+
+enum window_type {
+	WINDOW_HANN,
+	WINDOW_HAMMING,
+	WINDOW_BLACKMAN,
+	WINDOW_RECT,
+};
+
+struct window {
+	int len;
+	float *coef;
+};
+
+//builds a window of len points.  returns 0 or -ENOMEM.
+int window_init(struct window *w, enum window_type type, int len);
+void window_free(struct window *w);
+
+//out[i] = in[i] * coef[i] for the whole window
+void window_apply_s16(const struct window *w, const int16_t *in, float *out);
+
+//"hann", "hamming", "blackman" or "rect".  parse returns 0 or -EINVAL.
+const char *window_type_name(enum window_type type);
+int window_type_parse(const char *name, enum window_type *type);
+
+#endif
@@ -2,6 +2,75 @@ from pymongo import MongoClient
 import pprint
 import datetime
 import json
+import struct
+
+# binary reports from hive_process --format bin/bin16, laid out in
+# beeminder_base_processing/report_bin.h
+REPORT_MAGIC = b"HIVR"
+REPORT_VERSION = 1
+REPORT_POWER = 0x1
+REPORT_LOG_BANDS = 0x2
+REPORT_SECTION_SPECTRUM = 1
+REPORT_BAND_SECTIONS = {2: "edges", 3: "mean", 4: "peak", 5: "energy"}
+REPORT_SECTION_FEATURES = 6
+# features.h order, names and lengths as in the JSON report.  the per range
+# values are in AUDIO_* order: 4 day, 6 day, 9 day bee, queen, queen reference
+FEATURE_LAYOUT = (("centroid", 1), ("flatness", 1), ("noise_floor", 1),
+                  ("peak_hz", 5), ("peak", 5), ("level", 5), ("snr_db", 5),
+                  ("age_ratio", 3))
+FEATURE_COUNT = sum(n for _, n in FEATURE_LAYOUT)
+REPORT_DTYPES = {1: "f", 2: "e"}
+BEE_FLAG_NAMES = ("queen_present", "multiple_queen", "possible_mites",
+                  "three_day_in_range", "six_day_in_range", "nine_day_in_range")
+
+def decode_report(data):
+    """
+    Turns a binary report into the same object the JSON report holds.
+
+    bytes -> ReportDoc.sensor_data
+    """
+    if data[:4] != REPORT_MAGIC:
+        raise ValueError("not a hive report")
+    (version, header_len, temp, humidity, weight, _humidity_flag, _temp_flag,
+     bee_flags, flags, nsections) = struct.unpack_from("<HHIIIBB6sHH", data, 4)
+    if version != REPORT_VERSION:
+        raise ValueError("unsupported report version %d" % version)
+    report = {
+        "temp" : temp,
+        "humidity" : humidity,
+        "weight" : weight,
+        "bee_flags" : dict(zip(BEE_FLAG_NAMES, bytearray(bee_flags))),
+        "spectrum" : "power" if flags & REPORT_POWER else "magnitude",
+    }
+    bands = {}
+    offset = header_len
+    for _ in range(nsections):
+        (kind, dtype, size, count, scale, _step) = struct.unpack_from("<HBBIff", data, offset)
+        offset += 16
+        if dtype not in REPORT_DTYPES:
+            # a newer writer's dtype, skipped by its value size
+            if not size:
+                raise ValueError("unknown dtype %d without a size" % dtype)
+            offset += (count * size + 3) & ~3
+            continue
+        code = REPORT_DTYPES[dtype]
+        values = struct.unpack_from("<%d%s" % (count, code), data, offset)
+        offset += (count * struct.calcsize(code) + 3) & ~3
+        if kind == REPORT_SECTION_SPECTRUM:
+            report["fft_data"] = [v * scale for v in values]
+        elif kind in REPORT_BAND_SECTIONS:
+            bands[REPORT_BAND_SECTIONS[kind]] = [v * scale for v in values]
+        elif kind == REPORT_SECTION_FEATURES and count == FEATURE_COUNT:
+            # features from a different layout can't be named, they are left out
+            values = [v * scale for v in values]
+            features = {}
+            for name, n in FEATURE_LAYOUT:
+                features[name] = values[0] if n == 1 else values[:n]
+                values = values[n:]
+            report["features"] = features
+    if len(bands) == len(REPORT_BAND_SECTIONS):
+        report["bands"] = dict(scale="log" if flags & REPORT_LOG_BANDS else "mel", **bands)
+    return report
 
 class BeeMinder:
 
@@ -67,13 +136,15 @@ class BeeMinder:
     def get_data_from_file(self, path):
         """
         Reads from a json object from the file specified by path. and retuens the data object inside
+        Binary reports (hive_process --format bin) are decoded into the same object.
 
         Path -> ReportDoc.sensor_data
         """
-        sensor_data = None
-        with open(path, "r") as file:
-            sensor_data = json.load(file)
-        return sensor_data
+        with open(path, "rb") as file:
+            data = file.read()
+        if data[:4] == REPORT_MAGIC:
+            return decode_report(data)
+        return json.loads(data.decode("utf-8"))
 
     def add_report_from_file(self, hive_identifier, path):
         """
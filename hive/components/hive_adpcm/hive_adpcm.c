@@ -0,0 +1,165 @@
+//IMA-ADPCM blocks, see hive_adpcm.h.
+//the encoder works out each code with the decoder's own arithmetic, so both
+//ends follow the same predictor and nothing drifts over a recording.
+
+#include <string.h>
+#include <errno.h>
+
+#include "hive_adpcm.h"
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767,
+};
+
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+//one code into the state, returns the new sample
+static inline int decode_step(struct hive_adpcm_state *s, int code) {
+    int step = step_table[s->index];
+    int diff = step >> 3;
+    if (code & 4) {
+        diff += step;
+    }
+    if (code & 2) {
+        diff += step >> 1;
+    }
+    if (code & 1) {
+        diff += step >> 2;
+    }
+    int p = code & 8 ? s->predictor - diff : s->predictor + diff;
+    s->predictor = p < -32768 ? -32768 : p > 32767 ? 32767 : p;
+    int i = s->index + index_table[code];
+    s->index = i < 0 ? 0 : i > 88 ? 88 : i;
+    return s->predictor;
+}
+
+static inline int encode_step(struct hive_adpcm_state *s, int sample) {
+    int step = step_table[s->index];
+    int diff = sample - s->predictor;
+    int code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+    }
+    if (diff >= step >> 1) {
+        code |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= step >> 2) {
+        code |= 1;
+    }
+    decode_step(s, code);
+    return code;
+}
+
+void hive_adpcm_header_write(uint8_t *out, const struct hive_adpcm_header *h) {
+    memcpy(out, HIVE_ADPCM_MAGIC, 4);
+    out[4] = HIVE_ADPCM_VERSION;
+    out[5] = 0;
+    put_u16(out + 6, h->block_len);
+    put_u32(out + 8, h->nsamples);
+    put_u32(out + 12, h->sample_rate);
+}
+
+int hive_adpcm_header_read(const uint8_t *buf, size_t len, struct hive_adpcm_header *h) {
+    if (len < HIVE_ADPCM_HEADER_LEN || memcmp(buf, HIVE_ADPCM_MAGIC, 4) || buf[4] != HIVE_ADPCM_VERSION) {
+        return -EINVAL;
+    }
+    h->block_len = get_u16(buf + 6);
+    h->nsamples = get_u32(buf + 8);
+    h->sample_rate = get_u32(buf + 12);
+    if (h->block_len <= HIVE_ADPCM_BLOCK_HEADER_LEN) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+size_t hive_adpcm_stream_len(const struct hive_adpcm_header *h) {
+    size_t per_block = hive_adpcm_block_samples(h->block_len);
+    return (h->nsamples + per_block - 1) / per_block * h->block_len;
+}
+
+void hive_adpcm_encode_block(struct hive_adpcm_state *s, const int16_t *in, int n, uint8_t *out, int block_len) {
+    put_u16(out, (uint16_t)s->predictor);
+    out[2] = s->index;
+    out[3] = 0;
+    uint8_t *p = out + HIVE_ADPCM_BLOCK_HEADER_LEN;
+    int i = 0;
+    for (; i + 1 < n; i += 2) {
+        int lo = encode_step(s, in[i]);
+        int hi = encode_step(s, in[i + 1]);
+        *p++ = lo | hi << 4;
+    }
+    if (i < n) {
+        *p++ = encode_step(s, in[i]);
+    }
+    memset(p, 0, out + block_len - p);
+}
+
+void hive_adpcm_decode_block(const uint8_t *in, int block_len, int16_t *out, int n) {
+    struct hive_adpcm_state s = {
+        .predictor = (int16_t)get_u16(in),
+        .index = in[2] > 88 ? 88 : in[2],
+    };
+    const uint8_t *p = in + HIVE_ADPCM_BLOCK_HEADER_LEN;
+    int i = 0;
+    if (n > hive_adpcm_block_samples(block_len)) {
+        n = hive_adpcm_block_samples(block_len);
+    }
+    for (; i + 1 < n; i += 2, p++) {
+        out[i] = decode_step(&s, *p & 0xf);
+        out[i + 1] = decode_step(&s, *p >> 4);
+    }
+    if (i < n) {
+        out[i] = decode_step(&s, *p & 0xf);
+    }
+}
+
+int hive_adpcm_decode(const struct hive_adpcm_header *h, const uint8_t *blocks, size_t len, int16_t *out) {
+    int per_block = hive_adpcm_block_samples(h->block_len);
+    uint32_t left = h->nsamples;
+
+    if (len < hive_adpcm_stream_len(h)) {
+        return -EINVAL;
+    }
+    for (; left > 0; blocks += h->block_len) {
+        int n = left < (uint32_t)per_block ? (int)left : per_block;
+        hive_adpcm_decode_block(blocks, h->block_len, out, n);
+        out += n;
+        left -= n;
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+//IMA-ADPCM for the raw audio uploads, 4 bits a sample instead of 16.
+//the audio goes as a stream header followed by fixed size blocks.  every block
+//starts with the coder state, so each one decodes on its own and a block is one
+//BLE write.  the base station's hive_process decodes with this same file.
+//
+//stream header, little endian:
+//   0  "HVAD"
+//   4  u8 version, u8 reserved (0), u16 block_len
+//   8  u32 nsamples, u32 sample_rate
+//block of block_len bytes:
+//   0  i16 predictor, u8 step index, u8 reserved (0)
+//   4  two samples a byte, the first in the low nibble
+//the last block is padded out to block_len.
+
+#ifndef HIVE_ADPCM_H
+#define HIVE_ADPCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HIVE_ADPCM_MAGIC "HVAD"
+#define HIVE_ADPCM_VERSION 1
+//not 12 so the base station never takes it for the sensor data
+#define HIVE_ADPCM_HEADER_LEN 16
+#define HIVE_ADPCM_BLOCK_HEADER_LEN 4
+//the nodes' BLE write size
+#define HIVE_ADPCM_BLOCK_LEN 496
+
+//samples in a block of block_len bytes, 984 for HIVE_ADPCM_BLOCK_LEN
+#define hive_adpcm_block_samples(block_len) (((int)(block_len) - HIVE_ADPCM_BLOCK_HEADER_LEN) * 2)
+
+struct hive_adpcm_header {
+    int block_len;
+    uint32_t nsamples;
+    uint32_t sample_rate;
+};
+
+//coder state carried from block to block
+struct hive_adpcm_state {
+    int predictor;
+    int index;
+};
+
+void hive_adpcm_header_write(uint8_t *out, const struct hive_adpcm_header *h);
+//returns 0 or -EINVAL if buf doesn't start with a header this version can read
+int hive_adpcm_header_read(const uint8_t *buf, size_t len, struct hive_adpcm_header *h);
+//bytes of blocks the header's samples take
+size_t hive_adpcm_stream_len(const struct hive_adpcm_header *h);
+
+//n samples, at most hive_adpcm_block_samples(block_len), into one block
+void hive_adpcm_encode_block(struct hive_adpcm_state *s, const int16_t *in, int n, uint8_t *out, int block_len);
+//the first n samples of a block, no more than the block holds
+void hive_adpcm_decode_block(const uint8_t *in, int block_len, int16_t *out, int n);
+//every sample of a stream's blocks, the header's nsamples of them.
+//returns 0 or -EINVAL if len is short.
+int hive_adpcm_decode(const struct hive_adpcm_header *h, const uint8_t *blocks, size_t len, int16_t *out);
+
+#endif
@@ -0,0 +1,82 @@
+//range and band bins, see hive_bins.h.
+
+#include <math.h>
+
+#include "hive_bins.h"
+
+int hive_freq_bin(float freq, int sample_rate, int nfft) {
+    float bin_hz = (float)sample_rate / nfft;
+    int bin = freq / bin_hz;
+    return bin > nfft / 2 ? nfft / 2 : bin;
+}
+
+void hive_freq_range(float freq, float search_hz, int sample_rate, int nfft, int *first, int *last) {
+    int bin = hive_freq_bin(freq, sample_rate, nfft);
+    int w = search_hz * nfft / sample_rate;
+
+    *first = bin > w ? bin - w : 0;
+    *last = (bin + w < nfft / 2 ? bin + w : nfft / 2) + 1;
+}
+
+static double hz_to_mel(double hz) {
+    return 2595 * log10(1 + hz / 700);
+}
+
+static double mel_to_hz(double mel) {
+    return 700 * (pow(10, mel / 2595) - 1);
+}
+
+void hive_band_edges(float *edge, int nbands, float fmin, float fmax, int log_scale) {
+    double lo = log_scale ? log(fmin) : hz_to_mel(fmin);
+    double hi = log_scale ? log(fmax) : hz_to_mel(fmax);
+
+    for (int i = 0; i <= nbands; i++) {
+        double x = lo + (hi - lo) * i / nbands;
+        edge[i] = log_scale ? exp(x) : mel_to_hz(x);
+    }
+    edge[0] = fmin;
+    edge[nbands] = fmax;
+}
+
+void hive_band_bins(const float *edge, int nbands, float bin_hz, int nbins, int *first, int *last) {
+    for (int i = 0; i < nbands; i++) {
+        int f = ceilf(edge[i] / bin_hz);
+        int l = ceilf(edge[i + 1] / bin_hz);
+        if (i == nbands - 1) {
+            //the top edge is inclusive so fmax itself is counted
+            l = floorf(edge[nbands] / bin_hz) + 1;
+        }
+        //low bands can be narrower than a bin, they get the bin nearest their centre
+        if (l <= f) {
+            f = lrintf((edge[i] + edge[i + 1]) / 2 / bin_hz);
+            l = f + 1;
+        }
+        if (l > nbins) {
+            l = nbins;
+        }
+        if (f >= l) {
+            f = l - 1;
+        }
+        first[i] = f;
+        last[i] = l;
+    }
+}
+
+void hive_band_summarise(const int *first, const int *last, int nbands, const float *spectrum, int power,
+                         float *mean, float *peak, float *energy) {
+    for (int i = 0; i < nbands; i++) {
+        const float *v = spectrum + first[i];
+        int n = last[i] - first[i];
+        float sum = 0, max = v[0], e = 0;
+        for (int k = 0; k < n; k++) {
+            sum += v[k];
+            if (v[k] > max) {
+                max = v[k];
+            }
+            e += power ? v[k] : v[k] * v[k];
+        }
+        mean[i] = sum / n;
+        peak[i] = max;
+        energy[i] = e;
+    }
+}
@@ -0,0 +1,285 @@
+//node side spectrum, see hive_dsp.h.
+//the FFT is the one the base station's radix2 backend runs (hive_fft.h).  the
+//window is applied while the frame is packed into its points, so a frame is read
+//once and there is no separate float copy of it.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "hive_dsp.h"
+#include "hive_bins.h"
+#include "hive_f16.h"
+
+#define PI 3.14159265358979323846
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_f32(uint8_t *p, float v) {
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    p[0] = u;
+    p[1] = u >> 8;
+    p[2] = u >> 16;
+    p[3] = u >> 24;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static float get_f32(const uint8_t *p) {
+    uint32_t u = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+    float v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+static int bands_init(struct hive_dsp *d, float bin_hz, int nbins) {
+    const struct hive_dsp_config *cfg = &d->cfg;
+    int nbands = cfg->nbands;
+    float top = (nbins - 1) * bin_hz;
+    float fmax = cfg->fmax <= 0 || cfg->fmax > top ? top : cfg->fmax;
+
+    if (nbands <= 0 || nbands > HIVE_DSP_MAX_BANDS || cfg->fmin < 0 || cfg->fmin >= fmax) {
+        return -EINVAL;
+    }
+    d->cfg.fmax = fmax;
+    hive_band_edges(d->edge, nbands, cfg->fmin, fmax, 0);
+    hive_band_bins(d->edge, nbands, bin_hz, nbins, d->band_first, d->band_last);
+    return 0;
+}
+
+static int ranges_init(struct hive_dsp *d) {
+    const struct hive_dsp_config *cfg = &d->cfg;
+
+    if (cfg->nranges < 0 || cfg->nranges > HIVE_DSP_MAX_RANGES || cfg->search_hz < 0) {
+        return -EINVAL;
+    }
+    for (int i = 0; i < cfg->nranges; i++) {
+        int last;
+        hive_freq_range(cfg->freq[i], cfg->search_hz, cfg->sample_rate, cfg->nfft, &d->range_first[i], &last);
+        d->range_count[i] = last - d->range_first[i];
+    }
+    return 0;
+}
+
+int hive_dsp_init(struct hive_dsp *d, const struct hive_dsp_config *cfg) {
+    int nfft = cfg->nfft;
+
+    memset(d, 0, sizeof(*d));
+    d->cfg = *cfg;
+    if (nfft < 4 || nfft > UINT16_MAX || (nfft & (nfft - 1)) || cfg->frame_len < 2 || cfg->frame_len > nfft ||
+        cfg->sample_rate <= 0 || cfg->sample_rate > UINT16_MAX) {
+        return -EINVAL;
+    }
+    int err = ranges_init(d);
+    if (err || (err = bands_init(d, (float)cfg->sample_rate / nfft, nfft / 2 + 1))) {
+        return err;
+    }
+
+    if ((err = hive_fft_init(&d->fft, nfft))) {
+        return err;
+    }
+
+    int half = nfft / 2;
+    d->half = half;
+    d->window = malloc(cfg->frame_len * sizeof(float));
+    d->work = malloc(2 * half * sizeof(float));
+    d->spectrum = malloc((half + 1) * sizeof(float));
+    d->frame = malloc(cfg->frame_len * sizeof(int16_t));
+    if (!d->window || !d->work || !d->spectrum || !d->frame) {
+        hive_dsp_free(d);
+        return -ENOMEM;
+    }
+    for (int i = 0; i < cfg->frame_len; i++) {
+        d->window[i] = 0.5 * (1 - cos(2 * PI * i / (cfg->frame_len - 1)));
+    }
+    hive_dsp_reset(d);
+    return 0;
+}
+
+void hive_dsp_free(struct hive_dsp *d) {
+    hive_fft_free(&d->fft);
+    free(d->window);
+    free(d->work);
+    free(d->spectrum);
+    free(d->frame);
+    d->window = NULL;
+    d->work = NULL;
+    d->spectrum = NULL;
+    d->frame = NULL;
+}
+
+void hive_dsp_reset(struct hive_dsp *d) {
+    memset(d->spectrum, 0, (d->half + 1) * sizeof(float));
+    d->fill = 0;
+    d->frames = 0;
+}
+
+//windowed sample n of the frame, 0 in the zero padding
+static inline float sample(const struct hive_dsp *d, const int16_t *frame, int n) {
+    return n < d->cfg.frame_len ? frame[n] * d->window[n] : 0;
+}
+
+static void add_frame(struct hive_dsp *d, const int16_t *frame) {
+    int half = d->half;
+    float *z = d->work;
+    float *acc = d->spectrum;
+
+    for (int i = 0; i < half; i++) {
+        int j = d->fft.bitrev[i];
+        z[2 * i] = sample(d, frame, 2 * j);
+        z[2 * i + 1] = sample(d, frame, 2 * j + 1);
+    }
+    hive_fft_real(&d->fft, z);
+
+    //bins 0 and half are real, they come first
+    acc[0] += fabsf(z[0]);
+    acc[half] += fabsf(z[1]);
+    for (int k = 1; k < half; k++) {
+        acc[k] += sqrtf(z[2 * k] * z[2 * k] + z[2 * k + 1] * z[2 * k + 1]);
+    }
+    d->frames++;
+}
+
+void hive_dsp_push(struct hive_dsp *d, const int16_t *samples, size_t n) {
+    int frame_len = d->cfg.frame_len;
+
+    while (n > 0) {
+        size_t take = frame_len - d->fill;
+        if (take > n) {
+            take = n;
+        }
+        memcpy(d->frame + d->fill, samples, take * sizeof(int16_t));
+        d->fill += take;
+        samples += take;
+        n -= take;
+        if (d->fill == frame_len) {
+            add_frame(d, d->frame);
+            d->fill = 0;
+        }
+    }
+}
+
+static int range_bins(const struct hive_dsp *d) {
+    int n = 0;
+    for (int i = 0; i < d->cfg.nranges; i++) {
+        n += d->range_count[i];
+    }
+    return n;
+}
+
+size_t hive_dsp_packet_len(const struct hive_dsp *d) {
+    return HIVE_SPECTRUM_HEADER_LEN + 4 * d->cfg.nranges + 4 * range_bins(d) + 3 * 2 * d->cfg.nbands;
+}
+
+int hive_dsp_packet(const struct hive_dsp *d, uint8_t *out, size_t cap) {
+    const struct hive_dsp_config *cfg = &d->cfg;
+    size_t len = hive_dsp_packet_len(d);
+    int nbands = cfg->nbands;
+    float mean[HIVE_DSP_MAX_BANDS], peak[HIVE_DSP_MAX_BANDS], energy[HIVE_DSP_MAX_BANDS];
+
+    if (len > cap) {
+        return -ENOSPC;
+    }
+    memcpy(out, HIVE_SPECTRUM_MAGIC, 4);
+    out[4] = HIVE_SPECTRUM_VERSION;
+    out[5] = cfg->nranges;
+    out[6] = nbands;
+    out[7] = 0;
+    put_u16(out + 8, cfg->sample_rate);
+    put_u16(out + 10, cfg->frame_len);
+    put_u16(out + 12, cfg->nfft);
+    put_u16(out + 14, d->frames > UINT16_MAX ? UINT16_MAX : d->frames);
+    put_f32(out + 16, cfg->fmin);
+    put_f32(out + 20, cfg->fmax);
+
+    hive_band_summarise(d->band_first, d->band_last, nbands, d->spectrum, 0, mean, peak, energy);
+    //the peaks are never below the means, so one scale does for both
+    float band_scale = hive_f16_scale(peak, nbands);
+    float energy_scale = hive_f16_scale(energy, nbands);
+    put_f32(out + 24, band_scale);
+    put_f32(out + 28, energy_scale);
+
+    uint8_t *p = out + HIVE_SPECTRUM_HEADER_LEN;
+    for (int i = 0; i < cfg->nranges; i++, p += 4) {
+        put_u16(p, d->range_first[i]);
+        put_u16(p + 2, d->range_count[i]);
+    }
+    for (int i = 0; i < cfg->nranges; i++) {
+        for (int k = 0; k < d->range_count[i]; k++, p += 4) {
+            put_f32(p, d->spectrum[d->range_first[i] + k]);
+        }
+    }
+    for (int i = 0; i < nbands; i++) {
+        put_u16(p + 2 * i, hive_f32_to_f16(mean[i] / band_scale));
+        put_u16(p + 2 * (nbands + i), hive_f32_to_f16(peak[i] / band_scale));
+        put_u16(p + 2 * (2 * nbands + i), hive_f32_to_f16(energy[i] / energy_scale));
+    }
+    return len;
+}
+
+int hive_spectrum_read(const uint8_t *buf, size_t len, struct hive_spectrum *s) {
+    if (len < HIVE_SPECTRUM_HEADER_LEN || memcmp(buf, HIVE_SPECTRUM_MAGIC, 4)) {
+        return -EINVAL;
+    }
+    s->version = buf[4];
+    s->nranges = buf[5];
+    s->nbands = buf[6];
+    s->sample_rate = get_u16(buf + 8);
+    s->frame_len = get_u16(buf + 10);
+    s->nfft = get_u16(buf + 12);
+    s->frames = get_u16(buf + 14);
+    s->fmin = get_f32(buf + 16);
+    s->fmax = get_f32(buf + 20);
+    s->band_scale = get_f32(buf + 24);
+    s->energy_scale = get_f32(buf + 28);
+    if (s->version != HIVE_SPECTRUM_VERSION || s->nranges > HIVE_DSP_MAX_RANGES || s->nbands == 0 ||
+        s->nbands > HIVE_DSP_MAX_BANDS || s->sample_rate == 0 || s->nfft < 4 || (s->nfft & (s->nfft - 1)) ||
+        !(s->fmin >= 0) || !(s->fmin < s->fmax) || len < HIVE_SPECTRUM_HEADER_LEN + 4 * (size_t)s->nranges) {
+        return -EINVAL;
+    }
+
+    const uint8_t *p = buf + HIVE_SPECTRUM_HEADER_LEN;
+    size_t nvalues = 0;
+    for (int i = 0; i < s->nranges; i++, p += 4) {
+        s->range_first[i] = get_u16(p);
+        s->range_count[i] = get_u16(p + 2);
+        if (s->range_first[i] + s->range_count[i] > s->nfft / 2 + 1) {
+            return -EINVAL;
+        }
+        nvalues += s->range_count[i];
+    }
+    s->range_values = p;
+    s->band_values = p + 4 * nvalues;
+    if (len != (size_t)(s->band_values - buf) + 3 * 2 * (size_t)s->nbands) {
+        return -EINVAL;
+    }
+    hive_band_edges(s->edge, s->nbands, s->fmin, s->fmax, 0);
+    return 0;
+}
+
+void hive_spectrum_range(const struct hive_spectrum *s, int r, float *out) {
+    const uint8_t *p = s->range_values;
+    for (int i = 0; i < r; i++) {
+        p += 4 * s->range_count[i];
+    }
+    for (int k = 0; k < s->range_count[r]; k++) {
+        out[k] = get_f32(p + 4 * k);
+    }
+}
+
+void hive_spectrum_bands(const struct hive_spectrum *s, float *mean, float *peak, float *energy) {
+    const uint8_t *p = s->band_values;
+    int n = s->nbands;
+    for (int i = 0; i < n; i++) {
+        mean[i] = hive_f16_to_f32(get_u16(p + 2 * i)) * s->band_scale;
+        peak[i] = hive_f16_to_f32(get_u16(p + 2 * (n + i))) * s->band_scale;
+        energy[i] = hive_f16_to_f32(get_u16(p + 2 * (2 * n + i))) * s->energy_scale;
+    }
+}
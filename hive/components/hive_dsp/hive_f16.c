@@ -0,0 +1,87 @@
+//half precision conversions, see hive_f16.h.
+
+#include <string.h>
+#include <math.h>
+
+#include "hive_f16.h"
+
+uint16_t hive_f32_to_f16(float v) {
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    uint16_t sign = (u >> 16) & 0x8000;
+    int exp = (u >> 23) & 0xff;
+    uint32_t man = u & 0x7fffff;
+
+    if (exp == 0xff) {
+        //keep NaNs NaN
+        return sign | 0x7c00 | (man ? 0x200 : 0);
+    }
+    exp -= 127 - 15;
+    if (exp >= 0x1f) {
+        return sign | 0x7c00;
+    }
+    if (exp <= 0) {
+        //subnormal half (or zero): shift the mantissa, with its implicit bit, into place
+        if (exp < -10) {
+            return sign;
+        }
+        man |= 0x800000;
+        int shift = 14 - exp;
+        uint32_t half = man >> shift;
+        uint32_t rest = man & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rest > mid || (rest == mid && (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+    uint32_t half = (uint32_t)exp << 10 | man >> 13;
+    uint32_t rest = man & 0x1fff;
+    //a carry out of the mantissa bumps the exponent, up to infinity if need be
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return sign | half;
+}
+
+float hive_f16_to_f32(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    int exp = (h >> 10) & 0x1f;
+    uint32_t man = h & 0x3ff;
+    uint32_t u;
+
+    if (exp == 0x1f) {
+        u = sign | 0x7f800000 | man << 13;
+    } else if (exp) {
+        u = sign | (uint32_t)(exp + 127 - 15) << 23 | man << 13;
+    } else if (man) {
+        //subnormal, normalise it
+        exp = 127 - 15 + 1;
+        while (!(man & 0x400)) {
+            man <<= 1;
+            exp--;
+        }
+        u = sign | (uint32_t)exp << 23 | (man & 0x3ff) << 13;
+    } else {
+        u = sign;
+    }
+    float v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+float hive_f16_scale(const float *v, size_t n) {
+    float max = 0;
+    for (size_t i = 0; i < n; i++) {
+        float a = fabsf(v[i]);
+        if (isfinite(a) && a > max) {
+            max = a;
+        }
+    }
+    if (max == 0) {
+        return 1;
+    }
+    int e;
+    frexpf(max / 65504.0f, &e);
+    return ldexpf(1, e);
+}
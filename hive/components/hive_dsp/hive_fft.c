@@ -0,0 +1,103 @@
+//radix-2 real FFT, see hive_fft.h.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "hive_fft.h"
+
+#define PI 3.14159265358979323846
+
+int hive_fft_init(struct hive_fft *f, int n) {
+    int half = n / 2;
+
+    memset(f, 0, sizeof(*f));
+    if (n < 4 || n > HIVE_FFT_MAX_SIZE || (n & (n - 1))) {
+        return -EINVAL;
+    }
+    f->n = n;
+    f->half = half;
+    f->bitrev = malloc(half * sizeof(uint16_t));
+    f->tw = malloc(2 * (half / 2 + 1) * sizeof(float));
+    f->split = malloc(2 * (half / 2 + 1) * sizeof(float));
+    if (!f->bitrev || !f->tw || !f->split) {
+        hive_fft_free(f);
+        return -ENOMEM;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < half) {
+        bits++;
+    }
+    for (int i = 0; i < half; i++) {
+        int rev = 0;
+        for (int b = 0; b < bits; b++) {
+            rev |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        f->bitrev[i] = rev;
+    }
+    //tabled in double so the twiddles are as exact as a float can hold
+    for (int k = 0; k <= half / 2; k++) {
+        f->tw[2 * k] = cos(2 * PI * k / half);
+        f->tw[2 * k + 1] = -sin(2 * PI * k / half);
+        f->split[2 * k] = cos(2 * PI * k / n);
+        f->split[2 * k + 1] = -sin(2 * PI * k / n);
+    }
+    return 0;
+}
+
+void hive_fft_free(struct hive_fft *f) {
+    free(f->bitrev);
+    free(f->tw);
+    free(f->split);
+    f->bitrev = NULL;
+    f->tw = NULL;
+    f->split = NULL;
+}
+
+void hive_fft_real(const struct hive_fft *f, float *z) {
+    int half = f->half;
+
+    //decimation in time, the points are already in bit reversed order
+    for (int len = 2; len <= half; len <<= 1) {
+        int m = len / 2;
+        int step = half / len;
+        for (int start = 0; start < half; start += len) {
+            float *a = z + 2 * start;
+            float *b = z + 2 * (start + m);
+            for (int j = 0; j < m; j++) {
+                float wr = f->tw[2 * j * step], wi = f->tw[2 * j * step + 1];
+                float tr = b[2 * j] * wr - b[2 * j + 1] * wi;
+                float ti = b[2 * j] * wi + b[2 * j + 1] * wr;
+                b[2 * j] = a[2 * j] - tr;
+                b[2 * j + 1] = a[2 * j + 1] - ti;
+                a[2 * j] += tr;
+                a[2 * j + 1] += ti;
+            }
+        }
+    }
+
+    //X[k] = E[k] + W^k O[k] with E and O the transforms of the even and odd samples,
+    //both recovered from Z[k] and conj(Z[half-k]).  k and half-k are done together.
+    float dc = z[0] + z[1];
+    float nyquist = z[0] - z[1];
+    z[0] = dc;
+    z[1] = nyquist;
+    for (int k = 1; k <= half / 2; k++) {
+        float *zk = z + 2 * k, *zn = z + 2 * (half - k);
+        float er = 0.5f * (zk[0] + zn[0]);
+        float ei = 0.5f * (zk[1] - zn[1]);
+        float or_ = 0.5f * (zk[1] + zn[1]);
+        float oi = -0.5f * (zk[0] - zn[0]);
+        float wr = f->split[2 * k], wi = f->split[2 * k + 1];
+        float tr = or_ * wr - oi * wi;
+        float ti = or_ * wi + oi * wr;
+        zk[0] = er + tr;
+        zk[1] = ei + ti;
+        //X[half-k] = conj(E[k]) - conj(W^k O[k]), as W^(half-k) = -conj(W^k).
+        //k = half/2 is its own mirror and ends up with this one.
+        zn[0] = er - tr;
+        zn[1] = -ei + ti;
+    }
+}
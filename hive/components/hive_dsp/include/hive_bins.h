@@ -0,0 +1,34 @@
+//which bins of a spectrum the flags and the band summary are made of.  the nodes
+//(hive_dsp.c) and the base station (analysis.c, bands.c) both work them out here,
+//so the bins a node sends are the ones hive_process looks at.
+
+#ifndef HIVE_BINS_H
+#define HIVE_BINS_H
+
+//the frequencies the base station's flags come from, the queen is also compared
+//against the octave above her
+#define HIVE_FREQ_4DAY_BEE 285
+#define HIVE_FREQ_6DAY_BEE 225
+#define HIVE_FREQ_9DAY_BEE 190
+#define HIVE_FREQ_QUEEN 400
+//how far from each frequency its peak is looked for, bee tones drift with
+//temperature and the age estimates are only rough
+#define HIVE_PEAK_SEARCH_HZ 8
+
+//bin of freq in an nfft point spectrum, the top one for a frequency above nyquist
+int hive_freq_bin(float freq, int sample_rate, int nfft);
+//bins first .. last-1 are the ones within search_hz of freq's
+void hive_freq_range(float freq, float search_hz, int sample_rate, int nfft, int *first, int *last);
+
+//nbands+1 band edges from fmin to fmax in Hz, spaced evenly in mel or, with
+//log_scale set, in log frequency
+void hive_band_edges(float *edge, int nbands, float fmin, float fmax, int log_scale);
+//bins first[i] .. last[i]-1 of a spectrum of nbins bins bin_hz apart make up band
+//i, never empty.  the top edge is inclusive.
+void hive_band_bins(const float *edge, int nbands, float bin_hz, int nbins, int *first, int *last);
+//per band mean and peak of the spectrum values and energy, the sum of the squared
+//magnitudes.  with power set the spectrum already holds squared magnitudes.
+void hive_band_summarise(const int *first, const int *last, int nbands, const float *spectrum, int power,
+                         float *mean, float *peak, float *energy);
+
+#endif
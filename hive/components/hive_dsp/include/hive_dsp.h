@@ -0,0 +1,132 @@
+//spectrum of a recording worked out on the node, so a few hundred bytes go over
+//BLE instead of the raw audio.
+//frames go through the same steps as in hive_process on the base station: hann
+//window, zero padding to a power of two, real FFT and summed magnitudes.  what
+//is kept is every bin near the frequencies the base station checks and a mel
+//band summary of the rest, packed into a spectrum packet (layout below) that
+//hive_process reads in place of the audio.
+//doubles only build the tables in hive_dsp_init, the work per frame is float for
+//the ESP32's FPU.  bench_hive checks the packets against double precision
+//kissfft at HIVE_DSP_DEFAULTS, and hive/test/test_dsp.py against hive_process.
+
+#ifndef HIVE_DSP_H
+#define HIVE_DSP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "hive_fft.h"
+#include "hive_bins.h"
+
+#define HIVE_DSP_MAX_RANGES 8
+#define HIVE_DSP_MAX_BANDS 64
+
+//the frequencies audio_compare on the base station looks at (hive_bins.h), in its
+//order, the queen's octave last
+#define HIVE_DSP_FREQS {HIVE_FREQ_4DAY_BEE, HIVE_FREQ_6DAY_BEE, HIVE_FREQ_9DAY_BEE, HIVE_FREQ_QUEEN, \
+    2 * HIVE_FREQ_QUEEN}
+#define HIVE_DSP_NFREQS 5
+
+struct hive_dsp_config {
+    int sample_rate;
+    int frame_len;      //samples per frame, frames follow each other without overlap
+    int nfft;           //power of two, at least frame_len
+    //the bins within search_hz of each of these are sent as they are
+    int nranges;
+    float freq[HIVE_DSP_MAX_RANGES];
+    float search_hz;
+    //mel bands between fmin and fmax, fmax 0 for the top bin
+    int nbands;
+    float fmin;
+    float fmax;
+};
+
+//what the node records: 4000 sample frames at 22050Hz like the base station's
+//hive_config.json, padded to 4096 for the radix-2 FFT
+#define HIVE_DSP_DEFAULTS { \
+    .sample_rate = 22050, \
+    .frame_len = 4000, \
+    .nfft = 4096, \
+    .nranges = HIVE_DSP_NFREQS, \
+    .freq = HIVE_DSP_FREQS, \
+    .search_hz = HIVE_PEAK_SEARCH_HZ, \
+    .nbands = 32, \
+    .fmin = 0, \
+    .fmax = 0, \
+}
+
+//spectrum packet, all little endian:
+//   0  "HVSP"
+//   4  u8 version, u8 nranges, u8 nbands, u8 reserved (0)
+//   8  u16 sample_rate, u16 frame_len, u16 nfft, u16 frames
+//  16  f32 fmin, f32 fmax of the bands
+//  24  f32 band_scale, f32 energy_scale
+//  32  nranges x {u16 first bin, u16 count}
+//      f32 summed magnitude of every range bin, range after range
+//      nbands f16 mean, nbands f16 peak, nbands f16 energy
+//the range bins are float32 so the flags come out as they would from the audio.
+//band means and peaks are multiplied by band_scale and energies by energy_scale.
+#define HIVE_SPECTRUM_MAGIC "HVSP"
+#define HIVE_SPECTRUM_VERSION 1
+#define HIVE_SPECTRUM_HEADER_LEN 32
+//fits in one BLE write of the nodes' 496 bytes with the defaults
+#define HIVE_SPECTRUM_MAX_LEN 496
+
+struct hive_dsp {
+    struct hive_dsp_config cfg;
+    int half;
+    struct hive_fft fft;
+    float *window;      //frame_len coefficients
+    float *work;        //half complex points
+    float *spectrum;    //nfft/2+1 summed magnitudes
+    int16_t *frame;     //samples of the frame being filled
+    int fill;
+    int frames;
+    int range_first[HIVE_DSP_MAX_RANGES];
+    int range_count[HIVE_DSP_MAX_RANGES];
+    int band_first[HIVE_DSP_MAX_BANDS];
+    int band_last[HIVE_DSP_MAX_BANDS];
+    float edge[HIVE_DSP_MAX_BANDS + 1];
+};
+
+//returns 0, -EINVAL for a config it can't do or -ENOMEM
+int hive_dsp_init(struct hive_dsp *d, const struct hive_dsp_config *cfg);
+void hive_dsp_free(struct hive_dsp *d);
+//starts a new recording
+void hive_dsp_reset(struct hive_dsp *d);
+//samples in any size chunks, each complete frame is added to the spectrum.
+//a partial frame at the end of a recording is left out, as on the base station.
+void hive_dsp_push(struct hive_dsp *d, const int16_t *samples, size_t n);
+//the spectrum so far as a packet.  returns its length or -ENOSPC.
+int hive_dsp_packet(const struct hive_dsp *d, uint8_t *out, size_t cap);
+//bytes hive_dsp_packet writes for this config
+size_t hive_dsp_packet_len(const struct hive_dsp *d);
+
+//a packet read back
+struct hive_spectrum {
+    int version;
+    int sample_rate;
+    int frame_len;
+    int nfft;
+    int frames;
+    int nranges;
+    int range_first[HIVE_DSP_MAX_RANGES];
+    int range_count[HIVE_DSP_MAX_RANGES];
+    const uint8_t *range_values;
+    int nbands;
+    float fmin;
+    float fmax;
+    float edge[HIVE_DSP_MAX_BANDS + 1];
+    float band_scale;
+    float energy_scale;
+    const uint8_t *band_values;
+};
+
+//buf must hold exactly one packet.  returns 0 or -EINVAL.
+int hive_spectrum_read(const uint8_t *buf, size_t len, struct hive_spectrum *s);
+//summed magnitudes of range r, range_count[r] of them
+void hive_spectrum_range(const struct hive_spectrum *s, int r, float *out);
+//nbands values each
+void hive_spectrum_bands(const struct hive_spectrum *s, float *mean, float *peak, float *energy);
+
+#endif
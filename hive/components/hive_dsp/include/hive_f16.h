@@ -0,0 +1,19 @@
+//IEEE half precision, for the band values of the nodes' spectrum packets
+//(hive_dsp.h) and the base station's float16 reports (report_bin.h).
+
+#ifndef HIVE_F16_H
+#define HIVE_F16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//round to nearest even
+uint16_t hive_f32_to_f16(float v);
+float hive_f16_to_f32(uint16_t h);
+
+//power of two that brings the largest finite magnitude of v just under the top of
+//the half range once divided by it, so big values don't overflow and small ones
+//don't go subnormal.  1 when they are all 0.
+float hive_f16_scale(const float *v, size_t n);
+
+#endif
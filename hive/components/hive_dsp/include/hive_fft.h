@@ -0,0 +1,33 @@
+//power of two real FFT, the nodes' (hive_dsp.c) and the base station's radix2
+//backend (fft_radix2.c), so both work a frame out the same way.
+//the n real samples are packed into n/2 complex ones (even samples real, odd
+//imaginary) in bit reversed order, put through an iterative radix-2 complex FFT
+//and split back into the n/2+1 bins of the real transform, all in place.  the
+//twiddles and the bit reversal are tabled when the state is made, so a transform
+//is just float loads, multiplies and adds.
+
+#ifndef HIVE_FFT_H
+#define HIVE_FFT_H
+
+#include <stdint.h>
+
+#define HIVE_FFT_MAX_SIZE 65536
+
+struct hive_fft {
+    int n;
+    int half;
+    uint16_t *bitrev;   //half entries
+    float *tw;          //half/2+1 complex exp(-2 pi i k / half)
+    float *split;       //half/2+1 complex exp(-2 pi i k / n)
+};
+
+//n a power of two from 4 to HIVE_FFT_MAX_SIZE.  returns 0, -EINVAL or -ENOMEM.
+int hive_fft_init(struct hive_fft *f, int n);
+void hive_fft_free(struct hive_fft *f);
+
+//z is half complex points, real and imaginary parts interleaved, point i being
+//samples 2*bitrev[i] and 2*bitrev[i]+1.  they are replaced by the transform: point
+//k is bin k for 0 < k < half, z[0] and z[1] are the real bins 0 and half.
+void hive_fft_real(const struct hive_fft *f, float *z);
+
+#endif
@@ -0,0 +1,154 @@
+//upload framing, see hive_frame.h.
+
+#include <string.h>
+#include <errno.h>
+
+#include "hive_frame.h"
+
+//a nibble at a time, the table is 64 bytes instead of 1k
+static const uint32_t crc_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint32_t hive_crc32(uint32_t crc, const void *data, size_t len) {
+    const uint8_t *p = data;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = crc >> 4 ^ crc_table[crc & 0xf];
+        crc = crc >> 4 ^ crc_table[crc & 0xf];
+    }
+    return ~crc;
+}
+
+size_t hive_frame_write(uint8_t *out, const struct hive_frame_header *h, const void *payload) {
+    memcpy(out, HIVE_FRAME_MAGIC, 2);
+    out[2] = HIVE_FRAME_VERSION;
+    out[3] = h->type;
+    put_u16(out + 4, h->seq);
+    put_u16(out + 6, h->len);
+    put_u32(out + 8, h->offset);
+    //payload may already be in place after the header
+    if (h->len && out + HIVE_FRAME_HEADER_LEN != payload) {
+        memmove(out + HIVE_FRAME_HEADER_LEN, payload, h->len);
+    }
+    uint32_t crc = hive_crc32(0, out, 12);
+    put_u32(out + 12, hive_crc32(crc, out + HIVE_FRAME_HEADER_LEN, h->len));
+    return HIVE_FRAME_HEADER_LEN + h->len;
+}
+
+int hive_frame_read(const uint8_t *buf, size_t len, struct hive_frame_header *h, const uint8_t **payload) {
+    if (len < HIVE_FRAME_HEADER_LEN || memcmp(buf, HIVE_FRAME_MAGIC, 2) || buf[2] != HIVE_FRAME_VERSION ||
+        get_u16(buf + 6) != len - HIVE_FRAME_HEADER_LEN) {
+        return -EINVAL;
+    }
+    uint32_t crc = hive_crc32(0, buf, 12);
+    if (hive_crc32(crc, buf + HIVE_FRAME_HEADER_LEN, len - HIVE_FRAME_HEADER_LEN) != get_u32(buf + 12)) {
+        return -EBADMSG;
+    }
+    h->type = buf[3];
+    h->seq = get_u16(buf + 4);
+    h->len = get_u16(buf + 6);
+    h->offset = get_u32(buf + 8);
+    *payload = buf + HIVE_FRAME_HEADER_LEN;
+    return 0;
+}
+
+static void send_frame(struct hive_upload *u, int type, uint32_t offset, const void *payload, uint16_t len) {
+    struct hive_frame_header h = {.type = type, .seq = u->seq++, .len = len, .offset = offset};
+    size_t n = hive_frame_write(u->frame, &h, payload);
+    u->frames++;
+    u->send(u->ctx, u->frame, n);
+}
+
+void hive_upload_begin(struct hive_upload *u, uint32_t id, uint32_t resume, hive_frame_send_fn send, void *ctx) {
+    uint8_t payload[4];
+    u->id = id;
+    u->pos = 0;
+    u->resume = resume;
+    u->crc = 0;
+    u->frames = 0;
+    u->fill = 0;
+    u->stopped = 0;
+    u->send = send;
+    u->ctx = ctx;
+    put_u32(payload, id);
+    send_frame(u, HIVE_FRAME_START, 0, payload, sizeof(payload));
+}
+
+static void flush(struct hive_upload *u) {
+    if (u->fill > 0) {
+        send_frame(u, HIVE_FRAME_DATA, u->pos - u->fill, u->frame + HIVE_FRAME_HEADER_LEN, u->fill);
+        u->fill = 0;
+    }
+}
+
+void hive_upload_write(struct hive_upload *u, const void *data, size_t len) {
+    const uint8_t *p = data;
+    if (u->stopped) {
+        return;
+    }
+    u->crc = hive_crc32(u->crc, p, len);
+    //what the base station already has
+    if (u->pos < u->resume) {
+        size_t skip = u->resume - u->pos < len ? u->resume - u->pos : len;
+        u->pos += skip;
+        p += skip;
+        len -= skip;
+    }
+    while (len > 0) {
+        size_t room = HIVE_FRAME_MAX_PAYLOAD - u->fill;
+        size_t n = room < len ? room : len;
+        memcpy(u->frame + HIVE_FRAME_HEADER_LEN + u->fill, p, n);
+        u->fill += n;
+        u->pos += n;
+        p += n;
+        len -= n;
+        if (u->fill == HIVE_FRAME_MAX_PAYLOAD) {
+            flush(u);
+            //the send may have stopped it
+            if (u->stopped) {
+                return;
+            }
+        }
+    }
+}
+
+void hive_upload_end(struct hive_upload *u) {
+    uint8_t payload[4];
+    if (u->stopped) {
+        return;
+    }
+    flush(u);
+    if (u->stopped) {
+        return;
+    }
+    put_u32(payload, u->crc);
+    send_frame(u, HIVE_FRAME_END, u->pos, payload, sizeof(payload));
+}
+
+void hive_upload_stop(struct hive_upload *u) {
+    u->stopped = 1;
+    u->fill = 0;
+}
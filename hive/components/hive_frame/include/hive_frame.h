@@ -0,0 +1,88 @@
+//framing for the node's uploads, so the base station can tell a lost or out of
+//order write and a dropped connection picks up where it stopped.
+//an upload is the sensor data followed by the spectrum packet or audio, the same
+//bytes hive_process reads from the base station's .in file.  the node sends
+//   START  payload u32 upload id
+//   DATA   offset of the payload in the upload, as many as it takes
+//   END    offset is the upload's length, payload u32 crc32 of the upload
+//and the base station notifies back
+//   RESUME after START, the first DATA after a gap or an END it can't finish,
+//          offset is the bytes it has
+//   DONE   after an END that checks out, offset is the length
+//both with the upload id as payload.  the node then sends again from the RESUME
+//offset, under the same id, and a START for an upload already done gets DONE.
+//test/test_frame.py runs this file against Base/hive_frame.py over a lossy link.
+//
+//frame header, little endian:
+//   0  "HF", u8 version, u8 type
+//   4  u16 seq, u16 payload len
+//   8  u32 offset
+//  12  u32 crc32 of bytes 0-11 and the payload
+//seq counts the node's frames.  the base station counts losses with it and
+//replies with the seq of the frame it answers.
+
+#ifndef HIVE_FRAME_H
+#define HIVE_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HIVE_FRAME_MAGIC "HF"
+#define HIVE_FRAME_VERSION 1
+#define HIVE_FRAME_HEADER_LEN 16
+//the nodes' BLE write size
+#define HIVE_FRAME_MAX_LEN 496
+#define HIVE_FRAME_MAX_PAYLOAD (HIVE_FRAME_MAX_LEN - HIVE_FRAME_HEADER_LEN)
+
+enum hive_frame_type {
+    HIVE_FRAME_START = 1,
+    HIVE_FRAME_DATA,
+    HIVE_FRAME_END,
+    HIVE_FRAME_RESUME,
+    HIVE_FRAME_DONE,
+};
+
+struct hive_frame_header {
+    int type;
+    uint16_t seq;
+    uint16_t len;
+    uint32_t offset;
+};
+
+//the same crc32 as zlib's, start from 0
+uint32_t hive_crc32(uint32_t crc, const void *data, size_t len);
+
+//len payload bytes, at most HIVE_FRAME_MAX_PAYLOAD.  returns the frame length.
+size_t hive_frame_write(uint8_t *out, const struct hive_frame_header *h, const void *payload);
+//returns 0 and points *payload into buf, -EINVAL if it isn't a frame or -EBADMSG
+//if its crc is wrong
+int hive_frame_read(const uint8_t *buf, size_t len, struct hive_frame_header *h, const uint8_t **payload);
+
+typedef void (*hive_frame_send_fn)(void *ctx, const uint8_t *frame, size_t len);
+
+//cuts an upload into frames as it is written.  bytes before resume are only
+//counted, so the upload can be written again from the start to resume it.
+struct hive_upload {
+    uint32_t id;
+    uint32_t pos;           //bytes written so far
+    uint32_t resume;
+    uint32_t crc;
+    uint16_t seq;
+    uint32_t frames;        //sent since hive_upload_begin
+    int fill;               //payload bytes waiting in frame
+    int stopped;
+    hive_frame_send_fn send;
+    void *ctx;
+    uint8_t frame[HIVE_FRAME_MAX_LEN];
+};
+
+//sends START.  seq carries on from the frames u sent before.
+void hive_upload_begin(struct hive_upload *u, uint32_t id, uint32_t resume, hive_frame_send_fn send, void *ctx);
+void hive_upload_write(struct hive_upload *u, const void *data, size_t len);
+//sends what is left and END
+void hive_upload_end(struct hive_upload *u);
+//sends nothing more until the next hive_upload_begin, for when the base station
+//has asked for the upload again from further back
+void hive_upload_stop(struct hive_upload *u);
+
+#endif
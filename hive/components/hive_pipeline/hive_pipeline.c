@@ -0,0 +1,98 @@
+//flash slot scheduling, see hive_pipeline.h.
+
+#include <errno.h>
+
+#include "hive_pipeline.h"
+
+int hive_pipeline_init(struct hive_pipeline *p, uint32_t partition_size, uint32_t slot_size, int nslots) {
+    if (nslots < 2 || nslots > HIVE_PIPELINE_MAX_SLOTS || slot_size == 0 ||
+        slot_size > partition_size / nslots) {
+        return -EINVAL;
+    }
+    p->nslots = nslots;
+    p->slot_size = slot_size;
+    p->seq = 0;
+    p->dropped = 0;
+    for (int s = 0; s < nslots; s++) {
+        p->slot[s] = (struct hive_slot){.state = HIVE_SLOT_FREE, .offset = s * slot_size};
+    }
+    return 0;
+}
+
+//first slot in state, -1 for none
+static int find(const struct hive_pipeline *p, enum hive_slot_state state) {
+    for (int s = 0; s < p->nslots; s++) {
+        if (p->slot[s].state == state) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+//the full slot recorded first.  seq wraps, so it is compared by distance.
+static int oldest_full(const struct hive_pipeline *p) {
+    int best = -1;
+    for (int s = 0; s < p->nslots; s++) {
+        if (p->slot[s].state == HIVE_SLOT_FULL &&
+            (best < 0 || (int32_t)(p->slot[s].seq - p->slot[best].seq) < 0)) {
+            best = s;
+        }
+    }
+    return best;
+}
+
+int hive_pipeline_erase_begin(struct hive_pipeline *p) {
+    int s = find(p, HIVE_SLOT_FREE);
+    if (s >= 0) {
+        p->slot[s].state = HIVE_SLOT_ERASING;
+    }
+    return s;
+}
+
+void hive_pipeline_erase_end(struct hive_pipeline *p, int s) {
+    p->slot[s].state = HIVE_SLOT_ERASED;
+}
+
+int hive_pipeline_record_begin(struct hive_pipeline *p, int *erase) {
+    int s = find(p, HIVE_SLOT_ERASED);
+    *erase = 0;
+    if (s < 0) {
+        *erase = 1;
+        s = find(p, HIVE_SLOT_FREE);
+    }
+    if (s < 0 && (s = oldest_full(p)) >= 0) {
+        //the radio can't keep up, a fresh recording is worth more than an old one
+        p->dropped++;
+    }
+    if (s >= 0) {
+        p->slot[s].state = HIVE_SLOT_RECORDING;
+        p->slot[s].len = 0;
+    }
+    return s;
+}
+
+void hive_pipeline_record_end(struct hive_pipeline *p, int s, uint32_t len) {
+    p->slot[s].state = HIVE_SLOT_FULL;
+    p->slot[s].len = len;
+    p->slot[s].seq = p->seq++;
+}
+
+int hive_pipeline_send_begin(struct hive_pipeline *p) {
+    int s = oldest_full(p);
+    if (s >= 0) {
+        p->slot[s].state = HIVE_SLOT_SENDING;
+    }
+    return s;
+}
+
+void hive_pipeline_send_end(struct hive_pipeline *p, int s, int sent) {
+    p->slot[s].state = sent ? HIVE_SLOT_FREE : HIVE_SLOT_FULL;
+}
+
+int hive_pipeline_pending(const struct hive_pipeline *p) {
+    int n = 0;
+    for (int s = 0; s < p->nslots; s++) {
+        n += p->slot[s].state == HIVE_SLOT_FULL;
+    }
+    return n;
+}
@@ -0,0 +1,64 @@
+//which flash slot the node records into and which one it sends from, so the next
+//recording and the erase ahead of it overlap with sending the last one.
+//the storage partition is cut into nslots slots of slot_size bytes, each going
+//  FREE -> ERASING -> ERASED -> RECORDING -> FULL -> SENDING -> FREE
+//these calls only move slots from state to state.  the caller does the erasing,
+//recording and sending, and holds a lock around the calls when they come from
+//different tasks.  test/test_pipeline.c runs the record and send tasks against
+//a simulated flash, microphone and radio.
+
+#ifndef HIVE_PIPELINE_H
+#define HIVE_PIPELINE_H
+
+#include <stdint.h>
+
+#define HIVE_PIPELINE_MAX_SLOTS 8
+
+enum hive_slot_state {
+    HIVE_SLOT_FREE,         //sent or never used, needs erasing
+    HIVE_SLOT_ERASING,
+    HIVE_SLOT_ERASED,
+    HIVE_SLOT_RECORDING,
+    HIVE_SLOT_FULL,         //recorded, waiting to be sent
+    HIVE_SLOT_SENDING,
+};
+
+struct hive_slot {
+    enum hive_slot_state state;
+    uint32_t offset;        //in the partition
+    uint32_t len;           //bytes recorded
+    uint32_t seq;           //recordings are sent in this order
+};
+
+struct hive_pipeline {
+    int nslots;
+    uint32_t slot_size;
+    struct hive_slot slot[HIVE_PIPELINE_MAX_SLOTS];
+    uint32_t seq;
+    //recordings written over before they could be sent
+    uint32_t dropped;
+};
+
+//slot_size must be a whole number of erase sectors.
+//returns 0 or -EINVAL if 2..HIVE_PIPELINE_MAX_SLOTS slots don't fit in the partition.
+int hive_pipeline_init(struct hive_pipeline *p, uint32_t partition_size, uint32_t slot_size, int nslots);
+
+//a free slot to erase ahead of the next recording, -1 when there is none
+int hive_pipeline_erase_begin(struct hive_pipeline *p);
+void hive_pipeline_erase_end(struct hive_pipeline *p, int s);
+
+//the slot the next recording goes in: an erased one if there is one, else a free
+//one, else the oldest recording not being sent, which is dropped.  *erase is set
+//when the slot has to be erased first.  -1 when every slot is busy.
+int hive_pipeline_record_begin(struct hive_pipeline *p, int *erase);
+void hive_pipeline_record_end(struct hive_pipeline *p, int s, uint32_t len);
+
+//the oldest recording waiting to be sent, -1 for none
+int hive_pipeline_send_begin(struct hive_pipeline *p);
+//a recording that didn't go out waits to be sent again
+void hive_pipeline_send_end(struct hive_pipeline *p, int s, int sent);
+
+//recordings waiting to be sent
+int hive_pipeline_pending(const struct hive_pipeline *p);
+
+#endif
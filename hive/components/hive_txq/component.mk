@@ -0,0 +1,4 @@
+#
+# hive_txq component makefile for the make build.
+#
+# (Uses default behaviour of compiling all source files in directory, adding 'include' to include path.)
@@ -0,0 +1,93 @@
+//BLE write credits, see hive_txq.h.
+
+#include <errno.h>
+
+#include "hive_txq.h"
+
+void hive_txq_init(struct hive_txq *q, int max_inflight) {
+    *q = (struct hive_txq){0};
+    q->max_inflight = max_inflight < 1 ? 1 :
+                      max_inflight > HIVE_TXQ_MAX_INFLIGHT ? HIVE_TXQ_MAX_INFLIGHT : max_inflight;
+}
+
+void hive_txq_ready(struct hive_txq *q, int sendable) {
+    //always one, the write complete events still pace the writes if the stack
+    //says it has no room yet
+    q->limit = sendable < 1 ? 1 : sendable > q->max_inflight ? q->max_inflight : sendable;
+    q->inflight = 0;
+    q->head = 0;
+    q->ready = 1;
+    q->congested = 0;
+}
+
+void hive_txq_lost(struct hive_txq *q) {
+    q->failed += q->inflight;
+    q->inflight = 0;
+    q->head = 0;
+    q->ready = 0;
+}
+
+void hive_txq_congest(struct hive_txq *q, int congested) {
+    q->congested = congested;
+}
+
+int hive_txq_timeout(struct hive_txq *q, int sendable) {
+    if (q->congested) {
+        return 0;
+    }
+    hive_txq_ready(q, sendable);
+    return 1;
+}
+
+int hive_txq_acquire(struct hive_txq *q, uint16_t len) {
+    if (!q->ready) {
+        return -ENOTCONN;
+    }
+    if (q->congested || q->inflight >= q->limit) {
+        return -EAGAIN;
+    }
+    q->len[(q->head + q->inflight) % HIVE_TXQ_MAX_INFLIGHT] = len;
+    q->inflight++;
+    return 0;
+}
+
+void hive_txq_abort(struct hive_txq *q) {
+    if (q->inflight > 0) {
+        q->inflight--;
+    }
+}
+
+void hive_txq_complete(struct hive_txq *q, int ok, int64_t now_us) {
+    //an event for a write from before hive_txq_ready, its credit is already back.
+    //the events carry nothing to tell the writes apart, so one that turns up
+    //after new writes went out is taken for the oldest of them.
+    if (q->inflight == 0) {
+        return;
+    }
+    if (ok) {
+        q->packets++;
+        q->bytes += q->len[q->head];
+        q->last_us = now_us;
+    } else {
+        q->failed++;
+    }
+    q->head = (q->head + 1) % HIVE_TXQ_MAX_INFLIGHT;
+    q->inflight--;
+}
+
+int hive_txq_pending(const struct hive_txq *q) {
+    return q->inflight;
+}
+
+void hive_txq_start(struct hive_txq *q, int64_t now_us) {
+    q->packets = 0;
+    q->bytes = 0;
+    q->failed = 0;
+    q->start_us = now_us;
+    q->last_us = now_us;
+}
+
+uint32_t hive_txq_rate(const struct hive_txq *q) {
+    int64_t us = q->last_us - q->start_us;
+    return us > 0 ? (uint32_t)((int64_t)q->bytes * 1000000 / us) : 0;
+}
@@ -0,0 +1,62 @@
+//credits for the node's BLE writes, so several go out back to back and the sender
+//sleeps until the stack hands one back instead of polling the buffers.
+//a write takes a credit and the stack's write complete event returns it.  the
+//congestion event holds every write back until it clears.  the lengths of the
+//writes in flight are kept in order, so completed bytes can be counted for the
+//throughput.  the caller holds a lock around the calls and wakes the sender on
+//events, test/test_txq.c stands in a fake GATT stack for them.
+
+#ifndef HIVE_TXQ_H
+#define HIVE_TXQ_H
+
+#include <stdint.h>
+
+#define HIVE_TXQ_MAX_INFLIGHT 8
+
+struct hive_txq {
+    int max_inflight;
+    int limit;              //credits this connection started with
+    int inflight;
+    int head;               //oldest write in flight
+    uint16_t len[HIVE_TXQ_MAX_INFLIGHT];
+    int ready;              //connected and the server is listening
+    int congested;
+    //since hive_txq_start
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t failed;
+    int64_t start_us;
+    int64_t last_us;        //time of the last completed write
+};
+
+//max_inflight is clamped to 1..HIVE_TXQ_MAX_INFLIGHT
+void hive_txq_init(struct hive_txq *q, int max_inflight);
+
+//the connection can take writes, sendable is the stack's free buffer count.
+//also starts over after writes got lost, any still in flight are forgotten.
+void hive_txq_ready(struct hive_txq *q, int sendable);
+//disconnected, nothing goes out until hive_txq_ready
+void hive_txq_lost(struct hive_txq *q);
+void hive_txq_congest(struct hive_txq *q, int congested);
+//no write complete came while waiting for a credit: starts the credits over as
+//hive_txq_ready does, unless the stack is congested, which only its own event
+//clears.  returns 1 if they were started over.
+int hive_txq_timeout(struct hive_txq *q, int sendable);
+
+//a credit for a write of len bytes.  returns 0, -EAGAIN when the caller has to
+//wait for an event or -ENOTCONN.
+int hive_txq_acquire(struct hive_txq *q, uint16_t len);
+//the write just acquired couldn't be started, gives its credit back
+void hive_txq_abort(struct hive_txq *q);
+//the oldest write in flight finished, ok is 0 if the stack dropped it
+void hive_txq_complete(struct hive_txq *q, int ok, int64_t now_us);
+
+//writes in flight
+int hive_txq_pending(const struct hive_txq *q);
+
+//zeroes the counters
+void hive_txq_start(struct hive_txq *q, int64_t now_us);
+//bytes a second from hive_txq_start to the last completed write
+uint32_t hive_txq_rate(const struct hive_txq *q);
+
+#endif
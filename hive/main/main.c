@@ -16,6 +16,7 @@
 #include "nvs_flash.h"
 #include <unistd.h>
 #include <time.h>
+#include <errno.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
@@ -36,6 +37,12 @@
 #include "driver/i2c.h"
 #include "driver/gpio.h"
 #include "freertos/queue.h"
+#include "esp_timer.h"
+#include "hive_dsp.h"
+#include "hive_adpcm.h"
+#include "hive_pipeline.h"
+#include "hive_txq.h"
+#include "hive_frame.h"
 
 
 #define GATTC_TAG                   "HIVE_CLIENT"
@@ -45,6 +52,15 @@
 #define PROFILE_A_APP_ID            0
 #define INVALID_HANDLE              0
 #define MAX_SEND                    496
+//writes handed to the stack before the first one has gone out
+#define MAX_INFLIGHT                4
+//how long to wait for a write complete event before taking the writes in flight as lost
+#define SEND_TIMEOUT                1000
+//tries in a row that get no further before an upload is left, each one carries on
+//from where the last stopped
+#define UPLOAD_TRIES                5
+//for the base station's RESUME or DONE
+#define UPLOAD_REPLY_TIMEOUT        5000
 
 #define HIVE_TASK_PERIOD            1000*30
 #define HIVE_RETRY_PERIOD           1000
@@ -56,6 +72,8 @@
 #define TH_CLK                      16
 
 #define I2S_SAMPLE_RATE             16000
+//what i2s_set_sample_rates actually runs the microphone at
+#define I2S_RECORD_RATE             22050
 #define I2S_SAMPLE_BITS             16
 #define I2S_READ_LEN                16*1024
 
@@ -65,6 +83,16 @@
 #define FLASH_RECORD_SIZE           (I2S_SAMPLE_RATE*I2S_SAMPLE_BITS/8*5)
 #define FLASH_ERASE_SIZE            (FLASH_RECORD_SIZE%FLASH_SECTOR_SIZE==0) ? FLASH_RECORD_SIZE : FLASH_RECORD_SIZE + (FLASH_SECTOR_SIZE - FLASH_RECORD_SIZE % FLASH_SECTOR_SIZE)
 #define PARTITION_NAME              "storage"
+//the partition is cut into slots of a recording each, one is recorded into while
+//the one before it is sent
+#define FLASH_SLOTS                 2
+#define FLASH_SLOT_SIZE             ((FLASH_RECORD_SIZE + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE * FLASH_SECTOR_SIZE)
+
+//1 to upload the raw recording instead of its spectrum, for checking the node's
+//spectrum against the base station's
+#define SEND_RAW_AUDIO              0
+//raw audio goes IMA-ADPCM coded, a quarter of the writes.  0 for plain 16 bit PCM
+#define RAW_AUDIO_ADPCM             1
 
 #define _I2C_NUMBER(num) I2C_NUM_##num
 #define I2C_NUMBER(num) _I2C_NUMBER(num)
@@ -90,12 +118,24 @@
 static const char remote_device_name[] = "HIVE BASE";       //Use this one for connecting to Pi
 static bool connect    = false;
 static bool get_server = false;
-static bool can_send_write = false;
 static bool is_connect = false;
 
 static esp_gattc_char_elem_t *char_elem_result   = NULL;
 static esp_gattc_descr_elem_t *descr_elem_result = NULL;
+//given on every event that might let safe_send write again
 static SemaphoreHandle_t gattc_semaphore;
+//credits for the writes, taken by safe_send and handed back in esp_gattc_cb.
+//txq_lock guards it as the two run in different tasks.
+static struct hive_txq txq;
+static portMUX_TYPE txq_lock = portMUX_INITIALIZER_UNLOCKED;
+//the base station's RESUME and DONE frames, from the notify event to the send task
+struct upload_reply {
+    int type;
+    uint16_t seq;
+    uint32_t offset;
+    uint32_t id;
+};
+static QueueHandle_t reply_queue;
 
 
 /* Declare static functions */
@@ -103,11 +143,13 @@ static void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *par
 static void esp_gattc_cb(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param);
 static void gattc_profile_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param);
 static void get_sensor_data();
-static void send_data_to_server();
+static int send_data_to_server(int slot);
 static void safe_send(uint16_t dsize, uint8_t* daddr);
-void erase_flash(void);
-void record_audio_to_flash();
-void send_audio_from_flash();
+void erase_flash(int slot);
+int record_audio_to_flash(int slot);
+void send_audio_from_flash(const struct hive_slot *slot, struct hive_upload *upload);
+void send_spectrum_from_flash(const struct hive_slot *slot, struct hive_upload *upload);
+void send_adpcm_from_flash(const struct hive_slot *slot, struct hive_upload *upload);
 
 
 static esp_bt_uuid_t remote_filter_service_uuid = {
@@ -177,7 +219,18 @@ typedef struct {
 
 sensor_data data = {};
 //uint8_t* audio_data;
-int flash_wr_size = 0;
+//which slot is being recorded, sent or erased, and the readings taken with each
+//recording.  hive_record_task and hive_send_task only touch pipeline under pipeline_lock.
+static struct hive_pipeline pipeline;
+static sensor_data slot_data[FLASH_SLOTS];
+//a random id per recording, so the base station never resumes one with another
+static uint32_t slot_upload_id[FLASH_SLOTS];
+static SemaphoreHandle_t pipeline_lock;
+//a slot index each time a recording is ready to send
+static QueueHandle_t send_queue;
+//spectrum of the recording, its tables are made once in app_main
+static struct hive_dsp dsp;
+static bool dsp_ready = false;
 
 /* One gatt-based profile one app_id and one gattc_if, this array will store the gattc_if returned by ESP_GATTS_REG_EVT */
 static struct gattc_profile_inst gl_profile_tab[PROFILE_NUM] = {
@@ -369,10 +422,19 @@ static void gattc_profile_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_
             ESP_LOGI(GATTC_TAG, "ESP_GATTC_NOTIFY_EVT, receive indicate value:");
         }
         esp_log_buffer_hex(GATTC_TAG, p_data->notify.value, p_data->notify.value_len);
-        
-        //Try send once
-        //get_sensor_data();
-        //TODO this wasnt working, need to fix.
+
+        struct hive_frame_header h;
+        const uint8_t *payload;
+        if (reply_queue && hive_frame_read(p_data->notify.value, p_data->notify.value_len, &h, &payload) == 0 &&
+            (h.type == HIVE_FRAME_RESUME || h.type == HIVE_FRAME_DONE) && h.len == 4) {
+            struct upload_reply reply = {
+                .type = h.type,
+                .seq = h.seq,
+                .offset = h.offset,
+                .id = payload[0] | payload[1] << 8 | payload[2] << 16 | (uint32_t)payload[3] << 24,
+            };
+            xQueueSend(reply_queue, &reply, 0);
+        }
         break;
     }
     case ESP_GATTC_WRITE_DESCR_EVT:{
@@ -382,8 +444,11 @@ static void gattc_profile_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_
         }
         ESP_LOGI(GATTC_TAG, "write descr success ");
 
-        ESP_LOGW(GATTC_TAG, "CAN SEND WRITE: TRUE");
-        can_send_write = true;
+        int sendable = esp_ble_get_cur_sendable_packets_num(gl_profile_tab[PROFILE_A_APP_ID].conn_id);
+        ESP_LOGW(GATTC_TAG, "CAN SEND WRITE: TRUE, %d buffers", sendable);
+        portENTER_CRITICAL(&txq_lock);
+        hive_txq_ready(&txq, sendable);
+        portEXIT_CRITICAL(&txq_lock);
         xSemaphoreGive(gattc_semaphore);
 
         break;
@@ -396,27 +461,34 @@ static void gattc_profile_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_
         break;
     }
     case ESP_GATTC_WRITE_CHAR_EVT:{
+        //comes for the no response writes too, once the packet is handed down
+        portENTER_CRITICAL(&txq_lock);
+        hive_txq_complete(&txq, p_data->write.status == ESP_GATT_OK, esp_timer_get_time());
+        portEXIT_CRITICAL(&txq_lock);
+        xSemaphoreGive(gattc_semaphore);
         if (p_data->write.status != ESP_GATT_OK){
             ESP_LOGE(GATTC_TAG, "write char failed, error status = %x", p_data->write.status);
-            break;
         }
-        ESP_LOGI(GATTC_TAG, "write char success ");
         break;
     }
     case ESP_GATTC_DISCONNECT_EVT:{
         connect = false;
         is_connect = false;
         get_server = false;
+        portENTER_CRITICAL(&txq_lock);
+        hive_txq_lost(&txq);
+        portEXIT_CRITICAL(&txq_lock);
+        //send_flush stops waiting on writes that won't complete now
+        xSemaphoreGive(gattc_semaphore);
         ESP_LOGI(GATTC_TAG, "ESP_GATTC_DISCONNECT_EVT, reason = %d", p_data->disconnect.reason);
         break;
     }
     case ESP_GATTC_CONGEST_EVT:{
-        if (param->congest.congested) {
-            ESP_LOGW(GATTC_TAG, "CAN SEND WRITE: FALSE");
-            can_send_write = false;
-        } else {
-            ESP_LOGW(GATTC_TAG, "CAN SEND WRITE: TRUE");
-            can_send_write = true;
+        ESP_LOGW(GATTC_TAG, "CAN SEND WRITE: %s", param->congest.congested ? "FALSE" : "TRUE");
+        portENTER_CRITICAL(&txq_lock);
+        hive_txq_congest(&txq, param->congest.congested);
+        portEXIT_CRITICAL(&txq_lock);
+        if (!param->congest.congested) {
             xSemaphoreGive(gattc_semaphore);
         }
         break;
@@ -541,37 +613,56 @@ static void esp_gattc_cb(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp
     } while (0);
 }
 
+//hands a write to the stack as soon as there is a credit for it and returns
+//without waiting for it to go out, the stack keeps its own copy of daddr.
+//sleeps on gattc_semaphore while there is no credit or connection.
 static void safe_send(uint16_t dsize, uint8_t* daddr) {
     while(1){
-        if (!can_send_write) {
-            ESP_LOGE(GATTC_TAG, "SEMAPHORE");
-            int res = xSemaphoreTake(gattc_semaphore, portMAX_DELAY); 
-            assert(res == pdTRUE);
-        } 
-        else {
-            if (is_connect) {
-                int free_buff_num = esp_ble_get_cur_sendable_packets_num(gl_profile_tab[PROFILE_A_APP_ID].conn_id);
-                if(free_buff_num > 0) {            
-                    ESP_LOGE(GATTC_TAG, "BUFFER IS OPEN LETS SEND %d BYTES", dsize);      
-                    esp_ble_gattc_write_char(gl_profile_tab[PROFILE_A_APP_ID].gattc_if,
-                                                    gl_profile_tab[PROFILE_A_APP_ID].conn_id,
-                                                    gl_profile_tab[PROFILE_A_APP_ID].char_handle,
-                                                    dsize, 
-                                                    daddr,
-                                                    ESP_GATT_WRITE_TYPE_NO_RSP,
-                                                    ESP_GATT_AUTH_REQ_NONE);
-                    break;
-                } else {   
-                    vTaskDelay( 10 / portTICK_PERIOD_MS );
-                }
-                
+        portENTER_CRITICAL(&txq_lock);
+        int res = hive_txq_acquire(&txq, dsize);
+        portEXIT_CRITICAL(&txq_lock);
+        if (res == 0) {
+            esp_err_t err = esp_ble_gattc_write_char(gl_profile_tab[PROFILE_A_APP_ID].gattc_if,
+                                            gl_profile_tab[PROFILE_A_APP_ID].conn_id,
+                                            gl_profile_tab[PROFILE_A_APP_ID].char_handle,
+                                            dsize, 
+                                            daddr,
+                                            ESP_GATT_WRITE_TYPE_NO_RSP,
+                                            ESP_GATT_AUTH_REQ_NONE);
+            if (err == ESP_OK) {
+                break;
             }
-            
+            //no event will come for it, wait for one of the writes in flight instead
+            portENTER_CRITICAL(&txq_lock);
+            hive_txq_abort(&txq);
+            portEXIT_CRITICAL(&txq_lock);
+            ESP_LOGW(GATTC_TAG, "write char error %x, retrying", err);
+        }
+        if (xSemaphoreTake(gattc_semaphore, SEND_TIMEOUT / portTICK_PERIOD_MS) != pdTRUE && res == -EAGAIN) {
+            //an event went missing, start the credits over.  a congested stack is
+            //left to send its congestion event, writing into it would only be refused.
+            int sendable = esp_ble_get_cur_sendable_packets_num(gl_profile_tab[PROFILE_A_APP_ID].conn_id);
+            portENTER_CRITICAL(&txq_lock);
+            int reset = hive_txq_timeout(&txq, sendable);
+            portEXIT_CRITICAL(&txq_lock);
+            ESP_LOGW(GATTC_TAG, "no write complete in %d ms%s", SEND_TIMEOUT, reset ? "" : ", still congested");
         }
     }
 }
 
-void erase_flash(void) {
+//waits for every write safe_send started to go out, or for the connection to drop
+static void send_flush(void) {
+    while(1){
+        portENTER_CRITICAL(&txq_lock);
+        int pending = hive_txq_pending(&txq);
+        portEXIT_CRITICAL(&txq_lock);
+        if (pending == 0 || xSemaphoreTake(gattc_semaphore, SEND_TIMEOUT / portTICK_PERIOD_MS) != pdTRUE) {
+            break;
+        }
+    }
+}
+
+void erase_flash(int slot) {
     const esp_partition_t *data_partition = NULL;
     data_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
             ESP_PARTITION_SUBTYPE_DATA_FAT, PARTITION_NAME);
@@ -580,11 +671,12 @@ void erase_flash(void) {
         ESP_LOGI(GATTC_TAG, "partiton addr: 0x%08x; size: %d; label: %s\n", data_partition->address, data_partition->size, data_partition->label);
     }
     //printf("Erase size: %d Bytes\n", FLASH_ERASE_SIZE);
-    ESP_LOGI(GATTC_TAG, "Erase size: %d Bytes\n", FLASH_ERASE_SIZE);
-    ESP_ERROR_CHECK(esp_partition_erase_range(data_partition, 0, FLASH_ERASE_SIZE));
+    ESP_LOGI(GATTC_TAG, "Erase slot %d: %d Bytes\n", slot, FLASH_SLOT_SIZE);
+    ESP_ERROR_CHECK(esp_partition_erase_range(data_partition, pipeline.slot[slot].offset, FLASH_SLOT_SIZE));
 }
 
-void record_audio_to_flash() {
+//records into a slot that is already erased and returns the bytes written
+int record_audio_to_flash(int slot) {
     const esp_partition_t *data_partition = NULL;
     data_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
             ESP_PARTITION_SUBTYPE_DATA_FAT, PARTITION_NAME);
@@ -595,10 +687,9 @@ void record_audio_to_flash() {
         ESP_LOGE(GATTC_TAG, "Partition error: can't find partition name: %s\n", PARTITION_NAME);
         vTaskDelete(NULL);
     }
-    //1. Erase flash
-    erase_flash();
     int i2s_read_len = I2S_READ_LEN;
-    flash_wr_size = 0;
+    int flash_wr_size = 0;
+    uint32_t offset = pipeline.slot[slot].offset;
     size_t bytes_read;
 
     char* i2s_read_buff = (char*) calloc(i2s_read_len, sizeof(char));
@@ -612,8 +703,10 @@ void record_audio_to_flash() {
         
         //example_disp_buf((uint8_t*) i2s_read_buff, 64);
         //save original data from I2S(ADC) into flash.
-        esp_partition_write(data_partition, flash_wr_size, i2s_read_buff, i2s_read_len);
-        flash_wr_size += i2s_read_len;
+        //the last read is cut to fit so the recording never runs into the next slot
+        int wr_len = FLASH_RECORD_SIZE - flash_wr_size < i2s_read_len ? FLASH_RECORD_SIZE - flash_wr_size : i2s_read_len;
+        esp_partition_write(data_partition, offset + flash_wr_size, i2s_read_buff, wr_len);
+        flash_wr_size += wr_len;
         //ets_printf("Sound recording %u%%\n", flash_wr_size * 100 / FLASH_RECORD_SIZE);
     }
     ESP_LOGI(GATTC_TAG, "Recording complete");
@@ -623,9 +716,10 @@ void record_audio_to_flash() {
     i2s_read_buff = NULL;
     free(flash_write_buff);
     flash_write_buff = NULL;
+    return flash_wr_size;
 }
 
-void send_audio_from_flash() {
+void send_audio_from_flash(const struct hive_slot *slot, struct hive_upload *upload) {
     //int i2s_read_len = I2S_READ_LEN;
     uint8_t* flash_read_buff = (uint8_t*) calloc(MAX_SEND, sizeof(char));
     //uint8_t* i2s_write_buff = (uint8_t*) calloc(i2s_read_len, sizeof(char));
@@ -642,15 +736,15 @@ void send_audio_from_flash() {
         vTaskDelete(NULL);
     }
     ESP_LOGI(GATTC_TAG,"Sending from flash start");
-    for (int rd_offset = 0; rd_offset < flash_wr_size; rd_offset += MAX_SEND) {
+    for (int rd_offset = 0; rd_offset < slot->len; rd_offset += MAX_SEND) {
         //read I2S(ADC) original data from flash
-        esp_partition_read(data_partition, rd_offset, flash_read_buff, MAX_SEND);
+        int rd_len = slot->len - rd_offset < MAX_SEND ? slot->len - rd_offset : MAX_SEND;
+        esp_partition_read(data_partition, slot->offset + rd_offset, flash_read_buff, rd_len);
         //process data and scale to 8bit for I2S DAC.
         //example_i2s_adc_data_scale(i2s_write_buff, flash_read_buff, FLASH_SECTOR_SIZE);
         //send data
         //i2s_write(EXAMPLE_I2S_NUM, i2s_write_buff, FLASH_SECTOR_SIZE, &bytes_written, portMAX_DELAY);
-        safe_send(MAX_SEND, flash_read_buff);
-        vTaskDelay(10/portTICK_PERIOD_MS);
+        hive_upload_write(upload, flash_read_buff, rd_len);
         // bool sent = false;
         // while(!sent) {
         //     int free_buff_num = esp_ble_get_cur_sendable_packets_num(gl_profile_tab[PROFILE_A_APP_ID].conn_id);
@@ -675,6 +769,96 @@ void send_audio_from_flash() {
     ESP_LOGI(GATTC_TAG,"Sending from flash end");
 }
 
+//same as send_audio_from_flash with the samples ADPCM coded as they are read back,
+//a MAX_SEND block carries 984 samples where raw audio carries 248.  hive_process
+//knows the stream by the header sent in front of it.
+void send_adpcm_from_flash(const struct hive_slot *slot, struct hive_upload *upload) {
+    int block_samples = hive_adpcm_block_samples(MAX_SEND);
+    int16_t* flash_read_buff = (int16_t*) calloc(block_samples, sizeof(int16_t));
+    uint8_t* block = (uint8_t*) calloc(MAX_SEND, sizeof(char));
+    if (!flash_read_buff || !block) {
+        ESP_LOGE(GATTC_TAG, "ADPCM error: no memory, sending raw audio");
+        free(flash_read_buff);
+        free(block);
+        send_audio_from_flash(slot, upload);
+        return;
+    }
+
+    const esp_partition_t *data_partition = NULL;
+    data_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+            ESP_PARTITION_SUBTYPE_DATA_FAT, PARTITION_NAME);
+    if (data_partition == NULL) {
+        ESP_LOGE(GATTC_TAG, "Partition error: can't find partition name: %s\n", PARTITION_NAME);
+        vTaskDelete(NULL);
+    }
+    int nsamples = slot->len / sizeof(int16_t);
+    struct hive_adpcm_header header = {
+        .block_len = MAX_SEND,
+        .nsamples = nsamples,
+        .sample_rate = I2S_RECORD_RATE,
+    };
+    struct hive_adpcm_state state = {0};
+    uint8_t header_buff[HIVE_ADPCM_HEADER_LEN];
+    hive_adpcm_header_write(header_buff, &header);
+    ESP_LOGI(GATTC_TAG,"Sending ADPCM from flash start");
+    hive_upload_write(upload, header_buff, sizeof(header_buff));
+    for (int sample = 0; sample < nsamples; sample += block_samples) {
+        int n = nsamples - sample < block_samples ? nsamples - sample : block_samples;
+        esp_partition_read(data_partition, slot->offset + sample * sizeof(int16_t), flash_read_buff, n * sizeof(int16_t));
+        hive_adpcm_encode_block(&state, flash_read_buff, n, block, MAX_SEND);
+        hive_upload_write(upload, block, MAX_SEND);
+    }
+    ESP_LOGI(GATTC_TAG,"Sending ADPCM from flash end");
+    free(flash_read_buff);
+    free(block);
+}
+
+//works the spectrum of the recording out here and sends that, a few hundred bytes
+//instead of FLASH_RECORD_SIZE of audio.  the base station's
+//hive_process tells the packet apart from audio by its "HVSP" magic.  without
+//the spectrum code the audio goes instead, ADPCM coded, so the upload is never
+//just the sensor data.
+void send_spectrum_from_flash(const struct hive_slot *slot, struct hive_upload *upload) {
+    if (!dsp_ready) {
+        ESP_LOGE(GATTC_TAG, "Spectrum error: hive_dsp_init failed at startup, sending ADPCM audio");
+        send_adpcm_from_flash(slot, upload);
+        return;
+    }
+    uint8_t* flash_read_buff = (uint8_t*) calloc(MAX_SEND, sizeof(char));
+    uint8_t* packet = (uint8_t*) calloc(HIVE_SPECTRUM_MAX_LEN, sizeof(char));
+    if (!flash_read_buff || !packet) {
+        ESP_LOGE(GATTC_TAG, "Spectrum error: no memory, sending ADPCM audio");
+        free(flash_read_buff);
+        free(packet);
+        send_adpcm_from_flash(slot, upload);
+        return;
+    }
+
+    const esp_partition_t *data_partition = NULL;
+    data_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+            ESP_PARTITION_SUBTYPE_DATA_FAT, PARTITION_NAME);
+    if (data_partition == NULL) {
+        ESP_LOGE(GATTC_TAG, "Partition error: can't find partition name: %s\n", PARTITION_NAME);
+        vTaskDelete(NULL);
+    }
+    ESP_LOGI(GATTC_TAG,"Spectrum from flash start");
+    hive_dsp_reset(&dsp);
+    for (int rd_offset = 0; rd_offset < slot->len; rd_offset += MAX_SEND) {
+        int rd_len = slot->len - rd_offset < MAX_SEND ? slot->len - rd_offset : MAX_SEND;
+        esp_partition_read(data_partition, slot->offset + rd_offset, flash_read_buff, rd_len);
+        hive_dsp_push(&dsp, (const int16_t*)flash_read_buff, rd_len / sizeof(int16_t));
+    }
+    int len = hive_dsp_packet(&dsp, packet, HIVE_SPECTRUM_MAX_LEN);
+    if (len > 0) {
+        ESP_LOGI(GATTC_TAG,"Sending %d byte spectrum of %d frames", len, dsp.frames);
+        hive_upload_write(upload, packet, len);
+    } else {
+        ESP_LOGE(GATTC_TAG, "Spectrum error: packet too big");
+    }
+    free(flash_read_buff);
+    free(packet);
+}
+
 /**
  * @brief i2c master initialization
  */
@@ -775,24 +959,107 @@ static void get_sensor_data()
     data.temp = ((data.temp/10485776*200)-50)*9/5+32;
 
     data.weight = weight;    
-    //Record the audio data to flash
-    record_audio_to_flash();
 }
 
-static void send_data_to_server()
+//ctx is the upload.  the base station sends a RESUME as soon as it misses a frame,
+//the rest of this try would be thrown away so it stops here.  only between DATA
+//frames, the replies to START and END are left for upload_reply.
+static void upload_frame_send(void *ctx, const uint8_t *frame, size_t len)
+{
+    struct hive_upload *upload = ctx;
+    struct upload_reply reply;
+    uint16_t start_seq = upload->seq - upload->frames;
+
+    safe_send(len, (uint8_t*)frame);
+    while (frame[3] == HIVE_FRAME_DATA && xQueueReceive(reply_queue, &reply, 0) == pdTRUE) {
+        if (reply.id == upload->id && reply.type == HIVE_FRAME_RESUME && reply.seq != start_seq) {
+            ESP_LOGW(GATTC_TAG, "Upload %08x lost a frame at byte %u", upload->id, (unsigned)reply.offset);
+            upload->resume = reply.offset;
+            hive_upload_stop(upload);
+        }
+    }
+}
+
+//the base station's reply for upload id, to the frame seq or to anything when seq
+//is -1.  -1 if none came.
+static int upload_reply(uint32_t id, int seq, struct upload_reply *reply)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t wait = UPLOAD_REPLY_TIMEOUT / portTICK_PERIOD_MS;
+    while (xTaskGetTickCount() - start < wait) {
+        if (xQueueReceive(reply_queue, reply, wait - (xTaskGetTickCount() - start)) != pdTRUE) {
+            break;
+        }
+        //another node's, or from before
+        if (reply->id == id && (seq < 0 || reply->seq == seq)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+//sends the slot's readings and recording as one framed upload.  the recording is
+//read back and framed again on each try, only what the base station is missing
+//goes out.  returns 0 once the base station has all of it, -1 after UPLOAD_TRIES
+//tries in a row got no further.
+static int send_data_to_server(int slot)
 {             
-    
-    safe_send(sizeof(data), (uint8_t*)&data);
-    vTaskDelay(1/portTICK_PERIOD_MS);
-    
-    send_audio_from_flash();
-    vTaskDelay(1000/portTICK_PERIOD_MS);
-    
-    uint32_t end_data = 0xFAFAFAFA;
-    ESP_LOGW(GATTC_TAG,"SENDING ENDING DATA");
-    safe_send(sizeof(uint32_t), (uint8_t*)&end_data);
-    
-    
+    static struct hive_upload upload;
+    uint32_t id = slot_upload_id[slot];
+    uint32_t resume = 0;
+
+    portENTER_CRITICAL(&txq_lock);
+    hive_txq_start(&txq, esp_timer_get_time());
+    portEXIT_CRITICAL(&txq_lock);
+    for (int tries = 0; tries < UPLOAD_TRIES; ) {
+        struct upload_reply reply;
+        uint32_t from = resume;
+        xQueueReset(reply_queue);
+        hive_upload_begin(&upload, id, 0, upload_frame_send, &upload);
+        if (upload_reply(id, (uint16_t)(upload.seq - 1), &reply) == 0) {
+            //the DONE for the last try went missing
+            if (reply.type == HIVE_FRAME_DONE) {
+                ESP_LOGI(GATTC_TAG, "Upload %08x already done", id);
+                return 0;
+            }
+            resume = reply.offset;
+        }
+        //with no answer, whatever came back last time still stands
+        upload.resume = resume;
+        ESP_LOGI(GATTC_TAG, "Upload %08x from byte %u", id, (unsigned)resume);
+
+        hive_upload_write(&upload, &slot_data[slot], sizeof(slot_data[slot]));
+#if SEND_RAW_AUDIO && RAW_AUDIO_ADPCM
+        send_adpcm_from_flash(&pipeline.slot[slot], &upload);
+#elif SEND_RAW_AUDIO
+        send_audio_from_flash(&pipeline.slot[slot], &upload);
+#else
+        send_spectrum_from_flash(&pipeline.slot[slot], &upload);
+#endif
+        hive_upload_end(&upload);
+        send_flush();
+
+        if (upload.stopped) {
+            resume = upload.resume;
+        } else if (upload_reply(id, -1, &reply) == 0) {
+            if (reply.type == HIVE_FRAME_DONE) {
+                portENTER_CRITICAL(&txq_lock);
+                struct hive_txq sent = txq;
+                portEXIT_CRITICAL(&txq_lock);
+                ESP_LOGI(GATTC_TAG, "Upload %08x of %u bytes done, sent %u bytes in %u writes, %u B/s, %u failed",
+                        id, (unsigned)upload.pos, (unsigned)sent.bytes, (unsigned)sent.packets,
+                        (unsigned)hive_txq_rate(&sent), (unsigned)sent.failed);
+                return 0;
+            }
+            resume = reply.offset;
+        }
+        ESP_LOGW(GATTC_TAG, "Upload %08x stopped short, the base station has %u of %u bytes",
+                id, (unsigned)resume, (unsigned)upload.pos);
+        if (resume <= from) {
+            tries++;
+        }
+    }
+    ESP_LOGE(GATTC_TAG, "Upload %08x failed, %d tries got no further", id, UPLOAD_TRIES);
     // esp_ble_gattc_write_char(gl_profile_tab[PROFILE_A_APP_ID].gattc_if,
     //                                 gl_profile_tab[PROFILE_A_APP_ID].conn_id,
     //                                 gl_profile_tab[PROFILE_A_APP_ID].char_handle,
@@ -807,24 +1074,87 @@ static void send_data_to_server()
     //                                 audio_data,
     //                                 ESP_GATT_WRITE_TYPE_NO_RSP,
     //                                 ESP_GATT_AUTH_REQ_NONE);
+    return -1;
 }
 
-static void hive_report_task(void *params)
+//takes the readings and a recording every HIVE_TASK_PERIOD, then erases the next
+//free slot while hive_send_task is still sending, so the next recording can start
+//straight away
+static void hive_record_task(void *params)
 {
+    TickType_t last_wake = xTaskGetTickCount();
     while(1) {
-        ESP_LOGI(GATTC_TAG, "HIVE TASK START");
+        int erase;
+        ESP_LOGI(GATTC_TAG, "HIVE RECORD START");
+        xSemaphoreTake(pipeline_lock, portMAX_DELAY);
+        int slot = hive_pipeline_record_begin(&pipeline, &erase);
+        xSemaphoreGive(pipeline_lock);
+        if (slot < 0) {
+            //both slots are busy, there is nowhere to record
+            ESP_LOGW(GATTC_TAG, "No free slot to record into");
+            vTaskDelay(HIVE_RETRY_PERIOD / portTICK_PERIOD_MS);
+            continue;
+        }
+        if (erase) {
+            erase_flash(slot);
+        }
         get_sensor_data();
         ESP_LOGI(GATTC_TAG, "Sensor Data:\n weight %lu", data.weight);
-        send_data_to_server();
-        ESP_LOGI(GATTC_TAG, "HIVE TASK END");
-        vTaskDelay(HIVE_TASK_PERIOD / portTICK_PERIOD_MS);
+        slot_data[slot] = data;
+        slot_upload_id[slot] = esp_random();
+        int len = record_audio_to_flash(slot);
+
+        xSemaphoreTake(pipeline_lock, portMAX_DELAY);
+        hive_pipeline_record_end(&pipeline, slot, len);
+        ESP_LOGI(GATTC_TAG, "HIVE RECORD END slot %d, %d to send, %u dropped", slot,
+                hive_pipeline_pending(&pipeline), (unsigned)pipeline.dropped);
+        int next = hive_pipeline_erase_begin(&pipeline);
+        xSemaphoreGive(pipeline_lock);
+        //only wakes the send task, which goes by the slot states, so a full queue is fine
+        xQueueSend(send_queue, &slot, 0);
+
+        if (next >= 0) {
+            erase_flash(next);
+            xSemaphoreTake(pipeline_lock, portMAX_DELAY);
+            hive_pipeline_erase_end(&pipeline, next);
+            xSemaphoreGive(pipeline_lock);
+        }
+        vTaskDelayUntil(&last_wake, HIVE_TASK_PERIOD / portTICK_PERIOD_MS);
     }
+}
 
+//sends recordings oldest first as hive_record_task finishes them
+static void hive_send_task(void *params)
+{
+    while(1) {
+        int ready;
+        xQueueReceive(send_queue, &ready, portMAX_DELAY);
+        while(1) {
+            xSemaphoreTake(pipeline_lock, portMAX_DELAY);
+            int slot = hive_pipeline_send_begin(&pipeline);
+            xSemaphoreGive(pipeline_lock);
+            if (slot < 0) {
+                break;
+            }
+            ESP_LOGI(GATTC_TAG, "HIVE SEND START slot %d", slot);
+            int sent = send_data_to_server(slot) == 0;
+            xSemaphoreTake(pipeline_lock, portMAX_DELAY);
+            hive_pipeline_send_end(&pipeline, slot, sent);
+            xSemaphoreGive(pipeline_lock);
+            ESP_LOGI(GATTC_TAG, "HIVE SEND END slot %d%s", slot, sent ? "" : ", kept for the next try");
+            //the slot is first in line again, it goes with the next recording
+            if (!sent) {
+                break;
+            }
+        }
+    }
 }
 
 
 void app_main(void)
 {
+    //before the GATT callbacks can hand out credits
+    hive_txq_init(&txq, MAX_INFLIGHT);
     // Initialize NVS.
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -904,7 +1234,15 @@ void app_main(void)
 
     i2s_driver_install(i2s_num, &i2s_config, 0, NULL);   //install and start i2s driver
     i2s_set_pin(i2s_num, &pin_config);
-    i2s_set_sample_rates(i2s_num, 22050); //set sample rates
+    i2s_set_sample_rates(i2s_num, I2S_RECORD_RATE); //set sample rates
+
+    struct hive_dsp_config dsp_config = HIVE_DSP_DEFAULTS;
+    dsp_config.sample_rate = I2S_RECORD_RATE;
+    ret = hive_dsp_init(&dsp, &dsp_config);
+    if (ret) {
+        ESP_LOGE(GATTC_TAG, "%s spectrum init failed: %d\n", __func__, ret);
+    }
+    dsp_ready = ret == 0;
     // audio_data = (uint8_t*) malloc(HIVE_AUDIO_READ_LEN); 
     // if (audio_data == 0) {
     //     ESP_LOGI(GATTC_TAG, "MALLOC FAILED");
@@ -923,6 +1261,26 @@ void app_main(void)
         ESP_LOGE(GATTC_TAG, "%s, init fail, the gattc semaphore create fail.", __func__);
         return;
     }
-    xTaskCreate(&hive_report_task, "hive_report_task", 4096, NULL, 3, NULL);
+    reply_queue = xQueueCreate(4, sizeof(struct upload_reply));
+    if (!reply_queue) {
+        ESP_LOGE(GATTC_TAG, "%s, init fail, the reply queue create fail.", __func__);
+        return;
+    }
+    const esp_partition_t *storage = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+            ESP_PARTITION_SUBTYPE_DATA_FAT, PARTITION_NAME);
+    if (!storage || hive_pipeline_init(&pipeline, storage->size, FLASH_SLOT_SIZE, FLASH_SLOTS)) {
+        ESP_LOGE(GATTC_TAG, "%s, init fail, %d slots of %d bytes don't fit in %s.", __func__,
+                FLASH_SLOTS, FLASH_SLOT_SIZE, PARTITION_NAME);
+        return;
+    }
+    pipeline_lock = xSemaphoreCreateMutex();
+    send_queue = xQueueCreate(FLASH_SLOTS, sizeof(int));
+    if (!pipeline_lock || !send_queue) {
+        ESP_LOGE(GATTC_TAG, "%s, init fail, the pipeline lock or queue create fail.", __func__);
+        return;
+    }
+    //sending is the lower priority, a recording has to keep up with the microphone
+    xTaskCreate(&hive_record_task, "hive_record_task", 4096, NULL, 4, NULL);
+    xTaskCreate(&hive_send_task, "hive_send_task", 4096, NULL, 3, NULL);
 
 }
\ No newline at end of file
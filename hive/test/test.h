@@ -0,0 +1,18 @@
+//what the host tests share.  CHECK carries on after a failure so one run shows
+//every broken case, main returns failures.
+
+#ifndef HIVE_TEST_H
+#define HIVE_TEST_H
+
+#include <stdio.h>
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,108 @@
+//hive_adpcm round trips: a stream whose last block is part full and holds an
+//odd number of samples, a decode that asks for more than a block holds and a
+//stream cut short.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "hive_adpcm.h"
+#include "test.h"
+
+#define BLOCK_LEN HIVE_ADPCM_BLOCK_LEN
+#define PER_BLOCK hive_adpcm_block_samples(BLOCK_LEN)
+//three full blocks and 101 samples over
+#define NSAMPLES (3 * PER_BLOCK + 101)
+#define CANARY 0x5a5a
+//samples the coder takes to get from its smallest step up to the signal
+#define RAMP 32
+
+static int16_t in[NSAMPLES];
+static int16_t out[NSAMPLES + PER_BLOCK];
+
+static size_t encode(uint8_t *stream, const struct hive_adpcm_header *h) {
+    struct hive_adpcm_state s = {0};
+    uint8_t *p = stream + HIVE_ADPCM_HEADER_LEN;
+    hive_adpcm_header_write(stream, h);
+    for (uint32_t i = 0; i < h->nsamples; i += PER_BLOCK, p += h->block_len) {
+        int n = h->nsamples - i < PER_BLOCK ? (int)(h->nsamples - i) : PER_BLOCK;
+        hive_adpcm_encode_block(&s, in + i, n, p, h->block_len);
+    }
+    return p - stream;
+}
+
+//worst error against the input over samples from to n - 1
+static int max_error(int from, int n) {
+    int worst = 0;
+    for (int i = from; i < n; i++) {
+        int e = abs(out[i] - in[i]);
+        worst = e > worst ? e : worst;
+    }
+    return worst;
+}
+
+static void test_round_trip(void) {
+    struct hive_adpcm_header h = {.block_len = BLOCK_LEN, .nsamples = NSAMPLES, .sample_rate = 22050};
+    size_t stream_len = hive_adpcm_stream_len(&h);
+    uint8_t *stream = malloc(HIVE_ADPCM_HEADER_LEN + stream_len);
+    struct hive_adpcm_header r;
+
+    CHECK(stream_len == 4 * BLOCK_LEN);
+    CHECK(encode(stream, &h) == HIVE_ADPCM_HEADER_LEN + stream_len);
+    CHECK(hive_adpcm_header_read(stream, HIVE_ADPCM_HEADER_LEN, &r) == 0);
+    CHECK(r.block_len == h.block_len && r.nsamples == h.nsamples && r.sample_rate == h.sample_rate);
+
+    for (size_t i = 0; i < sizeof(out) / sizeof(out[0]); i++) {
+        out[i] = CANARY;
+    }
+    CHECK(hive_adpcm_decode(&r, stream + HIVE_ADPCM_HEADER_LEN, stream_len, out) == 0);
+    //a hum a few thousand counts high keeps within a couple of percent
+    CHECK(max_error(RAMP, NSAMPLES) < 200);
+    //the padding of the last block isn't decoded
+    CHECK(out[NSAMPLES] == CANARY);
+
+    //short by a byte
+    CHECK(hive_adpcm_decode(&r, stream + HIVE_ADPCM_HEADER_LEN, stream_len - 1, out) == -EINVAL);
+    CHECK(hive_adpcm_header_read(stream, HIVE_ADPCM_HEADER_LEN - 1, &r) == -EINVAL);
+    free(stream);
+}
+
+//each block decodes on its own, and asking for more than it holds stops at its end
+static void test_block(void) {
+    uint8_t block[BLOCK_LEN];
+    struct hive_adpcm_state s = {.predictor = in[PER_BLOCK - 1]};
+
+    hive_adpcm_encode_block(&s, in + PER_BLOCK, PER_BLOCK, block, BLOCK_LEN);
+    for (size_t i = 0; i < sizeof(out) / sizeof(out[0]); i++) {
+        out[i] = CANARY;
+    }
+    hive_adpcm_decode_block(block, BLOCK_LEN, out, PER_BLOCK + 10);
+    CHECK(out[PER_BLOCK] == CANARY);
+    int worst = 0;
+    for (int i = 0; i < PER_BLOCK; i++) {
+        int e = abs(out[i] - in[PER_BLOCK + i]);
+        worst = e > worst ? e : worst;
+    }
+    CHECK(worst < 200);
+
+    //an odd count leaves the high nibble of the last byte alone
+    hive_adpcm_encode_block(&s, in, 7, block, BLOCK_LEN);
+    CHECK(block[HIVE_ADPCM_BLOCK_HEADER_LEN + 3] >> 4 == 0);
+    CHECK(block[BLOCK_LEN - 1] == 0);
+    out[7] = CANARY;
+    hive_adpcm_decode_block(block, BLOCK_LEN, out, 7);
+    CHECK(out[7] == CANARY);
+}
+
+int main(void) {
+    for (int i = 0; i < NSAMPLES; i++) {
+        in[i] = (int16_t)(3000 * sin(2 * M_PI * 250 * i / 22050.0) + 1000 * sin(2 * M_PI * 410 * i / 22050.0));
+    }
+    test_round_trip();
+    test_block();
+    if (failures) {
+        fprintf(stderr, "test_adpcm: %d failed\n", failures);
+    }
+    return failures != 0;
+}
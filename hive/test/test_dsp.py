@@ -0,0 +1,165 @@
+"""
+The node's spectrum packets (hive_dsp.c and the FFT and bins it shares with the
+base station, built as a shared library) against hive_process working the same
+recordings out from the audio, the way the base station gets them with
+hive_config.json and the radix2 FFT.  A packet has to give the same bee flags,
+its range bins have to be the audio's summed magnitudes and its bands the ones
+hive_process makes, the last within float16.
+
+    python3 test_dsp.py path/to/libhive_dsp.so path/to/beeminder_base_processing
+
+The recordings come from the base station's gen_hive, the test is skipped when
+it or hive_process haven't been built.
+"""
+
+import ctypes, json, os, struct, subprocess, sys, tempfile, unittest
+
+LIB = sys.argv.pop(1) if len(sys.argv) > 1 else './libhive_dsp.so'
+BASE = sys.argv.pop(1) if len(sys.argv) > 1 else '../../beeminder_base_processing'
+lib = ctypes.CDLL(os.path.abspath(LIB))
+HIVE_PROCESS = os.path.join(BASE, 'hive_process')
+GEN_HIVE = os.path.join(BASE, 'gen_hive')
+CONFIG = os.path.join(BASE, 'hive_config.json')
+
+MAX_RANGES = 8
+MAX_BANDS = 64
+# HIVE_SPECTRUM_MAX_LEN and HIVE_SPECTRUM_HEADER_LEN
+PACKET_LEN = 496
+HEADER_LEN = 32
+# sizeof(struct raw_hivedata)
+HIVEDATA_LEN = 12
+# samples main.c pushes at a time, one BLE write of them
+CHUNK = 248
+# the range bins are float32, the bands float16 with a scale
+RANGE_MAX_ERROR = 1e-5
+BAND_MAX_ERROR = 1e-3
+
+
+class Config(ctypes.Structure):
+    # struct hive_dsp_config
+    _fields_ = [('sample_rate', ctypes.c_int), ('frame_len', ctypes.c_int), ('nfft', ctypes.c_int),
+                ('nranges', ctypes.c_int), ('freq', ctypes.c_float * MAX_RANGES),
+                ('search_hz', ctypes.c_float), ('nbands', ctypes.c_int), ('fmin', ctypes.c_float),
+                ('fmax', ctypes.c_float)]
+
+
+class Fft(ctypes.Structure):
+    # struct hive_fft
+    _fields_ = [('n', ctypes.c_int), ('half', ctypes.c_int), ('bitrev', ctypes.c_void_p),
+                ('tw', ctypes.c_void_p), ('split', ctypes.c_void_p)]
+
+
+class Dsp(ctypes.Structure):
+    # struct hive_dsp
+    _fields_ = [('cfg', Config), ('half', ctypes.c_int), ('fft', Fft), ('window', ctypes.c_void_p),
+                ('work', ctypes.c_void_p), ('spectrum', ctypes.c_void_p), ('frame', ctypes.c_void_p),
+                ('fill', ctypes.c_int), ('frames', ctypes.c_int),
+                ('range_first', ctypes.c_int * MAX_RANGES), ('range_count', ctypes.c_int * MAX_RANGES),
+                ('band_first', ctypes.c_int * MAX_BANDS), ('band_last', ctypes.c_int * MAX_BANDS),
+                ('edge', ctypes.c_float * (MAX_BANDS + 1))]
+
+
+lib.hive_dsp_init.argtypes = [ctypes.POINTER(Dsp), ctypes.POINTER(Config)]
+lib.hive_dsp_free.argtypes = [ctypes.POINTER(Dsp)]
+lib.hive_dsp_push.argtypes = [ctypes.POINTER(Dsp), ctypes.c_char_p, ctypes.c_size_t]
+lib.hive_dsp_packet.argtypes = [ctypes.POINTER(Dsp), ctypes.c_char_p, ctypes.c_size_t]
+
+
+def defaults():
+    """HIVE_DSP_DEFAULTS"""
+    return Config(sample_rate=22050, frame_len=4000, nfft=4096, nranges=5,
+                  freq=(ctypes.c_float * MAX_RANGES)(285, 225, 190, 400, 800), search_hz=8,
+                  nbands=32, fmin=0, fmax=0)
+
+
+def packet(cfg, audio):
+    """what a node set up with cfg sends for the samples"""
+    d = Dsp()
+    if lib.hive_dsp_init(ctypes.byref(d), ctypes.byref(cfg)):
+        raise ValueError('hive_dsp_init')
+    try:
+        for i in range(0, len(audio), 2 * CHUNK):
+            chunk = audio[i:i + 2 * CHUNK]
+            lib.hive_dsp_push(ctypes.byref(d), chunk, len(chunk) // 2)
+        out = ctypes.create_string_buffer(PACKET_LEN)
+        n = lib.hive_dsp_packet(ctypes.byref(d), out, PACKET_LEN)
+        if n < 0:
+            raise ValueError('hive_dsp_packet')
+        return out.raw[:n]
+    finally:
+        lib.hive_dsp_free(ctypes.byref(d))
+
+
+def ranges(pkt):
+    """{bin: summed magnitude} of the packet's range bins"""
+    nranges = pkt[5]
+    values = HEADER_LEN + 4 * nranges
+    bins = {}
+    for r in range(nranges):
+        first, count = struct.unpack_from('<HH', pkt, HEADER_LEN + 4 * r)
+        for k in range(count):
+            bins[first + k] = struct.unpack_from('<f', pkt, values)[0]
+            values += 4
+    return bins
+
+
+@unittest.skipUnless(os.access(HIVE_PROCESS, os.X_OK) and os.access(GEN_HIVE, os.X_OK),
+                     'hive_process and gen_hive not built')
+class PacketTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self.dir.cleanup()
+
+    def hive_process(self, path, *args):
+        out = subprocess.run([HIVE_PROCESS, '--config', CONFIG, '--fft', 'radix2'] + list(args) + [path],
+                             stdout=subprocess.PIPE, check=True)
+        return json.loads(out.stdout)
+
+    def check(self, *gen_args):
+        cfg = defaults()
+        rec = os.path.join(self.dir.name, 'rec.in')
+        subprocess.run([GEN_HIVE, '--rate', str(cfg.sample_rate)] + list(gen_args) + [rec], check=True)
+        with open(rec, 'rb') as f:
+            data = f.read()
+        pkt = packet(cfg, data[HIVEDATA_LEN:])
+        sent = os.path.join(self.dir.name, 'sent.in')
+        with open(sent, 'wb') as f:
+            f.write(data[:HIVEDATA_LEN] + pkt)
+
+        node = self.hive_process(sent)
+        audio = self.hive_process(rec)
+        self.assertEqual(node['bee_flags'], audio['bee_flags'])
+
+        spectrum = audio['fft_data']
+        bins = ranges(pkt)
+        peak = max(spectrum[k] for k in bins)
+        for k, v in bins.items():
+            self.assertLess(abs(v - spectrum[k]), RANGE_MAX_ERROR * peak, 'bin %d' % k)
+
+        fmin, fmax = struct.unpack_from('<ff', pkt, 16)
+        bands = self.hive_process(rec, '--bands', str(cfg.nbands), '--fmin', repr(fmin), '--fmax', repr(fmax))
+        self.assertEqual(len(node['bands']['edges']), len(bands['bands']['edges']))
+        for a, b in zip(node['bands']['edges'], bands['bands']['edges']):
+            self.assertAlmostEqual(a, b, delta=1e-3 * b + 1e-3)
+        for key in ('mean', 'peak', 'energy'):
+            for i, (a, b) in enumerate(zip(node['bands'][key], bands['bands'][key])):
+                self.assertLess(abs(a - b), BAND_MAX_ERROR * b, '%s of band %d' % (key, i))
+
+    def test_tones(self):
+        self.check('--seconds', '10', '--seed', '1')
+
+    def test_noisy(self):
+        self.check('--seconds', '10', '--seed', '2', '--noise', '1000')
+
+    def test_quiet(self):
+        self.check('--seconds', '10', '--seed', '3', '--amp', '400', '--noise', '100')
+
+    def test_partial_frame(self):
+        # a recording that doesn't end on a frame, the leftover samples count on neither side
+        self.check('--seconds', '3.3', '--seed', '4')
+
+
+if __name__ == '__main__':
+    unittest.main()
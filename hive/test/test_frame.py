@@ -0,0 +1,258 @@
+"""
+Loopback of the framed uploads: the node's hive_frame.c, built as a shared
+library, sends through a lossy link to the base station's FrameReceiver
+(Base/hive_frame.py) and the replies come back the same way.  The node side
+does what hive/main/main.c does with them: stops on a RESUME for a frame after
+its START, and starts again from the offset it was given.
+
+    python3 test_frame.py path/to/libhive_frame.so
+"""
+
+import contextlib, ctypes, errno, io, os, random, shutil, struct, sys, tempfile, unittest, zlib
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'Base'))
+import hive_frame as hf
+
+LIB = sys.argv.pop(1) if len(sys.argv) > 1 else './libhive_frame.so'
+lib = ctypes.CDLL(os.path.abspath(LIB))
+
+SEND = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t)
+
+
+class Header(ctypes.Structure):
+    _fields_ = [('type', ctypes.c_int), ('seq', ctypes.c_uint16), ('len', ctypes.c_uint16),
+                ('offset', ctypes.c_uint32)]
+
+
+class Upload(ctypes.Structure):
+    # struct hive_upload
+    _fields_ = [('id', ctypes.c_uint32), ('pos', ctypes.c_uint32), ('resume', ctypes.c_uint32),
+                ('crc', ctypes.c_uint32), ('seq', ctypes.c_uint16), ('frames', ctypes.c_uint32),
+                ('fill', ctypes.c_int), ('stopped', ctypes.c_int), ('send', SEND),
+                ('ctx', ctypes.c_void_p), ('frame', ctypes.c_uint8 * 496)]
+
+
+lib.hive_crc32.restype = ctypes.c_uint32
+lib.hive_crc32.argtypes = [ctypes.c_uint32, ctypes.c_char_p, ctypes.c_size_t]
+lib.hive_frame_read.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.POINTER(Header),
+                                ctypes.POINTER(ctypes.POINTER(ctypes.c_uint8))]
+
+# main.c's UPLOAD_TRIES, tries in a row that get no further
+TRIES = 5
+# bytes the node writes to hive_upload_write at a time
+CHUNK = 496
+
+
+class Link:
+    """
+    The radio between the node and the base station.  Each frame may be
+    dropped, have a bit flipped or lose its tail, and the connection may go
+    down for the next few frames, the writes main.c has in flight.  cut_at
+    drops the connection once, just before the frame of that type, and
+    reply_lost_at the first reply of that type.
+    """
+    def __init__(self, rnd, drop=0, corrupt=0, truncate=0, cut=0, reply_drop=0, cut_at=None,
+                 reply_lost_at=None):
+        self.rnd = rnd
+        self.drop, self.corrupt, self.truncate = drop, corrupt, truncate
+        self.cut, self.reply_drop, self.cut_at = cut, reply_drop, cut_at
+        self.reply_lost_at = reply_lost_at
+        self.down = 0
+
+    def carry(self, frame):
+        """the frame as it arrives, or None"""
+        if self.cut_at is not None and frame[3] == self.cut_at:
+            self.cut_at = None
+            return None
+        if self.down > 0:
+            self.down -= 1
+            return None
+        if self.rnd.random() < self.cut:
+            self.down = self.rnd.randint(0, 3)
+            return None
+        if self.rnd.random() < self.drop:
+            return None
+        if self.rnd.random() < self.corrupt:
+            frame = bytearray(frame)
+            frame[self.rnd.randrange(len(frame))] ^= 1 << self.rnd.randrange(8)
+            frame = bytes(frame)
+        if self.rnd.random() < self.truncate:
+            frame = frame[:self.rnd.randrange(len(frame))]
+        return frame
+
+    def carry_reply(self, reply):
+        if self.reply_lost_at is not None and reply[3] == self.reply_lost_at:
+            self.reply_lost_at = None
+            return None
+        if self.rnd.random() < self.reply_drop:
+            return None
+        return reply
+
+
+class Node:
+    """send_data_to_server and upload_frame_send from main.c"""
+    def __init__(self, link, receiver, content, upload_id):
+        self.link = link
+        self.receiver = receiver
+        self.content = content
+        self.id = upload_id
+        self.upload = Upload()
+        self.replies = []
+        self.done = []
+        self.frames = 0
+        self.callback = SEND(self.send)
+
+    def send(self, ctx, frame, n):
+        frame = bytes(frame[:n])
+        self.frames += 1
+        arrived = self.link.carry(frame)
+        if arrived is not None:
+            reply, path = self.receiver.handle('node', arrived)
+            if reply is not None and self.link.carry_reply(reply) is not None:
+                self.replies.append(hf.parse_frame(reply))
+            if path is not None:
+                with open(path, 'rb') as f:
+                    self.done.append(f.read())
+        # a RESUME for a frame after START sends the upload back further
+        u = self.upload
+        start_seq = (u.seq - u.frames) & 0xffff
+        while frame[3] == hf.DATA and self.replies:
+            frame_type, seq, offset, payload = self.replies.pop(0)
+            if frame_type == hf.RESUME and seq != start_seq and struct.unpack('<I', payload)[0] == self.id:
+                u.resume = offset
+                lib.hive_upload_stop(ctypes.byref(u))
+
+    def reply_to(self, seq):
+        for r in self.replies:
+            if r[1] == seq and struct.unpack('<I', r[3])[0] == self.id:
+                return r
+        return None
+
+    def run(self):
+        """(DONE reply, uploads begun), the reply is None if it gave up"""
+        u = self.upload
+        resume = 0
+        tries = 0
+        attempts = 0
+        while tries < TRIES:
+            attempts += 1
+            start = resume
+            del self.replies[:]
+            lib.hive_upload_begin(ctypes.byref(u), self.id, 0, self.callback, None)
+            r = self.reply_to((u.seq - 1) & 0xffff)
+            del self.replies[:]
+            if r is not None:
+                if r[0] == hf.DONE:
+                    return r, attempts
+                resume = r[2]
+            u.resume = resume
+            for i in range(0, len(self.content), CHUNK):
+                chunk = self.content[i:i + CHUNK]
+                lib.hive_upload_write(ctypes.byref(u), chunk, len(chunk))
+            lib.hive_upload_end(ctypes.byref(u))
+            if u.stopped:
+                resume = u.resume
+            else:
+                r = self.reply_to((u.seq - 1) & 0xffff)
+                if r is not None:
+                    if r[0] == hf.DONE:
+                        return r, attempts
+                    resume = r[2]
+            if resume <= start:
+                tries += 1
+        return None, attempts
+
+
+class FrameTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def upload(self, seed, size, **loss):
+        rnd = random.Random(seed)
+        content = bytes(rnd.getrandbits(8) for _ in range(size))
+        receiver = hf.FrameReceiver(self.directory)
+        node = Node(Link(rnd, **loss), receiver, content, rnd.getrandbits(32))
+        # FrameReceiver reports every frame it turns away
+        with contextlib.redirect_stdout(io.StringIO()):
+            done, attempts = node.run()
+        return content, node, done, attempts
+
+    def check_upload(self, content, node, done):
+        self.assertIsNotNone(done)
+        frame_type, seq, offset, payload = done
+        self.assertEqual(frame_type, hf.DONE)
+        self.assertEqual(offset, len(content))
+        self.assertEqual(struct.unpack('<I', payload)[0], node.id)
+        # handed on once, with every byte as it was sent
+        self.assertEqual(len(node.done), 1)
+        self.assertEqual(node.done[0], content)
+
+    def test_crc32(self):
+        for n in (0, 1, 3, 7, 1000):
+            data = os.urandom(n)
+            self.assertEqual(lib.hive_crc32(0, data, n), zlib.crc32(data))
+            part = lib.hive_crc32(0, data[:3], min(n, 3))
+            self.assertEqual(lib.hive_crc32(part, data[3:], max(n - 3, 0)), zlib.crc32(data))
+
+    def test_frame_read(self):
+        h = Header()
+        payload = ctypes.POINTER(ctypes.c_uint8)()
+        frame = hf.frame(hf.RESUME, 9, 1234, struct.pack('<I', 0xdeadbeef))
+        self.assertEqual(lib.hive_frame_read(frame, len(frame), h, payload), 0)
+        self.assertEqual((h.type, h.seq, h.len, h.offset), (hf.RESUME, 9, 4, 1234))
+        self.assertEqual(bytes(payload[:4]), struct.pack('<I', 0xdeadbeef))
+        bad = bytearray(frame)
+        bad[10] ^= 1
+        self.assertEqual(lib.hive_frame_read(bytes(bad), len(bad), h, payload), -errno.EBADMSG)
+        self.assertIsNone(hf.parse_frame(bytes(bad)))
+        self.assertEqual(lib.hive_frame_read(frame[:-1], len(frame) - 1, h, payload), -errno.EINVAL)
+        self.assertIsNone(hf.parse_frame(frame[:-1]))
+
+    def test_clean(self):
+        for size in (0, 5, 480, 481, 40068):
+            content, node, done, attempts = self.upload(size, size)
+            self.check_upload(content, node, done)
+            self.assertEqual(attempts, 1)
+            # START, the data in whole frames and END
+            self.assertEqual(node.frames, 2 + (size + 479) // 480)
+
+    def test_cut_before_end(self):
+        # every byte is there, the END isn't: the next START is told the whole
+        # length and only END goes again
+        content, node, done, attempts = self.upload(1, 20000, cut_at=hf.END)
+        self.check_upload(content, node, done)
+        self.assertEqual(attempts, 2)
+        self.assertEqual(node.frames, 2 + 42 + 2)
+
+    def test_lost_done(self):
+        # the base station finished but the node never heard: the START it
+        # sends again gets DONE with the length, and nothing is handed on twice
+        content, node, done, attempts = self.upload(2, 5000, reply_lost_at=hf.DONE)
+        self.check_upload(content, node, done)
+        self.assertEqual(attempts, 2)
+        self.assertEqual(node.frames, 2 + 11 + 1)
+
+    def test_dropped(self):
+        for seed in range(20):
+            self.check_upload(*self.upload(seed, 160012, drop=0.01)[:3])
+
+    def test_corrupt(self):
+        for seed in range(20):
+            self.check_upload(*self.upload(seed, 160012, corrupt=0.01)[:3])
+
+    def test_truncated(self):
+        for seed in range(20):
+            self.check_upload(*self.upload(seed, 160012, truncate=0.01)[:3])
+
+    def test_lossy(self):
+        for seed in range(100):
+            size = random.Random(seed).choice([5, 312, 12 + 16 + 40000, 12 + 160000])
+            self.check_upload(*self.upload(seed, size, drop=0.002, corrupt=0.002, truncate=0.002,
+                                           cut=0.001, reply_drop=0.02)[:3])
+
+
+if __name__ == '__main__':
+    unittest.main()
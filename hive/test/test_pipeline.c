@@ -0,0 +1,347 @@
+//hive_pipeline against a simulated flash, microphone and radio.  the record and
+//send tasks of hive/main/main.c are played a millisecond at a time, every call
+//checks the slot state changes it made, and the radio reads back each recording
+//to see it wasn't written over while it was being sent.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "hive_pipeline.h"
+#include "test.h"
+
+#define SLOT_SIZE 64
+#define ERASED_BYTE 0xff
+
+static struct hive_pipeline p;
+static uint8_t flash[HIVE_PIPELINE_MAX_SLOTS * SLOT_SIZE];
+static enum hive_slot_state before[HIVE_PIPELINE_MAX_SLOTS];
+
+static const char *state_names[] = {"FREE", "ERASING", "ERASED", "RECORDING", "FULL", "SENDING"};
+
+static void snapshot(void) {
+    for (int s = 0; s < p.nslots; s++) {
+        before[s] = p.slot[s].state;
+    }
+}
+
+//FREE -> ERASING -> ERASED -> RECORDING -> FULL -> SENDING -> FREE, and the
+//ways round it the header allows: recording into a free slot that is erased
+//first, writing over a full one and a send that has to be tried again
+static int allowed(enum hive_slot_state from, enum hive_slot_state to) {
+    switch (from) {
+    case HIVE_SLOT_FREE:
+        return to == HIVE_SLOT_ERASING || to == HIVE_SLOT_RECORDING;
+    case HIVE_SLOT_ERASING:
+        return to == HIVE_SLOT_ERASED;
+    case HIVE_SLOT_ERASED:
+        return to == HIVE_SLOT_RECORDING;
+    case HIVE_SLOT_RECORDING:
+        return to == HIVE_SLOT_FULL;
+    case HIVE_SLOT_FULL:
+        return to == HIVE_SLOT_SENDING || to == HIVE_SLOT_RECORDING;
+    case HIVE_SLOT_SENDING:
+        return to == HIVE_SLOT_FREE || to == HIVE_SLOT_FULL;
+    }
+    return 0;
+}
+
+//the changes since snapshot, at most one slot moves per call
+static void check_moves(const char *call) {
+    int moved = 0;
+    for (int s = 0; s < p.nslots; s++) {
+        if (before[s] != p.slot[s].state) {
+            moved++;
+            if (!allowed(before[s], p.slot[s].state)) {
+                fprintf(stderr, "%s: slot %d went %s -> %s\n", call, s,
+                        state_names[before[s]], state_names[p.slot[s].state]);
+                failures++;
+            }
+        }
+    }
+    CHECK(moved <= 1);
+}
+
+static int count(enum hive_slot_state state) {
+    int n = 0;
+    for (int s = 0; s < p.nslots; s++) {
+        n += p.slot[s].state == state;
+    }
+    return n;
+}
+
+static int record_begin(int *erase) {
+    uint32_t dropped = p.dropped;
+    int holding = count(HIVE_SLOT_FULL) + count(HIVE_SLOT_SENDING);
+    snapshot();
+    int s = hive_pipeline_record_begin(&p, erase);
+    check_moves("record_begin");
+    if (s >= 0) {
+        CHECK(before[s] != HIVE_SLOT_SENDING);
+        CHECK(*erase == (before[s] != HIVE_SLOT_ERASED));
+        //only once every slot holds a recording, and then it is a full one
+        CHECK(p.dropped == dropped + (before[s] == HIVE_SLOT_FULL));
+        CHECK(p.dropped == dropped || holding == p.nslots);
+    } else {
+        CHECK(p.dropped == dropped);
+        CHECK(count(HIVE_SLOT_SENDING) + count(HIVE_SLOT_RECORDING) + count(HIVE_SLOT_ERASING) == p.nslots);
+    }
+    return s;
+}
+
+static void record_end(int s, uint32_t len) {
+    snapshot();
+    hive_pipeline_record_end(&p, s, len);
+    check_moves("record_end");
+}
+
+static int erase_begin(void) {
+    snapshot();
+    int s = hive_pipeline_erase_begin(&p);
+    check_moves("erase_begin");
+    return s;
+}
+
+static void erase_end(int s) {
+    snapshot();
+    hive_pipeline_erase_end(&p, s);
+    check_moves("erase_end");
+}
+
+static int send_begin(void) {
+    snapshot();
+    int s = hive_pipeline_send_begin(&p);
+    check_moves("send_begin");
+    //nothing full is older than the one picked
+    for (int t = 0; s >= 0 && t < p.nslots; t++) {
+        CHECK(p.slot[t].state != HIVE_SLOT_FULL || (int32_t)(p.slot[t].seq - p.slot[s].seq) > 0);
+    }
+    return s;
+}
+
+static void send_end(int s, int sent) {
+    snapshot();
+    hive_pipeline_send_end(&p, s, sent);
+    check_moves("send_end");
+}
+
+static void flash_erase(int s) {
+    memset(flash + p.slot[s].offset, ERASED_BYTE, SLOT_SIZE);
+}
+
+//the microphone writes the recording's number all through the slot
+static void flash_record(int s, uint8_t n) {
+    uint8_t *slot = flash + p.slot[s].offset;
+    for (int i = 0; i < SLOT_SIZE; i++) {
+        //flash only clears bits, so anything not erased shows up
+        CHECK(slot[i] == ERASED_BYTE);
+        slot[i] &= n;
+    }
+}
+
+static int flash_holds(int s, uint8_t n) {
+    const uint8_t *slot = flash + p.slot[s].offset;
+    for (int i = 0; i < SLOT_SIZE; i++) {
+        if (slot[i] != n) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//times in milliseconds
+struct sim {
+    int nslots;
+    int period;             //HIVE_TASK_PERIOD
+    int retry;              //HIVE_RETRY_PERIOD
+    int record;             //microphone
+    int erase;              //a slot
+    int send;               //radio, a recording
+    int fail_every;         //every nth send doesn't go out, 0 for none
+    int nrec;
+    uint32_t seq;           //where the recordings' seq starts
+};
+
+struct sim_result {
+    int recorded;
+    int sent;
+    int dropped;
+    int no_slot;            //times record_begin had nothing
+};
+
+enum {REC_IDLE, REC_ERASE, REC_RECORD, REC_ERASE_NEXT};
+
+static struct sim_result run(const struct sim *sim) {
+    struct sim_result r = {0};
+    int rec_phase = REC_IDLE, rec_until = 0, rec_slot = -1, next = -1, next_wake = 0;
+    int send_slot = -1, send_until = 0, sends = 0;
+    uint8_t number[HIVE_PIPELINE_MAX_SLOTS];
+    uint32_t last_seq = 0;
+    int any_sent = 0;
+
+    CHECK(hive_pipeline_init(&p, sizeof(flash), SLOT_SIZE, sim->nslots) == 0);
+    p.seq = sim->seq;
+    memset(flash, 0, sizeof(flash));
+
+    for (int t = 0; r.recorded < sim->nrec || hive_pipeline_pending(&p) > 0 || send_slot >= 0 ||
+         rec_phase != REC_IDLE; t++) {
+        //the record task
+        if (rec_phase == REC_IDLE && t >= next_wake && r.recorded < sim->nrec) {
+            int erase;
+            rec_slot = record_begin(&erase);
+            if (rec_slot < 0) {
+                r.no_slot++;
+                next_wake = t + sim->retry;
+            } else if (erase) {
+                rec_phase = REC_ERASE;
+                rec_until = t + sim->erase;
+            } else {
+                rec_phase = REC_RECORD;
+                rec_until = t + sim->record;
+            }
+        }
+        if (rec_phase == REC_ERASE && t >= rec_until) {
+            flash_erase(rec_slot);
+            rec_phase = REC_RECORD;
+            rec_until = t + sim->record;
+        }
+        if (rec_phase == REC_RECORD && t >= rec_until) {
+            number[rec_slot] = r.recorded++;
+            flash_record(rec_slot, number[rec_slot]);
+            record_end(rec_slot, SLOT_SIZE);
+            next = erase_begin();
+            next_wake = t - t % sim->period + sim->period;
+            rec_phase = next >= 0 ? REC_ERASE_NEXT : REC_IDLE;
+            rec_until = t + sim->erase;
+        }
+        if (rec_phase == REC_ERASE_NEXT && t >= rec_until) {
+            flash_erase(next);
+            erase_end(next);
+            rec_phase = REC_IDLE;
+        }
+
+        //the send task
+        if (send_slot >= 0 && t >= send_until) {
+            //still the recording it started with
+            CHECK(flash_holds(send_slot, number[send_slot]));
+            int sent = !sim->fail_every || ++sends % sim->fail_every != 0;
+            if (sent) {
+                CHECK(!any_sent || (int32_t)(p.slot[send_slot].seq - last_seq) > 0);
+                last_seq = p.slot[send_slot].seq;
+                any_sent = 1;
+                r.sent++;
+            }
+            send_end(send_slot, sent);
+            send_slot = -1;
+        }
+        if (send_slot < 0 && (send_slot = send_begin()) >= 0) {
+            send_until = t + sim->send;
+        }
+    }
+    r.dropped = p.dropped;
+    //every recording was sent or written over
+    CHECK(r.sent + r.dropped == sim->nrec);
+    CHECK(count(HIVE_SLOT_FREE) + count(HIVE_SLOT_ERASED) == sim->nslots);
+    return r;
+}
+
+//seq wraps between the recordings, send_begin still goes oldest first
+static void test_wraparound(void) {
+    int erase;
+    CHECK(hive_pipeline_init(&p, sizeof(flash), SLOT_SIZE, 3) == 0);
+    p.seq = 0xfffffffe;
+    for (int i = 0; i < 3; i++) {
+        record_end(record_begin(&erase), SLOT_SIZE);
+    }
+    CHECK(p.slot[0].seq == 0xfffffffe && p.slot[1].seq == 0xffffffff && p.slot[2].seq == 0);
+    for (int s = 0; s < 3; s++) {
+        CHECK(send_begin() == s);
+    }
+    CHECK(send_begin() == -1);
+
+    //the same with the newest recording in the lowest slot
+    CHECK(hive_pipeline_init(&p, sizeof(flash), SLOT_SIZE, 3) == 0);
+    p.seq = 0xffffffff;
+    record_end(record_begin(&erase), SLOT_SIZE);
+    record_end(record_begin(&erase), SLOT_SIZE);
+    record_end(record_begin(&erase), SLOT_SIZE);
+    send_end(send_begin(), 1);
+    send_end(send_begin(), 1);
+    //slot 0 again, now seq 2, with slot 2 at seq 1 still waiting
+    record_end(record_begin(&erase), SLOT_SIZE);
+    CHECK(p.slot[0].seq == 2 && p.slot[2].seq == 1);
+    CHECK(send_begin() == 2);
+    CHECK(send_begin() == 0);
+}
+
+//two slots, the node's own setup
+static void test_two_slots(void) {
+    int erase;
+    CHECK(hive_pipeline_init(&p, 2 * SLOT_SIZE, SLOT_SIZE, 2) == 0);
+
+    //one full, one free: no drop
+    record_end(record_begin(&erase), SLOT_SIZE);
+    int s = record_begin(&erase);
+    CHECK(s == 1 && erase && p.dropped == 0);
+    record_end(s, SLOT_SIZE);
+
+    //both full: the oldest goes
+    CHECK(record_begin(&erase) == 0 && erase && p.dropped == 1);
+    record_end(0, SLOT_SIZE);
+
+    //one full, one erased: no drop
+    CHECK(send_begin() == 1);
+    send_end(1, 1);
+    CHECK(erase_begin() == 1);
+    erase_end(1);
+    CHECK(record_begin(&erase) == 1 && !erase && p.dropped == 1);
+    record_end(1, SLOT_SIZE);
+
+    //the one being sent is never taken, the other is the only choice
+    CHECK(send_begin() == 0);
+    CHECK(record_begin(&erase) == 1 && p.dropped == 2);
+    CHECK(record_begin(&erase) == -1 && p.dropped == 2);
+    send_end(0, 0);
+    CHECK(p.slot[0].state == HIVE_SLOT_FULL);
+}
+
+static void test_init(void) {
+    CHECK(hive_pipeline_init(&p, 8 * SLOT_SIZE, SLOT_SIZE, 1) == -EINVAL);
+    CHECK(hive_pipeline_init(&p, 2 * SLOT_SIZE, SLOT_SIZE, 3) == -EINVAL);
+    CHECK(hive_pipeline_init(&p, 9 * SLOT_SIZE, SLOT_SIZE, HIVE_PIPELINE_MAX_SLOTS + 1) == -EINVAL);
+    CHECK(hive_pipeline_init(&p, 8 * SLOT_SIZE, 0, 2) == -EINVAL);
+}
+
+int main(void) {
+    static const struct sim sims[] = {
+        //the radio keeps up: nothing is dropped and the next slot is always erased in time
+        {.nslots = 2, .period = 100, .retry = 10, .record = 40, .erase = 5, .send = 50, .nrec = 200},
+        //the radio takes longer than a period, recordings get written over
+        {.nslots = 2, .period = 100, .retry = 10, .record = 40, .erase = 5, .send = 170, .nrec = 200},
+        //and some sends fail and go again, across the seq wrapping
+        {.nslots = 2, .period = 100, .retry = 10, .record = 40, .erase = 5, .send = 90, .fail_every = 3,
+         .nrec = 200, .seq = 0xffffff80},
+        {.nslots = 4, .period = 100, .retry = 10, .record = 40, .erase = 5, .send = 130, .fail_every = 5,
+         .nrec = 300, .seq = 0xffffff80},
+        //a radio that takes many periods to send, only the newest recording waits for it
+        {.nslots = 2, .period = 20, .retry = 5, .record = 15, .erase = 5, .send = 400, .nrec = 50},
+    };
+
+    test_init();
+    test_wraparound();
+    test_two_slots();
+    for (size_t i = 0; i < sizeof(sims) / sizeof(sims[0]); i++) {
+        struct sim_result r = run(&sims[i]);
+        printf("  %d slots, send %3d ms: %3d sent, %3d dropped, %3d times no slot\n",
+               sims[i].nslots, sims[i].send, r.sent, r.dropped, r.no_slot);
+        if (i == 0) {
+            CHECK(r.dropped == 0 && r.no_slot == 0);
+        } else {
+            CHECK(r.dropped > 0);
+        }
+    }
+    if (failures) {
+        fprintf(stderr, "test_pipeline: %d failed\n", failures);
+    }
+    return failures != 0;
+}
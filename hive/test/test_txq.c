@@ -0,0 +1,253 @@
+//hive_txq driven the way main.c's GATT callback drives it, by a fake stack that
+//takes writes into a few buffers, hands them down a tick later in order and
+//sends the write complete, congestion and disconnect events for them.
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "hive_txq.h"
+#include "test.h"
+
+#define MAX_INFLIGHT 4
+
+static struct hive_txq q;
+
+//a write to the stack, as hive_txq has it: credits held never go over the limit
+static int acquire(uint16_t len) {
+    int ret = hive_txq_acquire(&q, len);
+    CHECK(!q.ready || (q.limit >= 1 && q.limit <= q.max_inflight));
+    CHECK(hive_txq_pending(&q) >= 0 && hive_txq_pending(&q) <= q.limit);
+    return ret;
+}
+
+static void test_credits(void) {
+    hive_txq_init(&q, MAX_INFLIGHT);
+    CHECK(acquire(100) == -ENOTCONN);
+
+    //the stack has more buffers than the credits
+    hive_txq_ready(&q, 10);
+    CHECK(q.limit == MAX_INFLIGHT);
+    for (int i = 0; i < MAX_INFLIGHT; i++) {
+        CHECK(acquire(100) == 0);
+    }
+    CHECK(acquire(100) == -EAGAIN);
+    hive_txq_complete(&q, 1, 0);
+    CHECK(acquire(100) == 0);
+
+    //and fewer, or none at all yet
+    hive_txq_ready(&q, 2);
+    CHECK(q.limit == 2 && hive_txq_pending(&q) == 0);
+    hive_txq_ready(&q, 0);
+    CHECK(q.limit == 1);
+    CHECK(acquire(100) == 0);
+    CHECK(acquire(100) == -EAGAIN);
+
+    //a write the stack wouldn't take gives its credit back
+    hive_txq_abort(&q);
+    CHECK(hive_txq_pending(&q) == 0);
+    hive_txq_abort(&q);
+    CHECK(hive_txq_pending(&q) == 0);
+
+    //congestion holds everything back until it clears
+    hive_txq_ready(&q, 4);
+    hive_txq_congest(&q, 1);
+    CHECK(acquire(100) == -EAGAIN);
+    hive_txq_congest(&q, 0);
+    CHECK(acquire(100) == 0);
+
+    //a timeout only starts the credits over when the stack isn't congested
+    CHECK(acquire(100) == 0);
+    hive_txq_congest(&q, 1);
+    CHECK(hive_txq_timeout(&q, 4) == 0);
+    CHECK(q.congested && hive_txq_pending(&q) == 2);
+    CHECK(acquire(100) == -EAGAIN);
+    hive_txq_congest(&q, 0);
+    CHECK(hive_txq_timeout(&q, 4) == 1);
+    CHECK(hive_txq_pending(&q) == 0);
+    CHECK(acquire(100) == 0);
+}
+
+static void test_late_completion(void) {
+    hive_txq_init(&q, MAX_INFLIGHT);
+    hive_txq_ready(&q, 4);
+    hive_txq_start(&q, 0);
+    CHECK(acquire(200) == 0);
+    CHECK(acquire(200) == 0);
+    CHECK(acquire(200) == 0);
+
+    //safe_send timed out and started the credits over, then the events turn up
+    hive_txq_ready(&q, 4);
+    hive_txq_complete(&q, 1, 1000);
+    hive_txq_complete(&q, 1, 2000);
+    hive_txq_complete(&q, 0, 3000);
+    CHECK(hive_txq_pending(&q) == 0);
+    CHECK(q.packets == 0 && q.bytes == 0 && q.failed == 0);
+    CHECK(q.last_us == 0);
+
+    //the same after a reconnect
+    CHECK(acquire(200) == 0);
+    hive_txq_lost(&q);
+    hive_txq_ready(&q, 4);
+    hive_txq_complete(&q, 1, 4000);
+    CHECK(q.packets == 0 && q.bytes == 0 && hive_txq_pending(&q) == 0);
+}
+
+static void test_lost(void) {
+    hive_txq_init(&q, MAX_INFLIGHT);
+    hive_txq_ready(&q, 4);
+    hive_txq_start(&q, 0);
+    for (int i = 0; i < 4; i++) {
+        CHECK(acquire(100) == 0);
+    }
+    hive_txq_complete(&q, 1, 10);
+    hive_txq_complete(&q, 0, 20);
+    CHECK(q.failed == 1 && q.packets == 1);
+
+    //the two still in flight went down with the connection
+    hive_txq_lost(&q);
+    CHECK(q.failed == 3);
+    CHECK(hive_txq_pending(&q) == 0);
+    CHECK(acquire(100) == -ENOTCONN);
+    hive_txq_lost(&q);
+    CHECK(q.failed == 3);
+}
+
+static void test_rate(void) {
+    hive_txq_init(&q, MAX_INFLIGHT);
+    hive_txq_ready(&q, 4);
+    CHECK(hive_txq_rate(&q) == 0);
+    hive_txq_start(&q, 5000);
+    CHECK(acquire(496) == 0);
+    CHECK(acquire(496) == 0);
+    CHECK(acquire(8) == 0);
+    CHECK(acquire(1000) == 0);
+    hive_txq_complete(&q, 1, 6000);
+    hive_txq_complete(&q, 1, 7000);
+    hive_txq_complete(&q, 1, 9000);
+    //failed writes don't count, nor move the clock
+    hive_txq_complete(&q, 0, 100000);
+    CHECK(q.packets == 3 && q.bytes == 1000);
+    CHECK(q.last_us == 9000);
+    //1000 bytes in 4 ms
+    CHECK(hive_txq_rate(&q) == 250000);
+}
+
+//the fake stack
+#define STACK_BUFFERS 6
+#define CONGEST_AT 5
+
+struct stack {
+    int connected;
+    int queued;             //writes waiting to be handed down
+    int congested;
+    uint16_t len[64];
+    int head;
+    //what came out the other end
+    uint32_t delivered;
+    uint32_t bytes;
+};
+
+static void stack_connect(struct stack *st) {
+    st->connected = 1;
+    st->queued = 0;
+    st->congested = 0;
+    //WRITE_DESCR: the server is listening
+    hive_txq_ready(&q, STACK_BUFFERS - st->queued);
+}
+
+//esp_ble_gattc_write_char, fails when the stack is out of buffers
+static int stack_write(struct stack *st, uint16_t len) {
+    if (!st->connected || st->queued == STACK_BUFFERS) {
+        return -1;
+    }
+    st->len[(st->head + st->queued++) % 64] = len;
+    if (st->queued >= CONGEST_AT && !st->congested) {
+        st->congested = 1;
+        hive_txq_congest(&q, 1);
+    }
+    return 0;
+}
+
+//a tick of the radio, a millisecond: one write handed down, or dropped, and its event
+static void stack_tick(struct stack *st, int64_t now) {
+    if (!st->connected) {
+        return;
+    }
+    if (st->queued > 0) {
+        int ok = rand() % 50 != 0;
+        if (ok) {
+            st->delivered++;
+            st->bytes += st->len[st->head];
+        }
+        st->head = (st->head + 1) % 64;
+        st->queued--;
+        hive_txq_complete(&q, ok, now);
+    }
+    if (st->congested && st->queued < CONGEST_AT - 2) {
+        st->congested = 0;
+        hive_txq_congest(&q, 0);
+    }
+}
+
+static void stack_disconnect(struct stack *st) {
+    int inflight = hive_txq_pending(&q);
+    uint32_t failed = q.failed;
+    st->connected = 0;
+    st->queued = 0;
+    hive_txq_lost(&q);
+    CHECK(q.failed == failed + inflight);
+}
+
+static void test_stack(void) {
+    struct stack st = {0};
+    uint32_t attempted = 0;
+    hive_txq_init(&q, MAX_INFLIGHT);
+    hive_txq_start(&q, 0);
+    srand(1);
+    for (int64_t t = 1; t <= 100000; t++) {
+        if (!st.connected && rand() % 20 == 0) {
+            stack_connect(&st);
+        }
+        //the sender writes as long as it has credits
+        uint16_t len = 1 + rand() % 496;
+        while (acquire(len) == 0) {
+            attempted++;
+            if (stack_write(&st, len)) {
+                hive_txq_abort(&q);
+                attempted--;
+                break;
+            }
+            //the credits keep the stack's buffers from filling up
+            CHECK(st.queued <= hive_txq_pending(&q));
+            len = 1 + rand() % 496;
+        }
+        if (rand() % 3) {
+            stack_tick(&st, t * 1000);
+        }
+        if (st.connected && rand() % 5000 == 0) {
+            stack_disconnect(&st);
+        }
+    }
+    while (st.queued > 0) {
+        stack_tick(&st, 100001 * 1000);
+    }
+    //every write was counted once, delivered or failed
+    CHECK(q.packets == st.delivered);
+    CHECK(q.bytes == st.bytes);
+    CHECK(q.packets + q.failed == attempted);
+    CHECK(hive_txq_rate(&q) == (uint32_t)((int64_t)st.bytes * 1000000 / q.last_us));
+    printf("  %u writes, %u failed, %u bytes/s\n", (unsigned)attempted, (unsigned)q.failed,
+           (unsigned)hive_txq_rate(&q));
+}
+
+int main(void) {
+    test_credits();
+    test_late_completion();
+    test_lost();
+    test_rate();
+    test_stack();
+    if (failures) {
+        fprintf(stderr, "test_txq: %d failed\n", failures);
+    }
+    return failures != 0;
+}